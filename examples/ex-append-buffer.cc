@@ -0,0 +1,103 @@
+/***************************************************************************
+ * Copyright (c) 2022                                                      *
+ *      Volnei Cervi Puttini.  All rights reserved.                        *
+ *      vcputtini@gmail.com
+ *                                                                         *
+ * Redistribution and use in source and binary forms, with or without      *
+ * modification, are permitted provided that the following conditions      *
+ * are met:                                                                *
+ * 1. Redistributions of source code must retain the above copyright       *
+ *    notice, this list of conditions and the following disclaimer.        *
+ * 2. Redistributions in binary form must reproduce the above copyright    *
+ *    notice, this list of conditions and the following disclaimer in the  *
+ *    documentation and/or other materials provided with the distribution. *
+ * 4. Neither the name of the Author     nor the names of its contributors *
+ *    may be used to endorse or promote products derived from this software*
+ *    without specific prior written permission.                           *
+ *                                                                         *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND *
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR      *
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS  *
+ * BE LIABLEFOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR   *
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF    *
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS*
+ * INTERRUPTION)                                                           *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,     *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING   *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE      *
+ * POSSIBILITY OFSUCH DAMAGE.                                              *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef EXAMPLE_H
+#define EXAMPLE_H
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#endif
+
+#include <squidlogparser.h>     // mandatory
+using namespace squidlogparser; // mandatory
+
+/*
+ * Compile:
+ * g++ -Wall -O2 -std=c++17 -lsquidlogparser -pthread ex-append-buffer.cc -o
+ * ex-append-buffer
+ *
+ * Usage file : ./ex-append-buffer access.log
+ * Usage stream: cat access.log | ./ex-append-buffer
+ *
+ * Feeds the parser with large read() chunks instead of one line at a time.
+ * A line cut at the end of a chunk is completed by the next one.
+ */
+
+int
+main(int argc, char* argv[])
+{
+  using LogFormat = SquidLogParser::LogFormat;
+
+  const int fd_ = argc > 1 ? open(argv[1], O_RDONLY) : STDIN_FILENO;
+  if (fd_ < 0) {
+    std::cout << "Error: can't open " << argv[1] << "\n";
+    exit(255);
+  }
+
+  SquidLogParser* p = new SquidLogParser(LogFormat::Squid);
+  SquidLogParser::lineCount_t total_ = {};
+
+  std::vector<char> buf_(SquidLogParser::defaultReadSize);
+  ssize_t n_ = 0;
+  while ((n_ = read(fd_, buf_.data(), buf_.size())) > 0) {
+    const auto count_ = p->appendBuffer(buf_.data(), static_cast<size_t>(n_));
+    total_.Accepted += count_.Accepted;
+    total_.Rejected += count_.Rejected;
+  }
+  // The last line may have no '\n'.
+  const auto last_ = p->flush();
+  total_.Accepted += last_.Accepted;
+  total_.Rejected += last_.Rejected;
+
+  if (fd_ != STDIN_FILENO) {
+    close(fd_);
+  }
+
+  std::cout << "Accepted == " << total_.Accepted << "\n"
+            << "Rejected == " << total_.Rejected << "\n"
+            << "Size == " << p->size() << "\n";
+
+  /*
+   * With a std::istream the loop above is done by appendStream():
+   *
+   * std::ifstream in_(argv[1], std::ios::binary);
+   * SquidLogParser::lineCount_t total_ = p->appendStream(in_);
+   */
+
+  delete p;
+  return 0;
+}
@@ -0,0 +1,163 @@
+/***************************************************************************
+ * Copyright (c) 2022                                                      *
+ *      Volnei Cervi Puttini.  All rights reserved.                        *
+ *      vcputtini@gmail.com
+ *                                                                         *
+ * Redistribution and use in source and binary forms, with or without      *
+ * modification, are permitted provided that the following conditions      *
+ * are met:                                                                *
+ * 1. Redistributions of source code must retain the above copyright       *
+ *    notice, this list of conditions and the following disclaimer.        *
+ * 2. Redistributions in binary form must reproduce the above copyright    *
+ *    notice, this list of conditions and the following disclaimer in the  *
+ *    documentation and/or other materials provided with the distribution. *
+ * 4. Neither the name of the Author     nor the names of its contributors *
+ *    may be used to endorse or promote products derived from this software*
+ *    without specific prior written permission.                           *
+ *                                                                         *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND *
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR      *
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS  *
+ * BE LIABLEFOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR   *
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF    *
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS*
+ * INTERRUPTION)                                                           *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,     *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING   *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE      *
+ * POSSIBILITY OFSUCH DAMAGE.                                              *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef EXAMPLE_H
+#define EXAMPLE_H
+#include <arpa/inet.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#endif
+
+#include <squidlogparser.h>     // mandatory
+using namespace squidlogparser; // mandatory
+
+/*
+ * Compile:
+ * g++ -Wall -O2 -std=c++17 -lsquidlogparser -pthread ex-bench-ipv4.cc -o
+ * ex-bench-ipv4
+ *
+ * Usage: ./ex-bench-ipv4 [count]
+ *
+ * Measures IPv4Addr::parse() and IPv4Addr::format() against the conversion
+ * done before them, with inet_pton(), std::stringstream and std::stol().
+ */
+
+namespace {
+uint32_t
+legacyIptol(const std::string& addr_)
+{
+  struct sockaddr_in saddr_in_;
+  if (inet_pton(AF_INET, addr_.c_str(), &saddr_in_) != 1) {
+    return 0;
+  }
+  std::array<std::string, 4> a_;
+  std::stringstream ss_(addr_);
+  std::string tok_ = {};
+  int i_ = 0;
+  while (std::getline(ss_, tok_, '.')) {
+    a_[i_++] = std::move(tok_);
+  }
+  return (std::stol(a_[0]) << 24) | (std::stol(a_[1]) << 16) |
+         (std::stol(a_[2]) << 8) | std::stol(a_[3]);
+}
+
+std::string
+legacyLtoip(uint32_t addr_)
+{
+  std::stringstream ss_;
+  ss_ << (addr_ >> 24) << "." << ((addr_ >> 16) & 0xFF) << "."
+      << ((addr_ >> 8) & 0xFF) << "." << (addr_ & 0xFF);
+  return ss_.str();
+}
+
+template<typename TFunc>
+double
+elapsed(TFunc&& func_)
+{
+  const auto t0_ = std::chrono::steady_clock::now();
+  func_();
+  const auto t1_ = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(t1_ - t0_).count();
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  const size_t count_ = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+  std::vector<uint32_t> nums_(count_);
+  std::vector<std::string> addrs_(count_);
+  uint32_t seed_ = 2463534242U;
+  for (size_t i_ = 0; i_ < count_; ++i_) {
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    nums_[i_] = seed_;
+    addrs_[i_] = IPv4Addr::ltoip(seed_);
+  }
+
+  uint64_t check0_ = 0;
+  uint64_t check1_ = 0;
+  const double parseOld_ = elapsed([&]() {
+    for (const std::string& a_ : addrs_) {
+      check0_ += legacyIptol(a_);
+    }
+  });
+  const double parseNew_ = elapsed([&]() {
+    for (const std::string& a_ : addrs_) {
+      uint32_t n_ = 0;
+      IPv4Addr::parse(a_, n_);
+      check1_ += n_;
+    }
+  });
+  if (check0_ != check1_) {
+    std::cout << ">>> parse() mismatch\n";
+    return 255;
+  }
+
+  size_t len0_ = 0;
+  size_t len1_ = 0;
+  const double formatOld_ = elapsed([&]() {
+    for (const uint32_t n_ : nums_) {
+      len0_ += legacyLtoip(n_).size();
+    }
+  });
+  const double formatNew_ = elapsed([&]() {
+    IPv4Addr::Buffer buf_;
+    for (const uint32_t n_ : nums_) {
+      len1_ += IPv4Addr::format(n_, buf_).size();
+    }
+  });
+  if (len0_ != len1_) {
+    std::cout << ">>> format() mismatch\n";
+    return 255;
+  }
+
+  std::cout << count_ << " addresses\n"
+            << "iptol (inet_pton + stringstream): " << parseOld_ << " ms\n"
+            << "IPv4Addr::parse():                " << parseNew_ << " ms ("
+            << parseOld_ / parseNew_ << "x)\n"
+            << "ltoip (stringstream):             " << formatOld_ << " ms\n"
+            << "IPv4Addr::format():               " << formatNew_ << " ms ("
+            << formatOld_ / formatNew_ << "x)\n";
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+/***************************************************************************
+ * Copyright (c) 2022                                                      *
+ *      Volnei Cervi Puttini.  All rights reserved.                        *
+ *      vcputtini@gmail.com
+ *                                                                         *
+ * Redistribution and use in source and binary forms, with or without      *
+ * modification, are permitted provided that the following conditions      *
+ * are met:                                                                *
+ * 1. Redistributions of source code must retain the above copyright       *
+ *    notice, this list of conditions and the following disclaimer.        *
+ * 2. Redistributions in binary form must reproduce the above copyright    *
+ *    notice, this list of conditions and the following disclaimer in the  *
+ *    documentation and/or other materials provided with the distribution. *
+ * 4. Neither the name of the Author     nor the names of its contributors *
+ *    may be used to endorse or promote products derived from this software*
+ *    without specific prior written permission.                           *
+ *                                                                         *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND *
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR      *
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS  *
+ * BE LIABLEFOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR   *
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF    *
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS*
+ * INTERRUPTION)                                                           *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,     *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING   *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE      *
+ * POSSIBILITY OFSUCH DAMAGE.                                              *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EXAMPLE_H
+#define EXAMPLE_H
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#endif
+
+
+#include <squidlogparser.h>     // mandatory
+using namespace squidlogparser; // mandatory
+
+/*
+ * Compile:
+ * g++ -Wall -O2 -std=c++17 -lsquidlogparser -pthread ex-logformat.cc -o
+ * ex-logformat
+ *
+ * Usage stream: cat access.log | ./ex-logformat
+ *
+ * The log must have been written with the logformat directive below, which
+ * extends the squid format with %>ha, %<tt and %ssl::>sni.
+ */
+
+int
+main()
+{
+  using Fields = SquidLogParser::Fields;
+
+  SLPLogFormat lf_("logformat proxy %ts.%03tu %6tr %>a %Ss/%03>Hs %<st %rm "
+                   "%ru %[un %Sh/%<a %mt %>ha %<tt %ssl::>sni");
+  if (!lf_.isValid()) {
+    std::cout << ">>> invalid logformat\n";
+    exit(255);
+  }
+
+  // Codes without a counterpart in DataSet_Squid become generic columns.
+  std::cout << "Generic columns:";
+  for (const std::string& c_ : lf_.columns()) {
+    std::cout << " " << c_;
+  }
+  std::cout << "\n";
+
+  std::string raw_log_ = {};
+  SquidLogParser* p = new SquidLogParser(lf_);
+  while (std::getline(std::cin, raw_log_)) {
+    p->append(raw_log_);
+    if (p->errorNum() != SquidLogParser::SLPError::SLP_SUCCESS) {
+      std::cout << ">>> " << p->getErrorText() << "\n";
+      continue;
+    }
+    std::cout << p->getPartStr(Fields::CliSrcIpAddr) << " "
+              << p->getPartStr(Fields::ReqURL) << " "
+              << p->getPartCustom(std::string_view("ssl::>sni")) << " "
+              << p->getPartCustom(std::string_view("<tt")) << "\n";
+  }
+
+  std::cout << "Custom load = " << p->size() << "\n";
+
+  delete p;
+  return 0;
+}
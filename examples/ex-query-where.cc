@@ -0,0 +1,103 @@
+/***************************************************************************
+ * Copyright (c) 2022                                                      *
+ *      Volnei Cervi Puttini.  All rights reserved.                        *
+ *      vcputtini@gmail.com
+ *                                                                         *
+ * Redistribution and use in source and binary forms, with or without      *
+ * modification, are permitted provided that the following conditions      *
+ * are met:                                                                *
+ * 1. Redistributions of source code must retain the above copyright       *
+ *    notice, this list of conditions and the following disclaimer.        *
+ * 2. Redistributions in binary form must reproduce the above copyright    *
+ *    notice, this list of conditions and the following disclaimer in the  *
+ *    documentation and/or other materials provided with the distribution. *
+ * 4. Neither the name of the Author     nor the names of its contributors *
+ *    may be used to endorse or promote products derived from this software*
+ *    without specific prior written permission.                           *
+ *                                                                         *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND *
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE   *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR      *
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS  *
+ * BE LIABLEFOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR   *
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF    *
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS*
+ * INTERRUPTION)                                                           *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,     *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING   *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE      *
+ * POSSIBILITY OFSUCH DAMAGE.                                              *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EXAMPLE_H
+#define EXAMPLE_H
+#include <iostream>
+#include <string>
+#endif
+
+#include <squidlogparser.h>     // mandatory
+using namespace squidlogparser; // mandatory
+
+/*
+ * Compile:
+ * g++ -Wall -O2 -std=c++17 -lsquidlogparser -pthread ex-query-where.cc -o
+ * ex-query-where
+ *
+ * Usage stream: cat access.log | ./ex-query-where
+ *
+ * Several conditions tested in a single pass with SLPQuery::where(), instead
+ * of one field() call, and one scan, for each of them.
+ */
+
+int
+main()
+{
+  using LogFormat = SquidLogParser::LogFormat;
+  using SLPError = SquidLogParser::SLPError;
+  using Fields = SquidLogParser::Fields;
+  using Compare = SquidLogParser::Compare;
+
+  std::string raw_log_ = {};
+
+  SquidLogParser* p = new SquidLogParser(LogFormat::Squid);
+  while (std::getline(std::cin, raw_log_)) {
+    p->append(raw_log_);
+  }
+  std::cout << "Load Size == " << p->size() << "\n";
+
+  SLPQuery* qry = new SLPQuery(p);
+
+  /*
+   * The large replies of the local network, other than CONNECT and OPTIONS,
+   * or any request to a host of example.com.
+   */
+  const SLPExpr expr_ =
+    (SLPExpr::field(Fields::TotalSizeReply, Compare::GT, 50000) &&
+     !SLPExpr::in(Fields::ReqMethod, { "CONNECT", "OPTIONS" }) &&
+     SLPExpr::addr("172.50.1.0/24")) ||
+    SLPExpr::field(Fields::ReqURL, Compare::DOMAIN, "example.com");
+
+  qry
+    ->select("01/Feb/2022:00:00:00",
+             "172.50.1.1",
+             "28/Feb/2022:23:59:59",
+             "172.50.1.100")
+    .where(expr_);
+  if (qry->errorNum() != SLPError::SLP_SUCCESS) {
+    std::cout << "Error: " << qry->getErrorText() << "\n";
+  }
+
+  std::cout << "where size = " << qry->size() << '\n';
+  std::cout << "Sum total size reply   = " << qry->sumTotalSizeReply() << "\n";
+  std::cout << "Sum Response Time (ms) = " << qry->sumResponseTime() << "\n";
+
+  delete qry;
+  delete p;
+
+  return 0;
+}
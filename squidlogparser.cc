@@ -36,6 +36,26 @@
 
 #include "squidlogparser.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // SSE4.2/AVX2 intrinsics, see SLPDelimIndex
+#endif
+
+#include <fcntl.h> // open(), see SquidLogParser::loadFile()
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Decompression, see SLPDecompressor and CMakeLists.txt
+#if defined(ZLIB_EXTENSION)
+#include <zlib.h>
+#endif
+#if defined(LZMA_EXTENSION)
+#include <lzma.h>
+#endif
+#if defined(ZSTD_EXTENSION)
+#include <zstd.h>
+#endif
+
 namespace squidlogparser {
 
 /* Utilities ---------------------------------------------------------------- */
@@ -44,12 +64,12 @@ IPv4Addr::IPv4Addr()
   , num_(0UL){};
 
 IPv4Addr::IPv4Addr(const std::string addr_)
-  : str_(std::move(addr_)){};
+  : str_(std::move(addr_))
+  , num_(iptol(str_)){};
 
 IPv4Addr::IPv4Addr(const char* addr_)
-{
-  str_ = std::string(addr_, ::strlen(addr_));
-};
+  : str_(addr_, ::strlen(addr_))
+  , num_(iptol(str_)){};
 
 /*!
  * \brief IPv4Addr::getAddr
@@ -79,7 +99,7 @@ IPv4Addr::operator=(const IPv4Addr& rhs_)
   }
   if (isValid(rhs_.str_)) {
     str_ = rhs_.str_;
-    num_ = IPv4Addr::iptol(rhs_.str_);
+    num_ = rhs_.num_;
   } else {
     str_ = "Invalid Address";
     num_ = 0UL;
@@ -87,49 +107,6 @@ IPv4Addr::operator=(const IPv4Addr& rhs_)
   return *this;
 }
 
-bool
-IPv4Addr::operator>(const IPv4Addr& rhs_) const
-{
-  return IPv4Addr::iptol(str_) > IPv4Addr::iptol(rhs_.str_);
-}
-
-bool
-IPv4Addr::operator<(const IPv4Addr& rhs_) const
-{
-  return IPv4Addr::iptol(str_) < IPv4Addr::iptol(rhs_.str_);
-}
-
-bool
-IPv4Addr::operator==(const IPv4Addr& rhs_) const
-{
-  return IPv4Addr::iptol(str_) == IPv4Addr::iptol(rhs_.str_);
-}
-
-bool
-IPv4Addr::operator!=(const IPv4Addr& rhs_) const
-{
-  return IPv4Addr::iptol(str_) != IPv4Addr::iptol(rhs_.str_);
-}
-
-/**
- * \internal
- * \brief IPv4Addr::splitP Private member to internal use only.
- * \param arr_ std::array<std::string,4> with tokens
- * \param src String to be splited
- *
- */
-void
-IPv4Addr::splitP(std::array<std::string, 4>& arr_, const std::string src_)
-{
-  std::stringstream ss_(src_);
-  std::string tok_ = {};
-  int8_t i = 0;
-  while (std::getline(ss_, tok_, '.')) {
-    arr_[i] = std::move(tok_);
-    ++i;
-  }
-}
-
 /**
  * \internal
  * \brief IPv4Addr::isValid
@@ -140,8 +117,8 @@ IPv4Addr::splitP(std::array<std::string, 4>& arr_, const std::string src_)
 bool
 IPv4Addr::isValid(const std::string addr_)
 {
-  struct sockaddr_in saddr_in_;
-  return inet_pton(AF_INET, addr_.c_str(), &saddr_in_);
+  uint32_t n_ = 0;
+  return parse(addr_, n_);
 }
 
 /**
@@ -154,13 +131,8 @@ IPv4Addr::isValid(const std::string addr_)
 uint32_t
 IPv4Addr::iptol(const std::string addr)
 {
-  if (isValid(addr)) {
-    std::array<std::string, 4> a_;
-    IPv4Addr::splitP(a_, addr);
-    return (std::stol(a_[0]) << 24) | (std::stol(a_[1]) << 16) |
-           (std::stol(a_[2]) << 8) | std::stol(a_[3]);
-  }
-  return 0UL;
+  uint32_t n_ = 0;
+  return parse(addr, n_) ? n_ : 0UL;
 }
 
 /**
@@ -174,1362 +146,7455 @@ IPv4Addr::iptol(const std::string addr)
 std::string
 IPv4Addr::ltoip(uint32_t addr)
 {
-  std::stringstream ss;
-  ss << (addr >> 24) << "." << ((addr >> 16) & 0xFF) << "."
-     << ((addr >> 8) & 0xFF) << "." << (addr & 0xFF);
-  return ss.str();
+  Buffer buf_;
+  return std::string(format(addr, buf_));
 }
 
-/* --------------------------------------------------------------------------
- */
-
-/* Visitor ------------------------------------------------------------------
- */
 /*!
- * \internal
- * \brief After deducing the type of data stored in the var_t structure, it
- * returns a corresponding integer value.
- * \param t std::variant() structure with data stored for type deduction.
- * \return int Variable type.
+ * \brief Converts a dotted-decimal IPv4 address to its numeric form in a
+ * single pass. Accepts exactly what inet_pton(AF_INET) accepts: four octets
+ * from 0 to 255, without leading zeros.
+ * \param s_ Address, e.g. "192.168.1.110".
+ * \param addr_ Receives the address (3232235886). Untouched on failure.
+ * \return false if s_ is not a valid IPv4 address.
  */
-Visitor::TypeVar
-Visitor::varType(var_t t_) const
+bool
+IPv4Addr::parse(std::string_view s_, uint32_t& addr_)
 {
-  TypeVar typevar_ = {};
-  std::visit(
-    overloadedP{
-      [&typevar_]([[maybe_unused]] int arg) { typevar_ = TypeVar::TInt; },
-      [&typevar_]([[maybe_unused]] long arg) { typevar_ = TypeVar::TLong; },
-      [&typevar_]([[maybe_unused]] uint32_t arg) { typevar_ = TypeVar::TUint; },
-      [&typevar_]([[maybe_unused]] const std::string& arg) {
-        typevar_ = TypeVar::TString;
-      } },
-    t_);
-  return typevar_;
+  uint32_t result_ = 0;
+  uint32_t octet_ = 0;
+  int digits_ = 0;
+  int dots_ = 0;
+  for (const char c_ : s_) {
+    if (c_ >= '0' && c_ <= '9') {
+      if (digits_ > 0 && octet_ == 0) {
+        return false; // leading zero
+      }
+      octet_ = octet_ * 10 + (c_ - '0');
+      if (octet_ > 255) {
+        return false;
+      }
+      ++digits_;
+    } else if (c_ == '.' && digits_ > 0 && dots_ < 3) {
+      result_ = (result_ << 8) | octet_;
+      octet_ = 0;
+      digits_ = 0;
+      ++dots_;
+    } else {
+      return false;
+    }
+  }
+  if (dots_ != 3 || digits_ == 0) {
+    return false;
+  }
+  addr_ = (result_ << 8) | octet_;
+  return true;
 }
 
-/* SquidLogParser ---------------------------------------------------------- */
-SquidLogParser::SquidLogParser(LogFormat log_fmt_)
-  : logFmt_(std::move(log_fmt_))
-  , rawLog_({})
-  , logFileName_({})
-  , ds_squid_({})
-  , re_id_fmt_squid_(std::move(cp_id_fmt_squid_))
-  , re_id_fmt_common_(std::move(cp_id_fmt_common_))
-  , re_id_fmt_combined_(std::move(cp_id_fmt_combined_))
-  , re_id_fmt_referrer_(std::move(cp_id_fmt_referrer_))
-  , re_id_fmt_useragent_(std::move(cp_id_fmt_useragent_))
+/*!
+ * \brief Writes the dotted-decimal form of an IPv4 address to buf_.
+ * \param addr_ Address, e.g. 3232235886.
+ * \param buf_ Receives the text, null terminated.
+ * \return View of buf_ ("192.168.1.110"), valid while buf_ is.
+ */
+std::string_view
+IPv4Addr::format(uint32_t addr_, Buffer& buf_)
 {
-  std::signal(SIGINT, signalHandler);
-};
+  char* p_ = buf_.data();
+  for (int shift_ = 24; shift_ >= 0; shift_ -= 8) {
+    const unsigned octet_ = (addr_ >> shift_) & 0xFF;
+    if (octet_ >= 100) {
+      *p_++ = static_cast<char>('0' + octet_ / 100);
+    }
+    if (octet_ >= 10) {
+      *p_++ = static_cast<char>('0' + octet_ / 10 % 10);
+    }
+    *p_++ = static_cast<char>('0' + octet_ % 10);
+    *p_++ = '.';
+  }
+  *--p_ = '\0'; // replaces the last '.'
+  return std::string_view(buf_.data(), p_ - buf_.data());
+}
 
 /*!
- * \brief Appends the log entries to the system.
- * \param raw_log_
+ * \brief Converts an IPv6 address to its 16 bytes. Accepts what
+ * inet_pton(AF_INET6) accepts, including a trailing dotted IPv4 address
+ * (::ffff:192.168.1.110). Zone ids (%eth0) are not accepted.
+ * \param s_ Address, e.g. "2001:db8::1".
+ * \param addr_ Receives the address. Untouched on failure.
+ * \return false if s_ is not a valid IPv6 address.
  */
-SquidLogParser&
-SquidLogParser::append(const std::string& raw_log_)
+bool
+IPv6Addr::parse(std::string_view s_, Bytes& addr_)
 {
-  try {
-    rawLog_.resize(
-      raw_log_.size()); // try to lower the dynamic memory allocation a bit.
-    removeExtraWhiteSpaces(raw_log_, rawLog_);
-    switch (logFmt_) {
-      case LogFormat::Squid: {
-        if (parserSquid() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
-        }
-        break;
-      }
-      case LogFormat::Common: {
-        if (parserCommon() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(unixTimestamp(ds_squid_.localTime),
-                                  ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
-        }
-        break;
-      }
-      case LogFormat::Combined: {
-        if (parserCombined() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(unixTimestamp(ds_squid_.localTime),
-                                  ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
-        }
-        break;
-      }
-      case LogFormat::Referrer: {
-        if (parserReferrer() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
-        }
+  std::array<uint16_t, 8> words_ = {};
+  int n_ = 0;    // words read
+  int gap_ = -1; // position of "::"
+  size_t i_ = 0;
+  const size_t len_ = s_.size();
+
+  if (len_ < 2) {
+    return false;
+  }
+  if (s_[0] == ':') {
+    if (s_[1] != ':') {
+      return false;
+    }
+    gap_ = 0;
+    i_ = 2;
+  }
+
+  while (i_ < len_) {
+    if (n_ == 8) {
+      return false;
+    }
+    const size_t start_ = i_;
+    uint32_t word_ = 0;
+    while (i_ < len_ && i_ - start_ <= 4) {
+      const char c_ = s_[i_];
+      if (c_ >= '0' && c_ <= '9') {
+        word_ = (word_ << 4) | (c_ - '0');
+      } else if ((c_ | 0x20) >= 'a' && (c_ | 0x20) <= 'f') {
+        word_ = (word_ << 4) | ((c_ | 0x20) - 'a' + 10);
+      } else {
         break;
       }
-      case LogFormat::UserAgent: {
-        if (parserUserAgent() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(unixTimestamp(ds_squid_.localTime),
-                                  ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
-        }
-        break;
+      ++i_;
+    }
+    if (i_ < len_ && s_[i_] == '.') { // the last 32 bits as IPv4
+      uint32_t v4_ = 0;
+      if (n_ > 6 || !IPv4Addr::parse(s_.substr(start_), v4_)) {
+        return false;
       }
-      case LogFormat::Unknown: {
-        break;
+      words_[n_++] = static_cast<uint16_t>(v4_ >> 16);
+      words_[n_++] = static_cast<uint16_t>(v4_ & 0xFFFF);
+      break;
+    }
+    if (i_ == start_ || i_ - start_ > 4) {
+      return false;
+    }
+    words_[n_++] = static_cast<uint16_t>(word_);
+    if (i_ == len_) {
+      break;
+    }
+    if (s_[i_] != ':' || ++i_ == len_) {
+      return false;
+    }
+    if (s_[i_] == ':') {
+      if (gap_ >= 0) {
+        return false;
       }
+      gap_ = n_;
+      ++i_;
     }
-  } catch (const std::exception& e_) {
-    printException(e_, __FUNCTION__, __LINE__);
-    exit(EXIT_FAILURE);
-  };
+  }
 
-  return *this;
+  if (gap_ < 0 ? n_ != 8 : n_ > 7) {
+    return false;
+  }
+
+  Bytes out_ = {};
+  const int head_ = gap_ < 0 ? n_ : gap_;
+  for (int w_ = 0; w_ < n_; ++w_) {
+    const int at_ = w_ < head_ ? w_ : 8 - (n_ - w_);
+    out_[at_ * 2] = static_cast<uint8_t>(words_[w_] >> 8);
+    out_[at_ * 2 + 1] = static_cast<uint8_t>(words_[w_] & 0xFF);
+  }
+  addr_ = out_;
+  return true;
 }
 
 /*!
- * \brief Returns the number of log entries read.
- * \return size_t  Is an unsigned integral type.
+ * \brief Writes the text form of an IPv6 address to buf_, the same way as
+ * inet_ntop(AF_INET6): lower case, without leading zeros and with the
+ * longest run of zeros (two words or more) replaced by "::".
+ * \param addr_ Address.
+ * \param buf_ Receives the text, null terminated.
+ * \return View of buf_, valid while buf_ is.
  */
-size_t
-SquidLogParser::size() const
+std::string_view
+IPv6Addr::format(const Bytes& addr_, Buffer& buf_)
 {
-  return mEntry.size();
+  std::array<uint16_t, 8> words_;
+  for (int w_ = 0; w_ < 8; ++w_) {
+    words_[w_] =
+      static_cast<uint16_t>((addr_[w_ * 2] << 8) | addr_[w_ * 2 + 1]);
+  }
+
+  int best_ = -1;
+  int bestLen_ = 0;
+  for (int w_ = 0; w_ < 8;) {
+    if (words_[w_] != 0) {
+      ++w_;
+      continue;
+    }
+    const int run_ = w_;
+    while (w_ < 8 && words_[w_] == 0) {
+      ++w_;
+    }
+    if (w_ - run_ > bestLen_) {
+      best_ = run_;
+      bestLen_ = w_ - run_;
+    }
+  }
+  if (bestLen_ < 2) {
+    best_ = -1;
+  }
+
+  static constexpr char hex_[] = "0123456789abcdef";
+  char* p_ = buf_.data();
+  for (int w_ = 0; w_ < 8; ++w_) {
+    if (w_ == best_) {
+      *p_++ = ':';
+      w_ += bestLen_ - 1;
+      if (w_ == 7) {
+        *p_++ = ':';
+      }
+      continue;
+    }
+    if (w_ != 0) {
+      *p_++ = ':';
+    }
+    // ::a.b.c.d and ::ffff:a.b.c.d keep the IPv4 address in dotted form.
+    if (w_ == 6 && best_ == 0 &&
+        (bestLen_ == 6 || (bestLen_ == 5 && words_[5] == 0xFFFF))) {
+      IPv4Addr::Buffer v4_;
+      const std::string_view s_ = IPv4Addr::format(
+        (static_cast<uint32_t>(words_[6]) << 16) | words_[7], v4_);
+      p_ = std::copy(s_.begin(), s_.end(), p_);
+      break;
+    }
+    bool lead_ = true;
+    for (int shift_ = 12; shift_ >= 0; shift_ -= 4) {
+      const int digit_ = (words_[w_] >> shift_) & 0xF;
+      if (digit_ != 0 || !lead_ || shift_ == 0) {
+        *p_++ = hex_[digit_];
+        lead_ = false;
+      }
+    }
+  }
+  *p_ = '\0';
+  return std::string_view(buf_.data(), p_ - buf_.data());
 }
 
 /*!
- * \brief SquidLogParser::clear
+ * \brief Returns the IPv4-mapped IPv6 address of addr_ (::ffff:a.b.c.d).
  */
-void
-SquidLogParser::clear()
+IPv6Addr::Bytes
+IPv6Addr::fromIPv4(uint32_t addr_)
 {
-  mEntry.clear();
+  Bytes out_ = {};
+  out_[10] = 0xFF;
+  out_[11] = 0xFF;
+  out_[12] = static_cast<uint8_t>(addr_ >> 24);
+  out_[13] = static_cast<uint8_t>(addr_ >> 16);
+  out_[14] = static_cast<uint8_t>(addr_ >> 8);
+  out_[15] = static_cast<uint8_t>(addr_);
+  return out_;
 }
 
 /*!
- * \brief SquidLogParser::getPartInt
- * \param f_
- * \return int
+ * \brief Extracts the IPv4 address of an IPv4-mapped IPv6 address.
+ * \return false if addr_ is not in ::ffff:0:0/96.
  */
-int
-SquidLogParser::getPartInt(Fields f_) const
+bool
+IPv6Addr::toIPv4(const Bytes& addr_, uint32_t& v4_)
+{
+  static constexpr uint8_t prefix_[12] = { 0, 0, 0, 0, 0,    0,
+                                           0, 0, 0, 0, 0xFF, 0xFF };
+  if (std::memcmp(addr_.data(), prefix_, sizeof(prefix_)) != 0) {
+    return false;
+  }
+  v4_ = (static_cast<uint32_t>(addr_[12]) << 24) | (addr_[13] << 16) |
+        (addr_[14] << 8) | addr_[15];
+  return true;
+}
+
+/* SLPAddrDict ------------------------------------------------------------- */
+size_t
+SLPAddrDict::Hash::operator()(const IPv6Addr::Bytes& a_) const
 {
-  return intFields(f_, ds_squid_);
+  uint64_t hi_ = 0;
+  uint64_t lo_ = 0;
+  std::memcpy(&hi_, a_.data(), sizeof(hi_));
+  std::memcpy(&lo_, a_.data() + sizeof(hi_), sizeof(lo_));
+  return static_cast<size_t>((hi_ * 0x9E3779B97F4A7C15ULL) ^ lo_);
 }
 
 /*!
- * \brief SquidLogParser::getPartUInt
- * \param f_
- * \return uint32_t
+ * \internal
+ * \brief 0.0.0.0/8 is taken by the ids of the IPv6 addresses, so those IPv4
+ * addresses are stored as invalid (0).
  */
 uint32_t
-SquidLogParser::getPartUInt(Fields f_) const
+SLPAddrDict::fromIPv4(uint32_t v4_)
 {
-  return uint32Fields(f_, ds_squid_);
+  return isId(v4_) ? 0 : v4_;
 }
 
 /*!
- * \brief SquidLogParser::getPartStr
- * \param f_
- * \return std::string
+ * \brief Returns the code of an IPv4 or IPv6 address, adding the IPv6 ones
+ * to the dictionary.
+ * \return uint32_t Code, or 0 if s_ is not a valid address or if the
+ * dictionary is full.
  */
-std::string
-SquidLogParser::getPartStr(Fields f_) const
+uint32_t
+SLPAddrDict::encode(std::string_view s_)
 {
-  return strFields(f_, ds_squid_);
+  uint32_t v4_ = 0;
+  if (IPv4Addr::parse(s_, v4_)) {
+    return fromIPv4(v4_);
+  }
+  IPv6Addr::Bytes a_;
+  if (!IPv6Addr::parse(s_, a_)) {
+    return 0;
+  }
+  if (IPv6Addr::toIPv4(a_, v4_)) {
+    return fromIPv4(v4_);
+  }
+  return add(a_);
 }
 
 /*!
- * \brief addrToNumeric is a convenience function to be used
- * in simple conversions or together with the the DataKey() object.
- * \param addr_ IPv4 address in dot-decimal notation.
- * \return uint32_t Decimal representation.
- * \note DataKey usage:
- *
+ * \brief Returns the code in this dictionary of a code_ given by from_.
+ * Used to move entries between parsers. IPv4 codes are returned unchanged.
  */
 uint32_t
-SquidLogParser::addrToNumeric(const std::string addr_) const
+SLPAddrDict::import(const SLPAddrDict& from_, uint32_t code_)
 {
-  return (!addr_.empty() ? IPv4Addr::iptol(addr_) : 0UL);
+  if (!isId(code_)) {
+    return code_;
+  }
+  if (code_ > from_.addrs_.size()) {
+    return 0;
+  }
+  return add(from_.addrs_[code_ - 1]);
 }
 
 /*!
- * \brief numericToAddr, convenience function to be used in conversions.
- * \param ip_ Decimal IPv4 representation.
- * \return string IPv4 address in dot-decimal notation.
+ * \internal
+ * \brief Returns the id of an IPv6 address, giving it the next one if it is
+ * new.
+ * \return uint32_t Id, or 0 if the dictionary is full.
  */
-std::string
-SquidLogParser::numericToAddr(const uint32_t&& ip_) const
+uint32_t
+SLPAddrDict::add(const IPv6Addr::Bytes& a_)
 {
-  return (ip_ != 0UL ? IPv4Addr::ltoip(ip_) : std::string());
+  if (const auto it_ = ids_.find(a_); it_ != ids_.end()) {
+    return it_->second;
+  }
+  if (addrs_.size() >= maxId) {
+    return 0;
+  }
+  addrs_.push_back(a_);
+  const uint32_t id_ = static_cast<uint32_t>(addrs_.size());
+  ids_.emplace(a_, id_);
+  return id_;
 }
 
 /*!
- * \brief unixTimestamp, convenience function that convert the human-readable
- * format date to a Unix timestamp.
- * \param d_ string date 'n' time
- * \return uint32_t Epoch
- * \note Date format accepted:dd/Mmm/yyyy:hh:mm:ss [TZ]
- * \note TZ is ignored
+ * \brief Same as encode(), without adding anything to the dictionary.
+ * \return uint32_t Code, or 0 if the address is invalid or unknown.
  */
 uint32_t
-SquidLogParser::unixTimestamp(const std::string d_) const
+SLPAddrDict::find(std::string_view s_) const
 {
-  if (!d_.empty()) {
-    boost::regex re_(cp_fmt_squid_date);
-    boost::match_results<std::string::const_iterator> match;
-    boost::regex_match(d_, match, re_);
-    if (!match.empty()) {
-      auto [dd_, mm_, yy_, hh_, mn_, ss_] = std::tuple(std::stoi(match[1]),
-                                                       monthToNumber(match[2]),
-                                                       std::stoi(match[3]),
-                                                       std::stoi(match[4]),
-                                                       std::stoi(match[5]),
-                                                       std::stoi(match[6]));
+  uint32_t v4_ = 0;
+  if (IPv4Addr::parse(s_, v4_)) {
+    return fromIPv4(v4_);
+  }
+  IPv6Addr::Bytes a_;
+  if (!IPv6Addr::parse(s_, a_)) {
+    return 0;
+  }
+  if (IPv6Addr::toIPv4(a_, v4_)) {
+    return fromIPv4(v4_);
+  }
+  const auto it_ = ids_.find(a_);
+  return it_ != ids_.end() ? it_->second : 0;
+}
 
-      if ((dd_ >= 1 && dd_ <= 31) && (mm_ >= 1 && mm_ <= 12) && (yy_ >= 1970) &&
-          (hh_ >= 0 && hh_ <= 23) && (mn_ >= 0 && mn_ <= 59) &&
-          (ss_ >= 0 && ss_ <= 59)) {
-        std::tm tm_ = mkTime(d_);
-        return std::mktime(&tm_);
-      }
-    }
+/*!
+ * \brief Returns the address of a code as IPv6. IPv4 addresses are returned
+ * IPv4-mapped.
+ * \return false if code_ is 0 or an unknown id.
+ */
+bool
+SLPAddrDict::decode(uint32_t code_, IPv6Addr::Bytes& addr_) const
+{
+  if (code_ == 0) {
+    return false;
   }
-  return 0;
+  if (!isId(code_)) {
+    addr_ = IPv6Addr::fromIPv4(code_);
+    return true;
+  }
+  if (code_ > addrs_.size()) {
+    return false;
+  }
+  addr_ = addrs_[code_ - 1];
+  return true;
 }
 
 /*!
- * \brief unixToSquidDate, convenience function that convert the numeric
- * Unix timestamp to a human-readable format date.
- * \param uts_ Unix Timestamp.
- * \return std::string Squid-format date in human-readable.
+ * \brief Returns the text form of a code: dotted-decimal for IPv4 and
+ * inet_ntop() style for IPv6.
  */
 std::string
-SquidLogParser::unixToSquidDate(std::time_t uts_) const
+SLPAddrDict::text(uint32_t code_) const
 {
-  char buf_[27];
-  struct std::tm tm_ = { *std::localtime(&uts_) };
-  ::strftime(buf_, sizeof(buf_), "%d/%b/%Y:%H:%M:%S %z", &tm_);
-  return std::string(buf_);
+  if (!isId(code_)) {
+    return IPv4Addr::ltoip(code_);
+  }
+  IPv6Addr::Bytes a_;
+  if (!decode(code_, a_)) {
+    return std::string();
+  }
+  IPv6Addr::Buffer buf_;
+  return std::string(IPv6Addr::format(a_, buf_));
 }
 
 /*!
- * \brief Converts log entries to XML format and writes to file.
- * \param fn File name with path (Mandatory).
- * \param Beginning date
- * \param Beginning time
- * \param End date
- * \param End time
- *
- * \note If the user does not inform the '.xml' extension, the library will
- * provide it. If another extension is informed, it will not be considered
- * valid and the function will return -1.
- *
- * \warning Important: The SLPRawToXML object will always erase the data read
- * after writing the XML file.
+ * \brief Builds the range [lo_, hi_]. Each end may be IPv4 or IPv6, and
+ * may be a CIDR block, e.g. 10.20.0.0/16: lo_ then stands for the first
+ * address of the block and hi_ for the last one, so that
+ * range("10.20.0.0/16", "10.20.0.0/16", r_) is the whole block.
+ * \return false if one of them is not a valid address or is 0.0.0.0.
  */
-
-SquidLogParser::SLPError
-SquidLogParser::toXML(const std::string&& fn_,
-                      const std::string&& d0_,
-                      const std::string&& ip0_,
-                      const std::string&& d1_,
-                      const std::string&& ip1_)
+bool
+SLPAddrDict::range(std::string_view lo_, std::string_view hi_, Range& r_)
 {
-
-  if (fn_.empty()) {
-    setError(SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT);
-    return SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT;
-  }
-
-  if ((slpError_ == SLPError::SLP_SUCCESS) && (size() > 0)) {
-    uint32_t min = unixTimestamp(d0_);
-    uint32_t ip0 = addrToNumeric(ip0_);
-
-    uint32_t max = unixTimestamp(d1_);
-    uint32_t ip1 = addrToNumeric(ip1_);
-
-    SLPRawToXML xml(logFmt_, size());
-    if (xml.save(fn_) != SLPError::SLP_SUCCESS) {
-      setError(SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT);
-      return SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT;
+  auto bound_ = [](std::string_view s_,
+                   bool last_,
+                   IPv6Addr::Bytes& a_,
+                   uint32_t& v4_) {
+    int bits_ = -1; // no prefix length
+    if (const size_t slash_ = s_.find('/');
+        slash_ != std::string_view::npos) {
+      const char* end_ = s_.data() + s_.size();
+      const auto [p_, ec_] =
+        std::from_chars(s_.data() + slash_ + 1, end_, bits_);
+      if (ec_ != std::errc() || p_ != end_ || bits_ < 0) {
+        return false;
+      }
+      s_ = s_.substr(0, slash_);
     }
-    if ((!d0_.empty() && !ip0_.empty()) && (!d1_.empty() && !ip1_.empty())) {
-      for (auto it_ = mEntry.cbegin(); it_ != mEntry.cend(); ++it_) {
-        if ((it_->first.getTs() >= min) && (it_->first.getTs() <= max) &&
-            (it_->first.getIp() >= ip0) && (it_->first.getIp() <= ip1)) {
-          xml.append(it_->second);
-        }
+
+    v4_ = 0;
+    if (IPv4Addr::parse(s_, v4_)) {
+      if (bits_ > 32) {
+        return false;
       }
-    } else {
-      for (const auto& a : mEntry) {
-        xml.append(a.second);
+      if (bits_ >= 0) {
+        const uint32_t host_ = bits_ == 32 ? 0 : UINT32_MAX >> bits_;
+        // 0.0.0.0 is not an address, the block starts at 0.0.0.1.
+        v4_ = last_ ? (v4_ | host_) : std::max(v4_ & ~host_, 1U);
       }
+      a_ = IPv6Addr::fromIPv4(v4_);
+      return v4_ != 0;
     }
-    if (xml.close() != SLPError::SLP_SUCCESS) {
-      setError(SLPError::SLP_ERR_XML_FILE_NOT_SAVE);
-      return SLPError::SLP_ERR_XML_FILE_NOT_SAVE;
+    if (!IPv6Addr::parse(s_, a_) || bits_ > 128) {
+      return false;
     }
+    for (int i_ = 0; bits_ >= 0 && i_ < static_cast<int>(a_.size()); ++i_) {
+      const int keep_ = std::clamp(bits_ - i_ * 8, 0, 8);
+      const uint8_t host_ = static_cast<uint8_t>(0xFF >> keep_);
+      a_[i_] = last_ ? (a_[i_] | host_) : (a_[i_] & ~host_);
+    }
+    return true;
+  };
+
+  r_ = {};
+  if (!bound_(lo_, false, r_.lo_, r_.lo4_) ||
+      !bound_(hi_, true, r_.hi_, r_.hi4_)) {
+    return false;
   }
-  return SLPError::SLP_SUCCESS;
+  r_.v4_ = IPv6Addr::toIPv4(r_.lo_, r_.lo4_) &&
+           IPv6Addr::toIPv4(r_.hi_, r_.hi4_);
+  return true;
 }
 
 /*!
- * \brief Show decoded URL
- * \param raw_ Raw URL
- * \return string URL decoded.
- *
- * \note This function is the result of Internet research and adaptations that
- * we consider convenient.
+ * \brief True if the address of code_ is within r_.
  */
-std::string
-SquidLogParser::ShowDecodedUrl(const std::string raw_) const
+bool
+SLPAddrDict::contains(const Range& r_, uint32_t code_) const
 {
-  std::string tmp_(raw_, raw_.size()); // tries to decrease dynamic allocation.
-
-  for (auto it_ = raw_.cbegin(); it_ != raw_.cend(); ++it_) {
-    switch (*it_) {
-      case '%': {
-        ++it_;
-        std::string byte_;
-        byte_.push_back(std::move(*it_));
-        ++it_;
-        byte_.push_back(std::move(*it_));
-        tmp_.push_back(
-          std::move(static_cast<unsigned char>(std::stol(byte_, nullptr, 16))));
-        break;
-      }
-      case '+': {
-        tmp_.push_back(std::move(' '));
-        break;
-      }
-      default: {
-        tmp_.push_back(std::move(*it_));
-      }
-    }
+  if (r_.v4_ && !isId(code_)) {
+    return code_ != 0 && code_ >= r_.lo4_ && code_ <= r_.hi4_;
   }
-  return tmp_;
+  IPv6Addr::Bytes a_;
+  return decode(code_, a_) && r_.lo_ <= a_ && a_ <= r_.hi_;
 }
 
-/* protected----------------------------------------------------------------
- */
 /*!
- * \internal
- * \brief Simple recursive uppercase to lowercase characters conversion.
- * \param s_ Text with (maybe) uppercase  characteres.
- * \return Text in lowercase.
+ * \brief Approximate bytes allocated by the dictionary.
  */
-template<typename TString, typename TSize>
-TString
-SquidLogParser::toLower(TString s_, TSize sz_)
+size_t
+SLPAddrDict::bytes() const
 {
-  if (sz_ != s_.size()) {
-    s_[sz_] = ::tolower(s_[sz_]);
-    s_ = toLower(s_, ++sz_);
-  }
-  return s_;
+  return addrs_.capacity() * sizeof(IPv6Addr::Bytes) +
+         ids_.size() * (sizeof(std::pair<IPv6Addr::Bytes, uint32_t>) +
+                        2 * sizeof(void*)) +
+         ids_.bucket_count() * sizeof(void*);
 }
 
 /*!
- * \brief Returns the right part of string until the end. From position+1 of
- * the informed separator.
- *
- * \param src_
- * \param sep_
- * \return std::string
- *
- * \example std::string s_ = strRight("NONE/200"s,'/'); // s_ = "200";
- *
+ * \brief Forgets every IPv6 address. The ids given so far become invalid.
  */
-std::string
-SquidLogParser::strRight(const std::string src_, const char sep_) const
+void
+SLPAddrDict::clear()
 {
-  if (size_t f = std::string_view{ src_ }.find(sep_); f != std::string::npos) {
-    return src_.substr(f + 1, src_.length());
-  }
-  return std::string();
+  ids_.clear();
+  addrs_.clear();
 }
 
 /*!
- * \internal
- * \brief Returns the filename extension, if there is one, in the URL passed as
- * an argument. Only the HTTP and HTTPS protocols are valid.
- *
- * \param url_ URL
- *
- * \return Returns the extension along with the period, otherwise it returns an
- * empty string.
- *
- * Examples of valid extensions: .xml .js .jpeg .woff .woff2
- *
- * Examples of invalid extensions: Any extension that
- * does not consist exclusively of numbers or alphabetic characters.
- * e.g: .gif%3Fpartner%3Dadobe%26partner_uid%3D$%7BDD_UUID%7D
+ * \brief Adds the addresses to out_, as one section.
  */
-std::string
-SquidLogParser::getFiletype(const std::string& url_) const
+void
+SLPAddrDict::save(SLPSnapshot& out_) const
 {
-  namespace fs = std::filesystem;
+  out_.add(addrs_);
+}
 
-  if (const size_t f_ = std::string_view{ url_ }.find("http", 0, 4);
-      f_ != std::string::npos) {
-    fs::path path_(url_);
+/*!
+ * \brief Replaces the addresses with the ones written by save(). Each one
+ * gets back its id.
+ * \return false if the section is missing or has the same address twice.
+ */
+bool
+SLPAddrDict::load(SLPSnapshot& in_)
+{
+  clear();
+  if (!in_.read(addrs_) || addrs_.size() > maxId) {
+    addrs_.clear();
+    return false;
+  }
+  ids_.reserve(addrs_.size());
+  for (uint32_t i_ = 0; i_ < addrs_.size(); ++i_) {
+    if (!ids_.emplace(addrs_[i_], i_ + 1).second) {
+      clear();
+      return false;
+    }
+  }
+  return true;
+}
 
-    std::string extension_(path_.extension());
+/* --------------------------------------------------------------------------
+ */
 
-    if (!extension_.empty()) {
+/* Visitor ------------------------------------------------------------------
+ */
+/*!
+ * \internal
+ * \brief After deducing the type of data stored in the var_t structure, it
+ * returns a corresponding integer value.
+ * \param t std::variant() structure with data stored for type deduction.
+ * \return int Variable type.
+ */
+Visitor::TypeVar
+Visitor::varType(var_t t_) const
+{
+  TypeVar typevar_ = {};
+  std::visit(
+    overloadedP{
+      [&typevar_]([[maybe_unused]] int arg) { typevar_ = TypeVar::TInt; },
+      [&typevar_]([[maybe_unused]] long arg) { typevar_ = TypeVar::TLong; },
+      [&typevar_]([[maybe_unused]] uint32_t arg) { typevar_ = TypeVar::TUint; },
+      [&typevar_]([[maybe_unused]] const std::string& arg) {
+        typevar_ = TypeVar::TString;
+      } },
+    t_);
+  return typevar_;
+}
 
-      if (std::any_of(extension_.cbegin(),
-                      extension_.cend(),
-                      [](unsigned char c) -> bool {
-                        if (c == '.' || c == '?') {
-                          return false;
-                        }
-                        return std::ispunct(c);
-                      })) {
-        return std::string();
-      }
+/* SLPDelimIndex ------------------------------------------------------------
+ */
+namespace {
+/*
+ * The kernels append to out_ the offset (plus base_) of every delimiter found
+ * in p_[0 .. n_) and return how many were found, i.e. at most n_.
+ */
+size_t
+delimScalar(const char* p_, size_t n_, uint32_t base_, uint32_t* out_)
+{
+  uint32_t* o_ = out_;
+  for (size_t i_ = 0; i_ < n_; ++i_) {
+    if (SLPDelimIndex::isDelimiter(p_[i_])) {
+      *o_++ = base_ + static_cast<uint32_t>(i_);
+    }
+  }
+  return o_ - out_;
+}
 
-      const auto size_ = extension_.size() - 1;
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * PCMPESTRM in "ranges" mode: [\t-\r] [ - ] ["-"] [[-]].
+ */
+__attribute__((target("sse4.2"))) size_t
+delimSSE42(const char* p_, size_t n_, uint32_t base_, uint32_t* out_)
+{
+  const __m128i ranges_ = _mm_setr_epi8(
+    '\t', '\r', ' ', ' ', '"', '"', '[', ']', 0, 0, 0, 0, 0, 0, 0, 0);
+  uint32_t* o_ = out_;
+  size_t i_ = 0;
+  for (; i_ + 16 <= n_; i_ += 16) {
+    const __m128i v_ =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_ + i_));
+    const __m128i m_ = _mm_cmpestrm(
+      ranges_, 8, v_, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_BIT_MASK);
+    uint32_t mask_ = static_cast<uint32_t>(_mm_cvtsi128_si32(m_)) & 0xFFFF;
+    while (mask_ != 0) {
+      *o_++ = base_ + static_cast<uint32_t>(i_ + __builtin_ctz(mask_));
+      mask_ &= mask_ - 1;
+    }
+  }
+  o_ += delimScalar(p_ + i_, n_ - i_, base_ + static_cast<uint32_t>(i_), o_);
+  return o_ - out_;
+}
 
-      if (!std::isalpha(extension_[size_]) || std::isdigit(extension_[size_])) {
-        extension_.erase(--extension_.end());
-        return extension_;
-      }
-      return extension_;
+/*
+ * Two unsigned range tests (x - lo <= hi - lo, via min == x) cover
+ * [\t-\r] and [[-]]; ' ' and '"' are plain comparisons.
+ */
+__attribute__((target("avx2"))) size_t
+delimAVX2(const char* p_, size_t n_, uint32_t base_, uint32_t* out_)
+{
+  const __m256i tab_ = _mm256_set1_epi8('\t');
+  const __m256i tabSpan_ = _mm256_set1_epi8('\r' - '\t');
+  const __m256i bracket_ = _mm256_set1_epi8('[');
+  const __m256i bracketSpan_ = _mm256_set1_epi8(']' - '[');
+  const __m256i space_ = _mm256_set1_epi8(' ');
+  const __m256i quote_ = _mm256_set1_epi8('"');
+  uint32_t* o_ = out_;
+  size_t i_ = 0;
+  for (; i_ + 32 <= n_; i_ += 32) {
+    const __m256i v_ =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_ + i_));
+    const __m256i w_ = _mm256_sub_epi8(v_, tab_);
+    const __m256i b_ = _mm256_sub_epi8(v_, bracket_);
+    const __m256i m_ = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(w_, tabSpan_), w_),
+                      _mm256_cmpeq_epi8(_mm256_min_epu8(b_, bracketSpan_), b_)),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v_, space_),
+                      _mm256_cmpeq_epi8(v_, quote_)));
+    uint32_t mask_ = static_cast<uint32_t>(_mm256_movemask_epi8(m_));
+    while (mask_ != 0) {
+      *o_++ = base_ + static_cast<uint32_t>(i_ + __builtin_ctz(mask_));
+      mask_ &= mask_ - 1;
     }
   }
-  return std::string();
+  o_ += delimScalar(p_ + i_, n_ - i_, base_ + static_cast<uint32_t>(i_), o_);
+  return o_ - out_;
 }
+#endif
+} // namespace
 
 /*!
- * \internal
- * \brief Returns true or false if month name is corret
- * \param s Month name abbreviation
- * \return true|false
- * \code{.cc}
- * bool b = isMonth("Jan");
- * \endcode
+ * \brief Creates an empty index.
+ * \param kernel_ Kernel to be used. If the CPU does not support it, the best
+ * one available is used instead.
  */
-bool
-SquidLogParser::isMonth(const std::string&& s_)
+SLPDelimIndex::SLPDelimIndex(Kernel kernel_)
+  : kernel_(std::min(kernel_, bestKernel()))
+  , pos_({})
+  , size_(0)
 {
-  auto begin_ = std::cbegin(nmonths_);
-  auto end_ = std::cend(nmonths_);
+}
 
-  const auto f_ = std::find_if(begin_, end_, [&s_](const char* cptr_) {
-    if (std::strcmp(s_.c_str(), cptr_) == 0) {
-      return true;
+/*!
+ * \brief Returns the fastest kernel supported by the running CPU.
+ */
+SLPDelimIndex::Kernel
+SLPDelimIndex::bestKernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  static const Kernel best_ = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return Kernel::AVX2;
     }
-    return false;
-  });
-
-  return (f_ != end_);
+    if (__builtin_cpu_supports("sse4.2")) {
+      return Kernel::SSE42;
+    }
+    return Kernel::Scalar;
+  }();
+  return best_;
+#else
+  return Kernel::Scalar;
+#endif
 }
 
 /*!
- * \internal
- * \brief Converts the month's name abbreviation to number.
- * \param s_
- * \return int
+ * \brief Indexes the delimiters of buf_[0 .. len_), replacing the previous
+ * contents of the index.
+ * \return Number of delimiters found.
  */
-int
-SquidLogParser::monthToNumber(const std::string&& s_) const
+size_t
+SLPDelimIndex::build(const char* buf_, size_t len_)
 {
-  auto begin_ = std::cbegin(nmonths_);
-  auto end_ = std::cend(nmonths_);
-
-  const auto f_ = std::find_if(begin_, end_, [&s_](const char* cptr_) {
-    if (std::strcmp(s_.c_str(), cptr_) == 0) {
-      return true;
+  // Worked in slices, so that the worst case (every byte is a delimiter) only
+  // needs room for one slice beyond what has already been found.
+  constexpr size_t slice_ = 4096;
+  size_ = 0;
+  for (size_t off_ = 0; off_ < len_; off_ += slice_) {
+    const size_t n_ = std::min(slice_, len_ - off_);
+    if (pos_.size() < size_ + n_) {
+      pos_.resize(std::max(pos_.size() * 2, size_ + slice_));
+    }
+    uint32_t* out_ = pos_.data() + size_;
+    const uint32_t base_ = static_cast<uint32_t>(off_);
+    switch (kernel_) {
+#if defined(__x86_64__) || defined(__i386__)
+      case Kernel::AVX2:
+        size_ += delimAVX2(buf_ + off_, n_, base_, out_);
+        break;
+      case Kernel::SSE42:
+        size_ += delimSSE42(buf_ + off_, n_, base_, out_);
+        break;
+#endif
+      default:
+        size_ += delimScalar(buf_ + off_, n_, base_, out_);
+        break;
     }
-    return false;
-  });
-
-  if (f_ != end_) {
-    return std::distance(begin_, f_) + 1;
   }
-  return 0;
+  return size_;
 }
 
+/* SLPLineArena ------------------------------------------------------------ */
 /*!
- * \brief Converts the month's number to abbreviation name.
- * \param m_ A number between 1 and 12
- * \return Abbrev of month's name
+ * \brief Creates an empty arena. No memory is allocated until the first
+ * line is stored.
+ * \param chunk_size_ Size of each chunk, in bytes.
  */
-std::string
-SquidLogParser::numberToMonth(const int&& m_) const
+SLPLineArena::SLPLineArena(size_t chunk_size_)
+  : chunkSize_(std::max<size_t>(chunk_size_, 1))
+  , chunks_()
+  , head_(nullptr)
+  , room_(0)
+  , bytes_(0)
+  , capacity_(0)
 {
-  if ((m_ >= 1) && (m_ <= 12)) {
-    return std::string(nmonths_[m_ - 1]);
-  }
-  return std::string();
 }
 
 /*!
- * \internal
- * \brief Parses date and time strings and save the values inside std::tm.
- * \param d_ Date (dd/Mmm/yyyy:hh:mm:ss -0000)
- * \return std::tm
+ * \brief Copies line_ to the arena.
+ * \return View of the copy. It is not null terminated.
  */
-std::tm
-SquidLogParser::mkTime(const std::string d_) const
+std::string_view
+SLPLineArena::store(std::string_view line_)
 {
-  struct std::tm tm_tmp = {};
-  tm_tmp.tm_year = std::move(std::stoi(d_.substr(7, 4))) - 1900;
-  tm_tmp.tm_mon = std::move(monthToNumber(d_.substr(3, 3))) - 1;
-  tm_tmp.tm_mday = std::move(std::stoi(d_.substr(0, 2)));
-  tm_tmp.tm_hour = std::move(std::stoi(d_.substr(12, 2)));
-  tm_tmp.tm_min = std::move(std::stoi(d_.substr(15, 2)));
-  tm_tmp.tm_sec = std::move(std::stoi(d_.substr(18, 2)));
-
-  return tm_tmp;
+  if (line_.empty()) {
+    return std::string_view();
+  }
+  if (line_.size() > room_) {
+    const size_t size_ = std::max(chunkSize_, line_.size());
+    chunks_.push_back({ std::unique_ptr<char[]>(new char[size_]), size_, 0 });
+    head_ = chunks_.back().data_.get();
+    room_ = size_;
+    capacity_ += size_;
+  }
+  char* dst_ = head_;
+  std::memcpy(dst_, line_.data(), line_.size());
+  head_ += line_.size();
+  room_ -= line_.size();
+  bytes_ += line_.size();
+  chunks_.back().used_ += line_.size();
+  return std::string_view(dst_, line_.size());
 }
 
 /*!
- * \internal
- * \brief SquidLogParser::setError
- * \param e_ Error code
+ * \brief Gives back the space of the last line stored, e.g. when it could
+ * not be parsed. Does nothing if last_ is not the last line of the arena.
  */
 void
-SquidLogParser::setError(SLPError e_)
+SLPLineArena::release(std::string_view last_)
 {
-  slpError_ = e_;
+  if (!chunks_.empty() && last_.data() + last_.size() == head_) {
+    head_ -= last_.size();
+    room_ += last_.size();
+    bytes_ -= last_.size();
+    chunks_.back().used_ -= last_.size();
+  }
 }
 
-std::string
-SquidLogParser::getErrorRE(boost::regex_error& e_) const
+/*!
+ * \brief Takes the chunks of other_, which is left empty. The views returned
+ * by other_ stay valid and are now owned by this arena.
+ */
+void
+SLPLineArena::adopt(SLPLineArena& other_)
 {
-  switch (e_.code()) {
-    case boost::regex_constants::error_collate: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_COLLATE);
+  // The chunk being filled stays the last one.
+  chunks_.insert(chunks_.begin(),
+                 std::make_move_iterator(other_.chunks_.begin()),
+                 std::make_move_iterator(other_.chunks_.end()));
+  bytes_ += other_.bytes_;
+  capacity_ += other_.capacity_;
+  other_.chunks_.clear();
+  other_.clear();
+}
+
+/*!
+ * \brief Frees the chunks, except the one being filled, that hold none of
+ * the addresses in live_, e.g. one character of each line still in use. The
+ * views into the chunks freed become invalid.
+ * \return Bytes freed.
+ */
+size_t
+SLPLineArena::releaseUnused(std::vector<const char*> live_)
+{
+  if (chunks_.size() < 2) {
+    return 0;
+  }
+  std::sort(live_.begin(), live_.end());
+  const size_t before_ = capacity_;
+  auto used_ = [&live_](const Chunk& c_) {
+    const char* begin_ = c_.data_.get();
+    const auto it_ = std::lower_bound(live_.begin(), live_.end(), begin_);
+    return it_ != live_.end() && *it_ < begin_ + c_.size_;
+  };
+  auto last_ = std::remove_if(
+    chunks_.begin(), chunks_.end() - 1, [&](const Chunk& c_) {
+      if (used_(c_)) {
+        return false;
+      }
+      capacity_ -= c_.size_;
+      bytes_ -= c_.used_;
+      return true;
+    });
+  chunks_.erase(last_, chunks_.end() - 1);
+  return before_ - capacity_;
+}
+
+/*!
+ * \brief Frees every chunk. The views returned so far become invalid.
+ */
+void
+SLPLineArena::clear()
+{
+  chunks_.clear();
+  head_ = nullptr;
+  room_ = 0;
+  bytes_ = 0;
+  capacity_ = 0;
+}
+
+/* SLPDictionary ----------------------------------------------------------- */
+/*!
+ * \brief Copies the values. The codes are the same as in other_.
+ */
+SLPDictionary::SLPDictionary(const SLPDictionary& other_)
+  : values_(other_.values_)
+{
+  codes_.reserve(values_.size());
+  for (uint32_t c_ = 0; c_ < values_.size(); ++c_) {
+    codes_.emplace(values_[c_], c_);
+  }
+}
+
+/*!
+ * \brief Same as the copy constructor.
+ */
+SLPDictionary&
+SLPDictionary::operator=(const SLPDictionary& other_)
+{
+  if (this != &other_) {
+    SLPDictionary copy_(other_);
+    values_.swap(copy_.values_);
+    codes_.swap(copy_.codes_);
+  }
+  return *this;
+}
+
+/*!
+ * \brief Returns the code of s_, giving it the next one if it is new.
+ */
+uint32_t
+SLPDictionary::encode(std::string_view s_)
+{
+  if (const auto it_ = codes_.find(s_); it_ != codes_.end()) {
+    return it_->second;
+  }
+  const uint32_t c_ = static_cast<uint32_t>(values_.size());
+  codes_.emplace(values_.emplace_back(s_), c_);
+  return c_;
+}
+
+/*!
+ * \brief Returns the code of s_, or npos if it is not in the dictionary.
+ */
+uint32_t
+SLPDictionary::find(std::string_view s_) const
+{
+  const auto it_ = codes_.find(s_);
+  return it_ != codes_.end() ? it_->second : npos;
+}
+
+/*!
+ * \brief Adds the values of from_ that are not here yet.
+ * \return For each code of from_, its code in this dictionary.
+ */
+std::vector<uint32_t>
+SLPDictionary::merge(const SLPDictionary& from_)
+{
+  std::vector<uint32_t> map_;
+  map_.reserve(from_.size());
+  for (const std::string& v_ : from_.values_) {
+    map_.push_back(encode(v_));
+  }
+  return map_;
+}
+
+/*!
+ * \brief Approximate bytes allocated by the dictionary.
+ */
+size_t
+SLPDictionary::bytes() const
+{
+  size_t n_ = values_.size() * (sizeof(std::string) +
+                                sizeof(std::pair<std::string_view, uint32_t>) +
+                                2 * sizeof(void*));
+  for (const std::string& v_ : values_) {
+    if (v_.capacity() > std::string().capacity()) {
+      n_ += v_.capacity() + 1;
+    }
+  }
+  return n_;
+}
+
+/*!
+ * \brief Adds the values to out_, in code order.
+ */
+void
+SLPDictionary::save(SLPSnapshot& out_) const
+{
+  out_.addStrings(
+    std::vector<std::string_view>(values_.begin(), values_.end()));
+}
+
+/*!
+ * \brief Replaces the values with the ones written by save(). Each one gets
+ * back its code.
+ * \return false if the sections are missing or a value is repeated.
+ */
+bool
+SLPDictionary::load(SLPSnapshot& in_)
+{
+  *this = SLPDictionary();
+  std::vector<std::string_view> values_in_;
+  if (!in_.readStrings(values_in_)) {
+    return false;
+  }
+  codes_.reserve(values_in_.size());
+  for (const std::string_view v_ : values_in_) {
+    encode(v_);
+  }
+  return values_.size() == values_in_.size();
+}
+
+/* SLPDateDecoder ---------------------------------------------------------- */
+SLPDateDecoder::SLPDateDecoder()
+  : day_({})
+  , dayEpoch_(0)
+{
+}
+
+/*!
+ * \brief Converts dd/Mmm/yyyy:hh:mm:ss [+-zzzz] to a Unix timestamp.
+ * \param d_ Date. Anything after the seconds other than a UTC offset is
+ * ignored.
+ * \return uint32_t Epoch, or 0 if d_ is not a valid date.
+ */
+uint32_t
+SLPDateDecoder::decode(std::string_view d_)
+{
+  // 0         1         2
+  // 012345678901234567890123456
+  // 31/Jan/2022:21:00:00 -0300
+  int hh_ = 0;
+  int mn_ = 0;
+  int ss_ = 0;
+  if (d_.size() < 20 || d_[2] != '/' || d_[6] != '/' || d_[11] != ':' ||
+      d_[14] != ':' || d_[17] != ':' || !digits(d_, 12, 2, hh_) ||
+      !digits(d_, 15, 2, mn_) || !digits(d_, 18, 2, ss_) || hh_ > 23 ||
+      mn_ > 59 || ss_ > 59) {
+    return 0;
+  }
+
+  int dd_ = 0;
+  int yy_ = 0;
+  if (std::memcmp(day_.data(), d_.data(), day_.size()) != 0) {
+    const int mm_ = monthNumber(d_.substr(3, 3));
+    if (!digits(d_, 0, 2, dd_) || !digits(d_, 7, 4, yy_) || dd_ < 1 ||
+        dd_ > 31 || mm_ == 0 || yy_ < 1970) {
+      return 0;
+    }
+    dayEpoch_ = daysFromCivil(yy_, mm_, dd_) * 86400;
+    std::memcpy(day_.data(), d_.data(), day_.size());
+  }
+
+  const int64_t time_ = hh_ * 3600 + mn_ * 60 + ss_;
+  int zh_ = 0;
+  int zm_ = 0;
+  if (d_.size() >= 26 && d_[20] == ' ' && (d_[21] == '+' || d_[21] == '-') &&
+      digits(d_, 22, 2, zh_) && digits(d_, 24, 2, zm_)) {
+    const int64_t offset_ = (zh_ * 3600 + zm_ * 60) * (d_[21] == '-' ? -1 : 1);
+    return static_cast<uint32_t>(dayEpoch_ + time_ - offset_);
+  }
+
+  // No UTC offset: local time.
+  std::tm tm_ = {};
+  std::time_t t_ = static_cast<std::time_t>(dayEpoch_ + time_);
+  gmtime_r(&t_, &tm_);
+  tm_.tm_isdst = -1;
+  return static_cast<uint32_t>(std::mktime(&tm_));
+}
+
+/*!
+ * \brief Converts a month abbreviation (Jan ... Dec) to its number.
+ * \return int 1 to 12, or 0 if m_ is not a month.
+ */
+int
+SLPDateDecoder::monthNumber(std::string_view m_)
+{
+  if (m_.size() != 3) {
+    return 0;
+  }
+  // The three letters are unique when packed in 24 bits.
+  const uint32_t key_ = (static_cast<uint8_t>(m_[0]) << 16) |
+                        (static_cast<uint8_t>(m_[1]) << 8) |
+                        static_cast<uint8_t>(m_[2]);
+  switch (key_) {
+    case 0x4a616e: // Jan
+      return 1;
+    case 0x466562: // Feb
+      return 2;
+    case 0x4d6172: // Mar
+      return 3;
+    case 0x417072: // Apr
+      return 4;
+    case 0x4d6179: // May
+      return 5;
+    case 0x4a756e: // Jun
+      return 6;
+    case 0x4a756c: // Jul
+      return 7;
+    case 0x417567: // Aug
+      return 8;
+    case 0x536570: // Sep
+      return 9;
+    case 0x4f6374: // Oct
+      return 10;
+    case 0x4e6f76: // Nov
+      return 11;
+    case 0x446563: // Dec
+      return 12;
+    default:
+      return 0;
+  }
+}
+
+/*!
+ * \brief Number of days from 1970-01-01 to the given date of the proleptic
+ * Gregorian calendar. Days past the end of the month roll over to the next
+ * one, as in std::mktime().
+ * \note Algorithm by Howard Hinnant: http://howardhinnant.github.io/
+ * date_algorithms.html#days_from_civil
+ */
+int64_t
+SLPDateDecoder::daysFromCivil(int y_, int m_, int d_)
+{
+  y_ -= m_ <= 2;
+  const int64_t era_ = (y_ >= 0 ? y_ : y_ - 399) / 400;
+  const int64_t yoe_ = y_ - era_ * 400;
+  const int64_t doy_ = (153 * (m_ + (m_ > 2 ? -3 : 9)) + 2) / 5 + d_ - 1;
+  const int64_t doe_ = yoe_ * 365 + yoe_ / 4 - yoe_ / 100 + doy_;
+  return era_ * 146097 + doe_ - 719468;
+}
+
+/*!
+ * \internal
+ * \brief Reads n_ decimal digits of s_ starting at pos_.
+ * \return false if one of them is not a digit.
+ */
+bool
+SLPDateDecoder::digits(std::string_view s_, size_t pos_, size_t n_, int& v_)
+{
+  v_ = 0;
+  for (size_t i_ = pos_; i_ < pos_ + n_; ++i_) {
+    const unsigned c_ = static_cast<unsigned char>(s_[i_]) - '0';
+    if (c_ > 9) {
+      return false;
+    }
+    v_ = v_ * 10 + static_cast<int>(c_);
+  }
+  return true;
+}
+
+/* SLPDecompressor --------------------------------------------------------- */
+namespace {
+/*
+ * The sources fill dst_ with up to cap_ bytes of the log and return how many
+ * were written; less than cap_ only at the end of the file or on error.
+ */
+constexpr size_t sourceInSize_ = 1 << 18; // 256KiB of compressed input
+
+class Source
+{
+public:
+  explicit Source(std::ifstream& in_)
+    : in_(in_)
+  {
+  }
+  virtual ~Source() = default;
+  virtual size_t read(char* dst_, size_t cap_) = 0;
+  bool failed() const { return failed_; }
+
+protected:
+  std::ifstream& in_;
+  bool failed_ = false;
+
+  size_t readInput(char* buf_, size_t cap_)
+  {
+    in_.read(buf_, static_cast<std::streamsize>(cap_));
+    if (in_.bad()) {
+      failed_ = true;
+    }
+    return static_cast<size_t>(in_.gcount());
+  }
+};
+
+class PlainSource : public Source
+{
+public:
+  using Source::Source;
+
+  size_t read(char* dst_, size_t cap_) override
+  {
+    return readInput(dst_, cap_);
+  }
+};
+
+#if defined(ZLIB_EXTENSION)
+class GzipSource : public Source
+{
+public:
+  explicit GzipSource(std::ifstream& in_)
+    : Source(in_)
+    , buf_(new unsigned char[sourceInSize_])
+  {
+    // 15 + 32: any window size, gzip or zlib header.
+    failed_ = inflateInit2(&zs_, 15 + 32) != Z_OK;
+    end_ = failed_;
+  }
+  ~GzipSource() override { inflateEnd(&zs_); }
+
+  size_t read(char* dst_, size_t cap_) override
+  {
+    zs_.next_out = reinterpret_cast<Bytef*>(dst_);
+    zs_.avail_out = static_cast<uInt>(cap_);
+    while (zs_.avail_out > 0 && !end_) {
+      if (zs_.avail_in == 0) {
+        const size_t n_ =
+          readInput(reinterpret_cast<char*>(buf_.get()), sourceInSize_);
+        if (n_ == 0) {
+          failed_ = failed_ || !memberEnd_; // truncated
+          end_ = true;
+          break;
+        }
+        zs_.next_in = buf_.get();
+        zs_.avail_in = static_cast<uInt>(n_);
+      }
+      const int r_ = inflate(&zs_, Z_NO_FLUSH);
+      if (r_ == Z_STREAM_END) {
+        // rotated logs may be several gzip members, one after the other.
+        memberEnd_ = true;
+        inflateReset(&zs_);
+      } else if (r_ == Z_OK) {
+        memberEnd_ = false;
+      } else {
+        failed_ = true;
+        end_ = true;
+      }
+    }
+    return cap_ - zs_.avail_out;
+  }
+
+private:
+  z_stream zs_ = {};
+  std::unique_ptr<unsigned char[]> buf_;
+  bool memberEnd_ = false;
+  bool end_ = false;
+};
+#endif
+
+#if defined(LZMA_EXTENSION)
+class XzSource : public Source
+{
+public:
+  explicit XzSource(std::ifstream& in_)
+    : Source(in_)
+    , buf_(new uint8_t[sourceInSize_])
+  {
+    failed_ = lzma_stream_decoder(&xs_, UINT64_MAX, LZMA_CONCATENATED) !=
+              LZMA_OK;
+    end_ = failed_;
+  }
+  ~XzSource() override { lzma_end(&xs_); }
+
+  size_t read(char* dst_, size_t cap_) override
+  {
+    xs_.next_out = reinterpret_cast<uint8_t*>(dst_);
+    xs_.avail_out = cap_;
+    while (xs_.avail_out > 0 && !end_) {
+      if (xs_.avail_in == 0 && !eof_) {
+        xs_.next_in = buf_.get();
+        xs_.avail_in =
+          readInput(reinterpret_cast<char*>(buf_.get()), sourceInSize_);
+        eof_ = xs_.avail_in == 0;
+      }
+      const lzma_ret r_ = lzma_code(&xs_, eof_ ? LZMA_FINISH : LZMA_RUN);
+      if (r_ == LZMA_STREAM_END) {
+        end_ = true;
+      } else if (r_ != LZMA_OK) {
+        failed_ = true;
+        end_ = true;
+      }
+    }
+    return cap_ - xs_.avail_out;
+  }
+
+private:
+  lzma_stream xs_ = LZMA_STREAM_INIT;
+  std::unique_ptr<uint8_t[]> buf_;
+  bool eof_ = false;
+  bool end_ = false;
+};
+#endif
+
+#if defined(ZSTD_EXTENSION)
+class ZstdSource : public Source
+{
+public:
+  explicit ZstdSource(std::ifstream& in_)
+    : Source(in_)
+    , ds_(ZSTD_createDStream())
+    , buf_(new char[sourceInSize_])
+  {
+    failed_ = ds_ == nullptr || ZSTD_isError(ZSTD_initDStream(ds_));
+    end_ = failed_;
+  }
+  ~ZstdSource() override { ZSTD_freeDStream(ds_); }
+
+  size_t read(char* dst_, size_t cap_) override
+  {
+    ZSTD_outBuffer out_ = { dst_, cap_, 0 };
+    while (out_.pos < out_.size && !end_) {
+      if (in_buf_.pos == in_buf_.size) {
+        const size_t n_ = readInput(buf_.get(), sourceInSize_);
+        if (n_ == 0) {
+          failed_ = failed_ || hint_ != 0; // truncated frame
+          end_ = true;
+          break;
+        }
+        in_buf_ = { buf_.get(), n_, 0 };
+      }
+      hint_ = ZSTD_decompressStream(ds_, &out_, &in_buf_);
+      if (ZSTD_isError(hint_)) {
+        failed_ = true;
+        end_ = true;
+      }
+    }
+    return out_.pos;
+  }
+
+private:
+  ZSTD_DStream* ds_;
+  std::unique_ptr<char[]> buf_;
+  ZSTD_inBuffer in_buf_ = { nullptr, 0, 0 };
+  size_t hint_ = 0; // 0 once a frame is complete
+  bool end_ = false;
+};
+#endif
+
+std::unique_ptr<Source>
+makeSource(SLPDecompressor::Codec c_, std::ifstream& in_)
+{
+  switch (c_) {
+    case SLPDecompressor::Codec::None: {
+      return std::make_unique<PlainSource>(in_);
+    }
+#if defined(ZLIB_EXTENSION)
+    case SLPDecompressor::Codec::Gzip: {
+      return std::make_unique<GzipSource>(in_);
+    }
+#endif
+#if defined(LZMA_EXTENSION)
+    case SLPDecompressor::Codec::Xz: {
+      return std::make_unique<XzSource>(in_);
+    }
+#endif
+#if defined(ZSTD_EXTENSION)
+    case SLPDecompressor::Codec::Zstd: {
+      return std::make_unique<ZstdSource>(in_);
+    }
+#endif
+    default: {
+      return nullptr;
+    }
+  }
+}
+} // namespace
+
+/*!
+ * \brief Opens path_ and starts reading it.
+ * \param path_ Log file, plain or compressed.
+ * \param block_size_ Size of each block given by next().
+ * \param blocks_ Number of blocks in the ring, i.e. how far the reading
+ * thread may get ahead of the caller (blocks_ - 1 blocks).
+ */
+SLPDecompressor::SLPDecompressor(const std::string& path_,
+                                 size_t block_size_,
+                                 size_t blocks_)
+  : file_(path_, std::ios::binary)
+  , codec_(Codec::None)
+  , blockSize_(std::max<size_t>(block_size_, 4096))
+  , current_({})
+  , done_(true)
+  , stop_(false)
+  , failed_(true)
+{
+  if (!file_) {
+    return;
+  }
+
+  std::array<unsigned char, 6> magic_ = {};
+  file_.read(reinterpret_cast<char*>(magic_.data()), magic_.size());
+  codec_ = detect(magic_.data(), static_cast<size_t>(file_.gcount()));
+  file_.clear();
+  file_.seekg(0);
+  if (!supported(codec_) || !file_) {
+    return;
+  }
+
+  for (size_t i_ = 0; i_ < std::max<size_t>(blocks_, 2); ++i_) {
+    free_.push_back({ std::unique_ptr<char[]>(new char[blockSize_]), 0 });
+  }
+  done_ = false;
+  failed_ = false;
+  worker_ = std::thread(&SLPDecompressor::run, this);
+}
+
+SLPDecompressor::~SLPDecompressor()
+{
+  {
+    std::lock_guard<std::mutex> lock_(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+/*!
+ * \brief Returns the next block of the file. It stays valid until the next
+ * call. Waits for the reading thread if needed.
+ * \return std::string_view Block, or an empty view at the end of the file.
+ * Lines may be split between two blocks.
+ */
+std::string_view
+SLPDecompressor::next()
+{
+  std::unique_lock<std::mutex> lock_(mutex_);
+  if (current_.data_) {
+    free_.push_back(std::move(current_));
+    current_ = {};
+    cond_.notify_all();
+  }
+  cond_.wait(lock_, [this]() { return !full_.empty() || done_; });
+  if (full_.empty()) {
+    return std::string_view();
+  }
+  current_ = std::move(full_.front());
+  full_.pop_front();
+  return std::string_view(current_.data_.get(), current_.size_);
+}
+
+/*!
+ * \brief True if the file could not be opened, its compression is not
+ * supported, or it is corrupted or truncated. The blocks already given by
+ * next() are still valid data.
+ */
+bool
+SLPDecompressor::failed() const
+{
+  std::lock_guard<std::mutex> lock_(mutex_);
+  return failed_;
+}
+
+/*!
+ * \brief Identifies the compression by the first bytes of a file.
+ * \param p_ First bytes of the file.
+ * \param n_ Number of bytes in p_; 6 are enough.
+ */
+SLPDecompressor::Codec
+SLPDecompressor::detect(const unsigned char* p_, size_t n_)
+{
+  if (n_ >= 2 && p_[0] == 0x1F && p_[1] == 0x8B) {
+    return Codec::Gzip;
+  }
+  if (n_ >= 6 && std::memcmp(p_, "\xFD" "7zXZ\0", 6) == 0) {
+    return Codec::Xz;
+  }
+  if (n_ >= 4 && p_[0] == 0x28 && p_[1] == 0xB5 && p_[2] == 0x2F &&
+      p_[3] == 0xFD) {
+    return Codec::Zstd;
+  }
+  return Codec::None;
+}
+
+/*!
+ * \brief True if the library was built with the decompressor of c_.
+ */
+bool
+SLPDecompressor::supported(Codec c_)
+{
+  switch (c_) {
+    case Codec::None: {
+      return true;
+    }
+    case Codec::Gzip: {
+#if defined(ZLIB_EXTENSION)
+      return true;
+#else
+      return false;
+#endif
+    }
+    case Codec::Xz: {
+#if defined(LZMA_EXTENSION)
+      return true;
+#else
+      return false;
+#endif
+    }
+    case Codec::Zstd: {
+#if defined(ZSTD_EXTENSION)
+      return true;
+#else
+      return false;
+#endif
+    }
+  }
+  return false;
+}
+
+/*!
+ * \internal
+ * \brief Body of the reading thread: fills the free blocks and queues them.
+ */
+void
+SLPDecompressor::run()
+{
+  std::unique_ptr<Source> src_ = makeSource(codec_, file_);
+
+  for (;;) {
+    Block b_;
+    {
+      std::unique_lock<std::mutex> lock_(mutex_);
+      cond_.wait(lock_, [this]() { return !free_.empty() || stop_; });
+      if (stop_) {
+        break;
+      }
+      b_ = std::move(free_.front());
+      free_.pop_front();
+    }
+
+    b_.size_ = src_->read(b_.data_.get(), blockSize_);
+
+    std::lock_guard<std::mutex> lock_(mutex_);
+    const bool end_ = b_.size_ < blockSize_;
+    if (b_.size_ > 0) {
+      full_.push_back(std::move(b_));
+    } else {
+      free_.push_back(std::move(b_));
+    }
+    if (end_) {
+      failed_ = src_->failed();
+      done_ = true;
+    }
+    cond_.notify_all();
+    if (end_) {
       break;
     }
-    case boost::regex_constants::error_ctype: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_CTYPE);
-      break;
+  }
+}
+
+/* SLPThreadPool ----------------------------------------------------------- */
+
+/*!
+ * \brief Starts the workers of the pool.
+ * \param threads_ Number of threads of a job, the one that calls run()
+ * included; 0 uses one per hardware thread.
+ */
+SLPThreadPool::SLPThreadPool(unsigned threads_)
+  : pending_(0)
+  , next_(0)
+  , stop_(false)
+{
+  const size_t workers_n_ = concurrency(threads_) - 1;
+  for (size_t i_ = 0; i_ < workers_n_; ++i_) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i_ = 0; i_ < workers_n_; ++i_) {
+    workers_.emplace_back(&SLPThreadPool::work, this, i_);
+  }
+}
+
+SLPThreadPool::~SLPThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock_(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& t_ : workers_) {
+    t_.join();
+  }
+}
+
+/*!
+ * \brief The pool used by SLPQuery, with one thread per hardware thread.
+ * It is created by the first call.
+ */
+SLPThreadPool&
+SLPThreadPool::shared()
+{
+  static SLPThreadPool pool_;
+  return pool_;
+}
+
+/*!
+ * \brief Number of threads meant by threads_: itself, or one per hardware
+ * thread if it is 0.
+ */
+unsigned
+SLPThreadPool::concurrency(unsigned threads_) noexcept
+{
+  return threads_ != 0 ? threads_
+                       : std::max(1U, std::thread::hardware_concurrency());
+}
+
+/*!
+ * \brief Calls f_(i) for each i in [0, parts_) and returns when every call
+ * is done. The calls are made by the calling thread and by up to
+ * threads_ - 1 workers, as many as the pool has. An exception thrown by f_
+ * is thrown again here, after the other parts.
+ * \param parts_ Number of parts of the job.
+ * \param threads_ Threads of the job; 0 uses all of them, 1 only the caller.
+ * \param f_ Function called for each part.
+ */
+void
+SLPThreadPool::run(size_t parts_,
+                   unsigned threads_,
+                   const std::function<void(size_t)>& f_)
+{
+  if (parts_ == 0) {
+    return;
+  }
+
+  struct Job
+  {
+    std::atomic<size_t> next_{ 0 };
+    std::atomic<size_t> done_{ 0 };
+    std::mutex mutex_;
+    std::condition_variable finished_;
+    std::exception_ptr error_;
+  };
+  // A worker may take its task after the job is over: it then finds no
+  // part left and does not touch f_.
+  auto job_ = std::make_shared<Job>();
+  auto each_ = [job_, parts_, &f_]() {
+    for (size_t i_ = job_->next_++; i_ < parts_; i_ = job_->next_++) {
+      try {
+        f_(i_);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock_(job_->mutex_);
+        if (!job_->error_) {
+          job_->error_ = std::current_exception();
+        }
+      }
+      if (++job_->done_ == parts_) {
+        std::lock_guard<std::mutex> lock_(job_->mutex_);
+        job_->finished_.notify_all();
+      }
+    }
+  };
+
+  const size_t helpers_ =
+    std::min<size_t>({ parts_, concurrency(threads_), size() }) - 1;
+  for (size_t i_ = 0; i_ < helpers_; ++i_) {
+    push(each_);
+  }
+  each_();
+
+  std::unique_lock<std::mutex> lock_(job_->mutex_);
+  job_->finished_.wait(lock_, [&job_, parts_]() {
+    return job_->done_ == parts_;
+  });
+  if (job_->error_) {
+    std::rethrow_exception(job_->error_);
+  }
+}
+
+/*!
+ * \internal
+ * \brief Queues task_ on the workers in turn and wakes one of them.
+ */
+void
+SLPThreadPool::push(Task&& task_)
+{
+  {
+    std::lock_guard<std::mutex> lock_(mutex_);
+    Queue& q_ = *queues_[next_];
+    next_ = (next_ + 1) % queues_.size();
+    {
+      std::lock_guard<std::mutex> qlock_(q_.mutex_);
+      q_.tasks_.push_back(std::move(task_));
+    }
+    ++pending_;
+  }
+  wake_.notify_one();
+}
+
+/*!
+ * \internal
+ * \brief Takes the last task of the queue of self_ or, if it is empty, the
+ * first one of another queue.
+ */
+bool
+SLPThreadPool::pop(size_t self_, Task& task_)
+{
+  for (size_t k_ = 0; k_ < queues_.size(); ++k_) {
+    Queue& q_ = *queues_[(self_ + k_) % queues_.size()];
+    {
+      std::lock_guard<std::mutex> qlock_(q_.mutex_);
+      if (q_.tasks_.empty()) {
+        continue;
+      }
+      if (k_ == 0) {
+        task_ = std::move(q_.tasks_.back());
+        q_.tasks_.pop_back();
+      } else {
+        task_ = std::move(q_.tasks_.front());
+        q_.tasks_.pop_front();
+      }
+    }
+    std::lock_guard<std::mutex> lock_(mutex_);
+    --pending_;
+    return true;
+  }
+  return false;
+}
+
+/*!
+ * \internal
+ * \brief Body of the worker self_: runs tasks, and sleeps while none is
+ * queued.
+ */
+void
+SLPThreadPool::work(size_t self_)
+{
+  for (;;) {
+    Task task_;
+    if (pop(self_, task_)) {
+      task_();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock_(mutex_);
+    wake_.wait(lock_, [this]() { return stop_ || pending_ > 0; });
+    if (stop_ && pending_ == 0) {
+      return;
+    }
+  }
+}
+
+/* SLPLogFormat -------------------------------------------------------------
+ */
+namespace {
+/*
+ * Format codes of squid.conf 'logformat' that are recognized by name. They
+ * are matched by the longest prefix, so that e.g. ">ha" is not read as ">h"
+ * followed by the text "a". The ones with a counterpart in DataSet_Squid are
+ * mapped in SLPLogFormat::compile().
+ */
+constexpr std::string_view lfCodes_[] = {
+  ">a",  ">A",  ">p",  ">eui", ">la", ">lp", ">qos", ">nfmark",
+  "<a",  "<A",  "<p",  "<la",  "<lp", "<qos", "<nfmark", "la",
+  "lp",  "ts",  "tu",  "tl",   "tg",  "tr",   "dt",  "tS",
+  "tt",  "<tt", "<pt", "un",   "ul",  "ui",   "ue",  "us",
+  "Hs",  ">Hs", "<Hs", "Ss",   "Sh",  "mt",   "rm",  "ru",
+  "rp",  "rv",  ">rm", ">ru",  ">rp", ">rv",  ">rs", ">rd",
+  "<rm", "<ru", "<rp", "<rv",  "<rs", "<rd",  "rs",  "rd",
+  "st",  ">st", "<st", "sh",   ">sh", "<sh",  "<bs", ">h",
+  ">ha", "<h",  "ea",  "et",   "sn",  "note", "err_code", "err_detail",
+  "master_xaction"
+};
+
+bool
+lfIsSpace(const char c_)
+{
+  return c_ == ' ' || (c_ >= '\t' && c_ <= '\r');
+}
+} // namespace
+
+/*!
+ * \brief Compiles a logformat.
+ * \param fmt_ Either the format alone, e.g. "%>a [%tl] \"%{User-Agent}>h\"",
+ * or a whole squid.conf directive: "logformat <name> <format>".
+ * \note Check isValid() before use.
+ */
+SLPLogFormat::SLPLogFormat(const std::string& fmt_)
+  : name_({})
+  , steps_({})
+  , columns_({})
+  , fields_(0)
+  , valid_(false)
+{
+  std::string_view f_ = fmt_;
+  auto skipSpaces_ = [&f_]() {
+    while (!f_.empty() && lfIsSpace(f_.front())) {
+      f_.remove_prefix(1);
+    }
+  };
+  skipSpaces_();
+  if (constexpr std::string_view kw_ = "logformat";
+      f_.substr(0, kw_.size()) == kw_ && f_.size() > kw_.size() &&
+      lfIsSpace(f_[kw_.size()])) {
+    f_.remove_prefix(kw_.size());
+    skipSpaces_();
+    size_t n_ = 0;
+    while (n_ < f_.size() && !lfIsSpace(f_[n_])) {
+      ++n_;
+    }
+    name_ = std::string(f_.substr(0, n_));
+    f_.remove_prefix(n_);
+    skipSpaces_();
+  }
+  while (!f_.empty() && lfIsSpace(f_.back())) {
+    f_.remove_suffix(1);
+  }
+  valid_ = compile(f_);
+}
+
+/*!
+ * \brief Returns false if the format could not be compiled, e.g. because of
+ * a '%' without a code, an unterminated "{...}" or two fields without
+ * anything between them.
+ */
+bool
+SLPLogFormat::isValid() const
+{
+  return valid_;
+}
+
+/*!
+ * \brief Returns the name given in the logformat directive, if any.
+ */
+const std::string&
+SLPLogFormat::name() const
+{
+  return name_;
+}
+
+/*!
+ * \brief Returns the codes stored as generic string columns, e.g. ">ha" or
+ * "{X-Forwarded-For}>h", in the order of DataSet_Squid::customFields.
+ */
+const std::vector<std::string>&
+SLPLogFormat::columns() const
+{
+  return columns_;
+}
+
+/*!
+ * \brief Returns the column of a generic format code, or -1 if the format
+ * does not have it.
+ * \param code_ Format code without '%' and modifiers, e.g. "<tt".
+ */
+int
+SLPLogFormat::column(std::string_view code_) const
+{
+  for (size_t i_ = 0; i_ < columns_.size(); ++i_) {
+    if (columns_[i_] == code_) {
+      return static_cast<int>(i_);
+    }
+  }
+  return -1;
+}
+
+/*!
+ * \brief Returns true if the format fills the field f_ of DataSet_Squid.
+ */
+bool
+SLPLogFormat::hasField(SquidLogData::Fields f_) const
+{
+  return (fields_ & (1U << static_cast<unsigned>(f_))) != 0;
+}
+
+/*!
+ * \brief Runs the parse program over a line.
+ * \param line_ Log line.
+ * \param ds_ Receives the fields. Only the fields present in the format are
+ * written.
+ * \param dict_ Encodes the IPv6 client addresses, see SLPAddrDict.
+ * \return false if the line does not match the format.
+ */
+bool
+SLPLogFormat::parse(std::string_view line_,
+                    SquidLogData::DataSet_Squid& ds_,
+                    SLPAddrDict* dict_) const
+{
+  const char* p_ = line_.data();
+  const char* end_ = p_ + line_.size();
+  while (p_ != end_ && lfIsSpace(*p_)) {
+    ++p_;
+  }
+  while (end_ != p_ && lfIsSpace(*(end_ - 1))) {
+    --end_;
+  }
+
+  ds_.customFields.resize(columns_.size());
+
+  // %Ss and %Sh take the text up to the next white space.
+  const char* group_ = nullptr;
+  SquidLogData::Fields groupField_ = SquidLogData::Fields::Unknown;
+  auto closeGroup_ = [&](const char* at_) {
+    if (group_ != nullptr) {
+      Step s_;
+      s_.field_ = groupField_;
+      store(s_, std::string_view(group_, at_ - group_), ds_, dict_);
+      group_ = nullptr;
+    }
+  };
+
+  for (const Step& s_ : steps_) {
+    switch (s_.op_) {
+      case OpCode::Blank: {
+        if (p_ == end_ || !lfIsSpace(*p_)) {
+          return false;
+        }
+        closeGroup_(p_);
+        while (p_ != end_ && lfIsSpace(*p_)) {
+          ++p_;
+        }
+        break;
+      }
+      case OpCode::Literal: {
+        if (static_cast<size_t>(end_ - p_) < s_.literal_.size() ||
+            s_.literal_.compare(0, s_.literal_.size(), p_,
+                                s_.literal_.size()) != 0) {
+          return false;
+        }
+        p_ += s_.literal_.size();
+        break;
+      }
+      case OpCode::Field: {
+        const char* begin_ = p_;
+        switch (s_.stop_) {
+          case Stop::Blank: {
+            while (p_ != end_ && !lfIsSpace(*p_)) {
+              ++p_;
+            }
+            break;
+          }
+          case Stop::Char: {
+            p_ = std::find(p_, end_, s_.stopChar_);
+            break;
+          }
+          case Stop::Quote: {
+            while (p_ != end_ && *p_ != '"') {
+              if (*p_ == '\\' && p_ + 1 != end_) {
+                ++p_;
+              }
+              ++p_;
+            }
+            break;
+          }
+          case Stop::End: {
+            p_ = end_;
+            break;
+          }
+        }
+        if (s_.kind_ == Kind::Group) {
+          group_ = begin_;
+          groupField_ = s_.field_;
+        } else if (!store(
+                     s_, std::string_view(begin_, p_ - begin_), ds_, dict_)) {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+  closeGroup_(p_);
+  return p_ == end_;
+}
+
+/* private------------------------------------------------------------------
+ */
+/*!
+ * \internal
+ * \brief Translates the format into steps_.
+ *
+ * Format codes follow the squid.conf syntax:
+ * % ["|[|'|#|/] [-] [[0]width] [{arg}] formatcode [{arg}]
+ */
+bool
+SLPLogFormat::compile(std::string_view fmt_)
+{
+  using F = SquidLogData::Fields;
+
+  std::string lit_ = {};
+  bool group_ = false; // inside a %Ss or %Sh group
+  size_t i_ = 0;
+  while (i_ < fmt_.size()) {
+    if (fmt_[i_] != '%') {
+      if (lfIsSpace(fmt_[i_])) {
+        group_ = false;
+      }
+      lit_ += fmt_[i_++];
+      continue;
+    }
+    if (++i_ == fmt_.size()) {
+      return false;
+    }
+    if (fmt_[i_] == '%') {
+      lit_ += fmt_[i_++];
+      continue;
+    }
+
+    bool quoted_ = false;
+    constexpr std::string_view modifiers_ = "\"['#/-";
+    while (i_ < fmt_.size() &&
+           modifiers_.find(fmt_[i_]) != std::string_view::npos) {
+      quoted_ = quoted_ || fmt_[i_] == '"' || fmt_[i_] == '/';
+      ++i_;
+    }
+    // the width is irrelevant, the blanks around the values are skipped.
+    while (i_ < fmt_.size() &&
+           (fmt_[i_] == '.' || (fmt_[i_] >= '0' && fmt_[i_] <= '9'))) {
+      ++i_;
+    }
+
+    std::string_view arg_ = {};
+    auto readArg_ = [&fmt_, &i_, &arg_]() {
+      if (i_ < fmt_.size() && fmt_[i_] == '{') {
+        const size_t close_ = fmt_.find('}', i_);
+        if (close_ == std::string_view::npos) {
+          return false;
+        }
+        arg_ = fmt_.substr(i_ + 1, close_ - i_ - 1);
+        i_ = close_ + 1;
+      }
+      return true;
+    };
+    if (!readArg_()) {
+      return false;
+    }
+    const size_t len_ = codeLength(fmt_.substr(i_));
+    if (len_ == 0) {
+      return false;
+    }
+    const std::string_view code_ = fmt_.substr(i_, len_);
+    i_ += len_;
+    if (arg_.empty() && !readArg_()) {
+      return false;
+    }
+
+    Step step_;
+    step_.op_ = OpCode::Field;
+    if (code_ == "ts") {
+      step_ = { OpCode::Field, Stop::End, Kind::UInt, 0, F::Timestamp };
+    } else if (code_ == "tu") {
+      step_.kind_ = Kind::Skip;
+    } else if (code_ == "tl" || code_ == "tg") {
+      step_.field_ = F::LocalTime;
+    } else if (code_ == "tr") {
+      step_ = { OpCode::Field, Stop::End, Kind::Int, 0, F::ResponseTime };
+    } else if (code_ == ">a") {
+      step_ = { OpCode::Field, Stop::End, Kind::IPv4, 0, F::CliSrcIpAddr };
+    } else if (code_ == "un") {
+      step_.field_ = F::UserName;
+    } else if (code_ == "ui") {
+      step_.field_ = F::UserNameIdent;
+    } else if (code_ == "rm") {
+      step_.field_ = F::ReqMethod;
+    } else if (code_ == "ru") {
+      step_.field_ = F::ReqURL;
+    } else if (code_ == "rv") {
+      step_.field_ = F::ReqProtoVersion;
+    } else if (code_ == ">Hs") {
+      step_ = { OpCode::Field, Stop::End, Kind::Int, 0, F::HttpStatus };
+    } else if (code_ == "<st") {
+      step_ = { OpCode::Field, Stop::End, Kind::Int, 0, F::TotalSizeReply };
+    } else if (code_ == "mt") {
+      step_.field_ = F::MimeContentType;
+    } else if (code_ == "Ss" || code_ == "Sh") {
+      step_.kind_ = group_ ? Kind::Skip : Kind::Group;
+      step_.field_ = code_ == "Ss" ? F::ReqStatusHierStatus
+                                   : F::HierStatusIpAddress;
+      group_ = true;
+    } else if (code_ == ">h" && arg_ == "Referer") {
+      step_.field_ = F::Referrer;
+    } else if (code_ == ">h" && arg_ == "User-Agent") {
+      step_.field_ = F::UserAgent;
+    } else if (code_ == ">h" && arg_.empty()) {
+      step_.field_ = F::OrigRcvReqHeader;
+    } else {
+      std::string name_ =
+        arg_.empty() ? std::string() : "{" + std::string(arg_) + "}";
+      name_ += code_;
+      step_.column_ = columns_.size();
+      columns_.push_back(std::move(name_));
+    }
+    if (step_.kind_ == Kind::Skip) {
+      step_.field_ = F::Unknown;
+    } else if (step_.field_ != F::Unknown) {
+      fields_ |= 1U << static_cast<unsigned>(step_.field_);
+    }
+
+    if (quoted_) {
+      lit_ += '"';
+    }
+    addLiteral(lit_);
+    lit_ = quoted_ ? "\"" : "";
+    if (!steps_.empty() && steps_.back().op_ == OpCode::Field) {
+      return false; // two adjacent fields cannot be told apart
+    }
+    steps_.push_back(std::move(step_));
+  }
+  addLiteral(lit_);
+
+  // Each field ends where the text that follows it begins.
+  for (size_t k_ = 0; k_ < steps_.size(); ++k_) {
+    Step& s_ = steps_[k_];
+    if (s_.op_ != OpCode::Field) {
+      continue;
+    }
+    if (k_ + 1 == steps_.size()) {
+      s_.stop_ = Stop::End;
+    } else if (steps_[k_ + 1].op_ == OpCode::Blank) {
+      s_.stop_ = Stop::Blank;
+    } else if (const std::string& next_ = steps_[k_ + 1].literal_;
+               next_.front() == '"' && k_ > 0 &&
+               steps_[k_ - 1].op_ == OpCode::Literal &&
+               steps_[k_ - 1].literal_.back() == '"') {
+      s_.stop_ = Stop::Quote;
+    } else {
+      s_.stop_ = Stop::Char;
+      s_.stopChar_ = next_.front();
+    }
+  }
+  return !steps_.empty();
+}
+
+/*!
+ * \internal
+ * \brief Appends the steps that match lit_: Blank for each run of white
+ * spaces and Literal for the text between them.
+ */
+void
+SLPLogFormat::addLiteral(std::string_view lit_)
+{
+  while (!lit_.empty()) {
+    size_t n_ = 0;
+    if (lfIsSpace(lit_.front())) {
+      while (n_ < lit_.size() && lfIsSpace(lit_[n_])) {
+        ++n_;
+      }
+      Step s_;
+      s_.op_ = OpCode::Blank;
+      steps_.push_back(std::move(s_));
+    } else {
+      while (n_ < lit_.size() && !lfIsSpace(lit_[n_])) {
+        ++n_;
+      }
+      Step s_;
+      s_.literal_ = std::string(lit_.substr(0, n_));
+      steps_.push_back(std::move(s_));
+    }
+    lit_.remove_prefix(n_);
+  }
+}
+
+/*!
+ * \internal
+ * \brief Returns the length of the format code at the beginning of s_, or 0.
+ */
+size_t
+SLPLogFormat::codeLength(std::string_view s_)
+{
+  auto isCodeChar_ = [](const char c_) {
+    return ::isalnum(static_cast<unsigned char>(c_)) || c_ == '_' ||
+           c_ == ':' || c_ == '<' || c_ == '>';
+  };
+
+  // Namespaced codes, e.g. ssl::>sni, are taken as a whole.
+  size_t ns_ = 0;
+  while (ns_ < s_.size() &&
+         (::isalpha(static_cast<unsigned char>(s_[ns_])) || s_[ns_] == '_')) {
+    ++ns_;
+  }
+  if (ns_ > 0 && s_.substr(ns_, 2) == "::") {
+    size_t n_ = ns_ + 2;
+    while (n_ < s_.size() && isCodeChar_(s_[n_])) {
+      ++n_;
+    }
+    return n_;
+  }
+
+  size_t best_ = 0;
+  for (const std::string_view& c_ : lfCodes_) {
+    if (c_.size() > best_ && s_.substr(0, c_.size()) == c_) {
+      best_ = c_.size();
+    }
+  }
+  if (best_ == 0) { // unknown code: becomes a generic column
+    while (best_ < s_.size() && isCodeChar_(s_[best_])) {
+      ++best_;
+    }
+  }
+  return best_;
+}
+
+/*!
+ * \internal
+ * \brief Stores a field value in ds_. Squid writes '-' for the values it
+ * does not have, which are stored as zero in the numeric fields.
+ * \return false if a numeric field is not a number.
+ */
+bool
+SLPLogFormat::store(const Step& step_,
+                    std::string_view value_,
+                    SquidLogData::DataSet_Squid& ds_,
+                    SLPAddrDict* dict_)
+{
+  using F = SquidLogData::Fields;
+
+  switch (step_.kind_) {
+    case Kind::Skip: {
+      return true;
+    }
+    case Kind::IPv4: {
+      uint32_t ip_ = 0;
+      if (dict_ != nullptr) {
+        ds_.cliSrcIpAddr = dict_->encode(value_);
+      } else {
+        ds_.cliSrcIpAddr = SLPTokenizer::toIPv4(value_, ip_) ? ip_ : 0;
+      }
+      return true;
+    }
+    case Kind::Int: {
+      int n_ = 0;
+      if (value_ != "-" && !SLPTokenizer::toNumber(value_, n_)) {
+        return false;
+      }
+      if (step_.field_ == F::ResponseTime) {
+        ds_.responseTime = n_;
+      } else if (step_.field_ == F::HttpStatus) {
+        ds_.httpStatus = n_;
+      } else {
+        ds_.totalSizeReply = n_;
+      }
+      return true;
+    }
+    case Kind::UInt: {
+      uint32_t n_ = 0;
+      if (value_ != "-" && !SLPTokenizer::toNumber(value_, n_)) {
+        return false;
+      }
+      ds_.timeStamp = n_;
+      return true;
+    }
+    default: {
+      break;
+    }
+  }
+
+  switch (step_.field_) {
+    case F::LocalTime: {
+      ds_.localTime.assign(value_);
+      break;
+    }
+    case F::UserName: {
+      ds_.userName.assign(value_);
+      break;
+    }
+    case F::UserNameIdent: {
+      ds_.userNameIdent.assign(value_);
+      break;
+    }
+    case F::ReqMethod: {
+      ds_.reqMethod.assign(value_);
+      break;
+    }
+    case F::ReqURL: {
+      ds_.reqURL.assign(value_);
+      break;
+    }
+    case F::ReqProtoVersion: {
+      ds_.reqProtoVersion.assign(value_);
+      break;
+    }
+    case F::ReqStatusHierStatus: {
+      ds_.reqStatusHierStatus.assign(value_);
+      break;
+    }
+    case F::HierStatusIpAddress: {
+      ds_.hierStatusIpAddress.assign(value_);
+      break;
+    }
+    case F::MimeContentType: {
+      ds_.mimeTypeContent.assign(value_);
+      break;
+    }
+    case F::OrigRcvReqHeader: {
+      ds_.origRcvReqHeader.assign(value_);
+      break;
+    }
+    case F::Referrer: {
+      ds_.referrer.assign(value_);
+      break;
+    }
+    case F::UserAgent: {
+      ds_.userAgent.assign(value_);
+      break;
+    }
+    default: {
+      ds_.customFields[step_.column_].assign(value_);
+      break;
+    }
+  }
+  return true;
+}
+
+/* SLPSnapshot ------------------------------------------------------------- */
+/*!
+ * \brief Unmaps the file given to open(), if any.
+ */
+SLPSnapshot::~SLPSnapshot()
+{
+  close();
+}
+
+/*!
+ * \brief Adds a list of strings as two sections: the end offset of each
+ * string and the text of all of them.
+ */
+void
+SLPSnapshot::addStrings(const std::vector<std::string_view>& s_)
+{
+  std::vector<uint64_t> ends_;
+  std::vector<char> text_;
+  ends_.reserve(s_.size());
+  for (const std::string_view v_ : s_) {
+    text_.insert(text_.end(), v_.begin(), v_.end());
+    ends_.push_back(text_.size());
+  }
+  add(std::move(ends_));
+  add(std::move(text_));
+}
+
+/*!
+ * \brief Writes the sections added so far. The file is written under a
+ * temporary name and renamed to path_ once complete, so that a failure does
+ * not leave a partial snapshot behind.
+ * \param path_ Snapshot file.
+ * \param log_format_ SquidLogData::LogFormat of the entries.
+ * \param rows_ Number of entries, kept in the header.
+ * \return SLP_SUCCESS or SLP_ERR_SNAPSHOT_NOT_SAVED.
+ */
+SquidLogData::SLPError
+SLPSnapshot::write(const std::string& path_,
+                   uint32_t log_format_,
+                   uint64_t rows_) const
+{
+  auto align_ = [](uint64_t n_) {
+    return (n_ + sectionAlign - 1) / sectionAlign * sectionAlign;
+  };
+
+  Header h_ = {};
+  h_.magic_ = magic;
+  h_.version_ = version;
+  h_.byteOrder_ = byteOrder;
+  h_.logFormat_ = log_format_;
+  h_.sections_ = static_cast<uint32_t>(parts_.size());
+  h_.rows_ = rows_;
+
+  std::vector<Section> table_(parts_.size());
+  uint64_t at_ = align_(sizeof(Header) + table_.size() * sizeof(Section));
+  for (size_t i_ = 0; i_ < parts_.size(); ++i_) {
+    table_[i_] = { at_, parts_[i_].count_, parts_[i_].size_, 0 };
+    at_ = align_(at_ + parts_[i_].count_ * parts_[i_].size_);
+  }
+  h_.bytes_ = at_;
+  h_.checksum_ =
+    checksum(table_.data(), table_.size() * sizeof(Section), version);
+  for (const Part& p_ : parts_) {
+    h_.checksum_ = checksum(p_.data_, p_.count_ * p_.size_, h_.checksum_);
+  }
+
+  const std::string tmp_ = path_ + ".tmp";
+  std::ofstream out_(tmp_, std::ios::binary | std::ios::trunc);
+  static constexpr std::array<char, sectionAlign> zeros_ = {};
+  uint64_t pos_ = 0;
+  auto put_ = [&out_, &pos_](const void* data_, uint64_t size_) {
+    out_.write(static_cast<const char*>(data_),
+               static_cast<std::streamsize>(size_));
+    pos_ += size_;
+  };
+  auto pad_ = [&put_, &pos_](uint64_t to_) {
+    while (pos_ < to_) {
+      put_(zeros_.data(), std::min<uint64_t>(to_ - pos_, zeros_.size()));
+    }
+  };
+  put_(&h_, sizeof(Header));
+  put_(table_.data(), table_.size() * sizeof(Section));
+  for (size_t i_ = 0; out_ && i_ < parts_.size(); ++i_) {
+    pad_(table_[i_].offset_);
+    put_(parts_[i_].data_, parts_[i_].count_ * parts_[i_].size_);
+  }
+  pad_(h_.bytes_);
+  out_.close();
+
+  std::error_code ec_;
+  if (!out_ || (fsys::rename(tmp_, path_, ec_), ec_)) {
+    fsys::remove(tmp_, ec_);
+    return SquidLogData::SLPError::SLP_ERR_SNAPSHOT_NOT_SAVED;
+  }
+  return SquidLogData::SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \brief Maps a snapshot file in memory and checks it: magic number, version,
+ * byte order, size, bounds of the sections and checksum. The sections are
+ * then available through view() and read() until close().
+ * \return SLP_SUCCESS, SLP_ERR_SNAPSHOT_NOT_READ or SLP_ERR_SNAPSHOT_INVALID.
+ */
+SquidLogData::SLPError
+SLPSnapshot::open(const std::string& path_)
+{
+  close();
+  const int fd_ = ::open(path_.c_str(), O_RDONLY);
+  struct stat st_;
+  if (fd_ < 0 || fstat(fd_, &st_) != 0) {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    return SquidLogData::SLPError::SLP_ERR_SNAPSHOT_NOT_READ;
+  }
+  const size_t size_ = static_cast<size_t>(st_.st_size);
+  if (size_ < sizeof(Header)) {
+    ::close(fd_);
+    return SquidLogData::SLPError::SLP_ERR_SNAPSHOT_INVALID;
+  }
+  void* addr_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  ::close(fd_);
+  if (addr_ == MAP_FAILED) {
+    return SquidLogData::SLPError::SLP_ERR_SNAPSHOT_NOT_READ;
+  }
+  madvise(addr_, size_, MADV_WILLNEED);
+  map_ = static_cast<const char*>(addr_);
+  mapSize_ = size_;
+  header_ = reinterpret_cast<const Header*>(map_);
+  table_ = reinterpret_cast<const Section*>(map_ + sizeof(Header));
+
+  const Header& h_ = *header_;
+  const uint64_t first_ = sizeof(Header) + h_.sections_ * sizeof(Section);
+  bool ok_ = h_.magic_ == magic && h_.version_ == version &&
+             h_.byteOrder_ == byteOrder && h_.bytes_ == size_ &&
+             first_ <= size_;
+  for (size_t i_ = 0; ok_ && i_ < h_.sections_; ++i_) {
+    const Section& t_ = table_[i_];
+    ok_ = t_.offset_ % sectionAlign == 0 && t_.offset_ >= first_ &&
+          t_.offset_ <= size_ && t_.size_ != 0 &&
+          t_.count_ <= (size_ - t_.offset_) / t_.size_;
+  }
+  if (ok_) {
+    uint64_t sum_ = checksum(table_, h_.sections_ * sizeof(Section), version);
+    for (size_t i_ = 0; i_ < h_.sections_; ++i_) {
+      sum_ = checksum(
+        map_ + table_[i_].offset_, table_[i_].count_ * table_[i_].size_, sum_);
+    }
+    ok_ = sum_ == h_.checksum_;
+  }
+  if (!ok_) {
+    close();
+    return SquidLogData::SLPError::SLP_ERR_SNAPSHOT_INVALID;
+  }
+  return SquidLogData::SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \brief Unmaps the file. The pointers given by view() become invalid.
+ */
+void
+SLPSnapshot::close()
+{
+  if (map_ != nullptr) {
+    munmap(const_cast<char*>(map_), mapSize_);
+  }
+  map_ = nullptr;
+  mapSize_ = 0;
+  header_ = nullptr;
+  table_ = nullptr;
+  next_ = 0;
+}
+
+/*!
+ * \brief Copies the next section, made of chars, to s_.
+ */
+bool
+SLPSnapshot::read(std::string& s_)
+{
+  size_t n_ = 0;
+  const char* p_ = view<char>(next_, n_);
+  if (p_ == nullptr) {
+    return false;
+  }
+  ++next_;
+  s_.assign(p_, n_);
+  return true;
+}
+
+/*!
+ * \brief Reads the two sections written by addStrings(). The strings are
+ * views into the map.
+ * \return false if the sections are missing or inconsistent.
+ */
+bool
+SLPSnapshot::readStrings(std::vector<std::string_view>& s_)
+{
+  size_t n_ = 0;
+  size_t size_ = 0;
+  const uint64_t* ends_ = view<uint64_t>(next_, n_);
+  const char* text_ = view<char>(next_ + 1, size_);
+  if (ends_ == nullptr || text_ == nullptr ||
+      !std::is_sorted(ends_, ends_ + n_) ||
+      (n_ > 0 ? ends_[n_ - 1] : 0) != size_) {
+    return false;
+  }
+  next_ += 2;
+  s_.clear();
+  s_.reserve(n_);
+  for (size_t i_ = 0; i_ < n_; ++i_) {
+    const uint64_t begin_ = i_ > 0 ? ends_[i_ - 1] : 0;
+    s_.emplace_back(text_ + begin_, ends_[i_] - begin_);
+  }
+  return true;
+}
+
+/*!
+ * \brief Checksum of the sections: four interleaved multiply-xorshift lanes
+ * over 64-bit words, so that it runs at memory speed. Detects damaged or
+ * truncated files; it is not a cryptographic hash.
+ * \param seed_ Checksum of the data before this one, to chain sections.
+ */
+uint64_t
+SLPSnapshot::checksum(const void* data_, size_t size_, uint64_t seed_)
+{
+  constexpr uint64_t k_ = 0x9E3779B97F4A7C15ULL;
+  const char* p_ = static_cast<const char*>(data_);
+  std::array<uint64_t, 4> h_ = { seed_, seed_ ^ k_, seed_ + k_, ~seed_ };
+  size_t i_ = 0;
+  for (; i_ + 32 <= size_; i_ += 32) {
+    for (size_t l_ = 0; l_ < h_.size(); ++l_) {
+      uint64_t w_;
+      std::memcpy(&w_, p_ + i_ + l_ * 8, sizeof(w_));
+      h_[l_] = (h_[l_] ^ w_) * k_;
+      h_[l_] ^= h_[l_] >> 32;
+    }
+  }
+  uint64_t r_ = size_;
+  for (const uint64_t l_ : h_) {
+    r_ = (r_ ^ l_) * k_;
+    r_ ^= r_ >> 29;
+  }
+  for (; i_ < size_; ++i_) {
+    r_ = (r_ ^ static_cast<unsigned char>(p_[i_])) * k_;
+  }
+  return r_ ^ (r_ >> 32);
+}
+
+/* SLPColumnStore ---------------------------------------------------------- */
+/*!
+ * \brief Appends a row. The text is copied to the blobs.
+ */
+void
+SLPColumnStore::append(const Row& r_)
+{
+  if (!timeStamp_.empty() && r_.timeStamp < timeStamp_.back()) {
+    sorted_ = false;
+  }
+  timeStamp_.push_back(r_.timeStamp);
+  cliSrcIpAddr_.push_back(r_.cliSrcIpAddr);
+  responseTime_.push_back(r_.responseTime);
+  httpStatus_.push_back(r_.httpStatus);
+  totalSizeReply_.push_back(r_.totalSizeReply);
+  for (size_t c_ = 0; c_ < textColumns; ++c_) {
+    TextColumn& col_ = text_[c_];
+    if (dictColumns_[c_]) {
+      col_.codes_.push_back(col_.dict_.encode(r_.*textMembers_[c_]));
+    } else {
+      col_.blob_.append(r_.*textMembers_[c_]);
+      col_.end_.push_back(col_.blob_.size());
+    }
+  }
+  addHost(internHost(r_.reqURL));
+  zoneRow(size() - 1);
+  dropAddrIndex();
+}
+
+/*!
+ * \brief Appends every row of from_, in its order.
+ */
+void
+SLPColumnStore::extend(const SLPColumnStore& from_)
+{
+  if (from_.size() == 0) {
+    return;
+  }
+  sorted_ = sorted_ && from_.sorted_ &&
+            (timeStamp_.empty() ||
+             from_.timeStamp_.front() >= timeStamp_.back());
+  const size_t base_ = size();
+
+  auto cat_ = [](auto& dst_, const auto& src_) {
+    dst_.insert(dst_.end(), src_.begin(), src_.end());
+  };
+  cat_(timeStamp_, from_.timeStamp_);
+  cat_(cliSrcIpAddr_, from_.cliSrcIpAddr_);
+  cat_(responseTime_, from_.responseTime_);
+  cat_(httpStatus_, from_.httpStatus_);
+  cat_(totalSizeReply_, from_.totalSizeReply_);
+  for (size_t c_ = 0; c_ < textColumns; ++c_) {
+    TextColumn& col_ = text_[c_];
+    const TextColumn& src_ = from_.text_[c_];
+    if (dictColumns_[c_]) {
+      const std::vector<uint32_t> map_ = col_.dict_.merge(src_.dict_);
+      for (const uint32_t code_ : src_.codes_) {
+        col_.codes_.push_back(map_[code_]);
+      }
+    } else {
+      const uint64_t offset_ = col_.blob_.size();
+      col_.blob_.append(src_.blob_);
+      for (const uint64_t e_ : src_.end_) {
+        col_.end_.push_back(offset_ + e_);
+      }
+    }
+  }
+
+  // The hosts and domains of from_ take the codes of this store.
+  const std::vector<uint32_t> hosts_map_ = hosts_.merge(from_.hosts_);
+  const std::vector<uint32_t> domains_map_ = domains_.merge(from_.domains_);
+  hostDomain_.resize(hosts_.size());
+  hostRows_.resize(hosts_.size());
+  domainRows_.resize(domains_.size());
+  for (uint32_t c_ = 0; c_ < hosts_map_.size(); ++c_) {
+    hostDomain_[hosts_map_[c_]] = domains_map_[from_.hostDomain_[c_]];
+  }
+  for (const uint32_t code_ : from_.hostCodes_) {
+    addHost(hosts_map_[code_]);
+  }
+  buildZones(base_);
+  dropAddrIndex();
+}
+
+/*!
+ * \brief Removes the first rows_ rows, rounded down to whole segments unless
+ * it is every row. The zone maps of the other segments stay as they are.
+ *
+ * Each vector keeps the room of the rows removed, up to as much again as it
+ * keeps, so that a stream under a budget appends without allocating while a
+ * large load trimmed at once gives its memory back.
+ */
+void
+SLPColumnStore::evictFront(size_t rows_)
+{
+  if (rows_ >= size()) {
+    clear();
+    return;
+  }
+  rows_ -= rows_ % segmentRows;
+  if (rows_ == 0) {
+    return;
+  }
+
+  auto cut_ = [](auto& v_, size_t n_) {
+    std::remove_reference_t<decltype(v_)> keep_;
+    keep_.reserve(std::min(v_.size(), 2 * (v_.size() - n_)));
+    keep_.insert(keep_.end(), v_.begin() + n_, v_.end());
+    v_.swap(keep_);
+  };
+  cut_(timeStamp_, rows_);
+  cut_(cliSrcIpAddr_, rows_);
+  cut_(responseTime_, rows_);
+  cut_(httpStatus_, rows_);
+  cut_(totalSizeReply_, rows_);
+  for (size_t c_ = 0; c_ < textColumns; ++c_) {
+    TextColumn& col_ = text_[c_];
+    if (dictColumns_[c_]) {
+      cut_(col_.codes_, rows_);
+      continue;
+    }
+    const uint64_t offset_ = col_.end_[rows_ - 1];
+    cut_(col_.end_, rows_);
+    for (uint64_t& e_ : col_.end_) {
+      e_ -= offset_;
+    }
+    cut_(col_.blob_, offset_);
+  }
+  zones_.erase(zones_.begin(), zones_.begin() + rows_ / segmentRows);
+
+  cut_(hostCodes_, rows_);
+  auto renumber_ = [rows_](std::vector<uint32_t>& post_) {
+    post_.erase(post_.begin(),
+                std::lower_bound(post_.begin(), post_.end(), rows_));
+    for (uint32_t& r_ : post_) {
+      r_ -= static_cast<uint32_t>(rows_);
+    }
+    if (post_.capacity() > 2 * post_.size()) {
+      post_.shrink_to_fit();
+    }
+  };
+  std::for_each(hostRows_.begin(), hostRows_.end(), renumber_);
+  std::for_each(domainRows_.begin(), domainRows_.end(), renumber_);
+
+  sorted_ = std::is_sorted(timeStamp_.begin(), timeStamp_.end());
+  dropAddrIndex();
+}
+
+/*!
+ * \brief Removes every row.
+ */
+void
+SLPColumnStore::clear()
+{
+  *this = SLPColumnStore();
+}
+
+/*!
+ * \brief Returns a copy of the store sorted by timestamp. Rows with the same
+ * timestamp keep their order.
+ */
+std::shared_ptr<SLPColumnStore>
+SLPColumnStore::sorted() const
+{
+  std::vector<uint32_t> order_(size());
+  std::iota(order_.begin(), order_.end(), 0);
+  std::stable_sort(
+    order_.begin(), order_.end(), [this](uint32_t a_, uint32_t b_) {
+      return timeStamp_[a_] < timeStamp_[b_];
+    });
+
+  auto dst_ = std::make_shared<SLPColumnStore>();
+  auto gather_ = [&order_](auto& dst_, const auto& src_) {
+    dst_.reserve(src_.size());
+    for (const uint32_t r_ : order_) {
+      dst_.push_back(src_[r_]);
+    }
+  };
+  gather_(dst_->timeStamp_, timeStamp_);
+  gather_(dst_->cliSrcIpAddr_, cliSrcIpAddr_);
+  gather_(dst_->responseTime_, responseTime_);
+  gather_(dst_->httpStatus_, httpStatus_);
+  gather_(dst_->totalSizeReply_, totalSizeReply_);
+  for (size_t c_ = 0; c_ < textColumns; ++c_) {
+    TextColumn& col_ = dst_->text_[c_];
+    if (dictColumns_[c_]) {
+      col_.dict_ = text_[c_].dict_;
+      gather_(col_.codes_, text_[c_].codes_);
+      continue;
+    }
+    col_.blob_.reserve(text_[c_].blob_.size());
+    col_.end_.reserve(size());
+    for (const uint32_t r_ : order_) {
+      col_.blob_.append(text(c_, r_));
+      col_.end_.push_back(col_.blob_.size());
+    }
+  }
+
+  dst_->hosts_ = hosts_;
+  dst_->domains_ = domains_;
+  dst_->hostDomain_ = hostDomain_;
+  dst_->hostCodes_.reserve(size());
+  dst_->hostRows_.resize(hostRows_.size());
+  for (size_t c_ = 0; c_ < hostRows_.size(); ++c_) {
+    dst_->hostRows_[c_].reserve(hostRows_[c_].size());
+  }
+  dst_->domainRows_.resize(domainRows_.size());
+  for (size_t c_ = 0; c_ < domainRows_.size(); ++c_) {
+    dst_->domainRows_[c_].reserve(domainRows_[c_].size());
+  }
+  for (const uint32_t r_ : order_) {
+    dst_->addHost(hostCodes_[r_]);
+  }
+  dst_->buildZones(0);
+  return dst_;
+}
+
+/*!
+ * \brief First row whose timestamp is not less than ts_. The store must be
+ * sorted.
+ */
+size_t
+SLPColumnStore::lowerBound(uint32_t ts_) const
+{
+  return std::lower_bound(timeStamp_.begin(), timeStamp_.end(), ts_) -
+         timeStamp_.begin();
+}
+
+/*!
+ * \brief First row whose timestamp is greater than ts_. The store must be
+ * sorted.
+ */
+size_t
+SLPColumnStore::upperBound(uint32_t ts_) const
+{
+  return std::upper_bound(timeStamp_.begin(), timeStamp_.end(), ts_) -
+         timeStamp_.begin();
+}
+
+/*!
+ * \brief Changes the address of a row. The zone map of its segment is
+ * widened, not recomputed.
+ */
+void
+SLPColumnStore::setAddr(size_t row_, uint32_t addr_)
+{
+  cliSrcIpAddr_[row_] = addr_;
+  Zone& z_ = zones_[row_ / segmentRows];
+  z_.minAddr_ = std::min(z_.minAddr_, addr_);
+  z_.maxAddr_ = std::max(z_.maxAddr_, addr_);
+  dropAddrIndex();
+}
+
+/*!
+ * \brief Builds the index on the client address: the row numbers sorted by
+ * address, then by row number.
+ */
+void
+SLPColumnStore::buildAddrIndex()
+{
+  addrIndex_.resize(size());
+  std::iota(addrIndex_.begin(), addrIndex_.end(), 0);
+  std::sort(
+    addrIndex_.begin(), addrIndex_.end(), [this](uint32_t a_, uint32_t b_) {
+      return cliSrcIpAddr_[a_] != cliSrcIpAddr_[b_]
+               ? cliSrcIpAddr_[a_] < cliSrcIpAddr_[b_]
+               : a_ < b_;
+    });
+  indexed_ = true;
+}
+
+/*!
+ * \brief Looks up the rows of [begin_, end_) whose address may be in r_.
+ *
+ * Used when there is an address index, r_ is an IPv4 range and the index
+ * gives fewer rows than [begin_, end_). The rows still have to be tested
+ * with SLPAddrDict::contains().
+ *
+ * \param rows_ The rows, in ascending order.
+ * \return false if the index was not used; rows_ is then untouched.
+ */
+bool
+SLPColumnStore::selectByAddr(const SLPAddrDict::Range& r_,
+                             size_t begin_,
+                             size_t end_,
+                             std::vector<uint32_t>& rows_) const
+{
+  if (!indexed_ || !r_.v4_) {
+    return false;
+  }
+  auto lo_ = std::lower_bound(addrIndex_.begin(),
+                              addrIndex_.end(),
+                              r_.lo4_,
+                              [this](uint32_t row_, uint32_t a_) {
+                                return cliSrcIpAddr_[row_] < a_;
+                              });
+  auto hi_ = std::upper_bound(lo_,
+                              addrIndex_.end(),
+                              r_.hi4_,
+                              [this](uint32_t a_, uint32_t row_) {
+                                return a_ < cliSrcIpAddr_[row_];
+                              });
+  if (static_cast<size_t>(hi_ - lo_) >= end_ - begin_) {
+    return false; // the time range is as short: scan it
+  }
+  rows_.clear();
+  for (; lo_ != hi_; ++lo_) {
+    if (*lo_ >= begin_ && *lo_ < end_) {
+      rows_.push_back(*lo_);
+    }
+  }
+  std::sort(rows_.begin(), rows_.end());
+  return true;
+}
+
+/*!
+ * \brief Rows of [begin_, end_) whose ReqURL has the host host_, read from
+ * the inverted index: no URL is read. The case of host_ is ignored.
+ *
+ * \param subdomains_ Also the rows of the subdomains of host_. If host_ is
+ * the registrable domain of all of them its postings are used, otherwise
+ * those of each host found in the dictionary of hosts are merged.
+ * \param rows_ The rows, in ascending order.
+ */
+void
+SLPColumnStore::selectByHost(std::string_view host_,
+                             bool subdomains_,
+                             size_t begin_,
+                             size_t end_,
+                             std::vector<uint32_t>& rows_) const
+{
+  rows_.clear();
+  std::string name_(host_);
+  std::transform(
+    name_.begin(), name_.end(), name_.begin(), [](unsigned char c_) {
+      return static_cast<char>(std::tolower(c_));
+    });
+  if (!name_.empty() && name_.back() == '.') {
+    name_.pop_back();
+  }
+
+  auto slice_ = [&rows_, begin_, end_](const std::vector<uint32_t>& post_) {
+    rows_.insert(rows_.end(),
+                 std::lower_bound(post_.begin(), post_.end(), begin_),
+                 std::lower_bound(post_.begin(), post_.end(), end_));
+  };
+
+  if (!subdomains_) {
+    if (const uint32_t c_ = hosts_.find(name_); c_ != SLPDictionary::npos) {
+      slice_(hostRows_[c_]);
+    }
+    return;
+  }
+
+  std::vector<uint32_t> found_;
+  const uint32_t domain_ = domains_.find(name_);
+  bool whole_ = domain_ != SLPDictionary::npos;
+  for (uint32_t c_ = 0; c_ < hosts_.size(); ++c_) {
+    if (SLPUrlParts::hostMatches(hosts_.text(c_), name_, true)) {
+      found_.push_back(c_);
+      whole_ = whole_ && hostDomain_[c_] == domain_;
+    }
+  }
+  if (whole_) {
+    slice_(domainRows_[domain_]);
+    return;
+  }
+  for (const uint32_t c_ : found_) {
+    slice_(hostRows_[c_]);
+  }
+  std::sort(rows_.begin(), rows_.end());
+}
+
+/*!
+ * \brief Column of an integer field: ResponseTime, HttpStatus or
+ * TotalSizeReply.
+ * \return nullptr for the other fields.
+ */
+const std::vector<int>*
+SLPColumnStore::ints(Fields f_) const
+{
+  switch (f_) {
+    case Fields::ResponseTime: {
+      return &responseTime_;
+    }
+    case Fields::HttpStatus: {
+      return &httpStatus_;
+    }
+    case Fields::TotalSizeReply: {
+      return &totalSizeReply_;
+    }
+    default: {
+      return nullptr;
+    }
+  }
+}
+
+/*!
+ * \brief Text of a field in a row. Valid while the store is not modified.
+ * \return An empty view if f_ is not a text field.
+ */
+std::string_view
+SLPColumnStore::text(Fields f_, size_t row_) const
+{
+  const int c_ = textIndex(f_);
+  return c_ < 0 ? std::string_view() : text(static_cast<size_t>(c_), row_);
+}
+
+/*!
+ * \brief Dictionary of a text field stored as codes.
+ * \return nullptr if f_ is not a dictionary column.
+ */
+const SLPDictionary*
+SLPColumnStore::dictionary(Fields f_) const
+{
+  const int c_ = textIndex(f_);
+  return c_ >= 0 && dictColumns_[c_] ? &text_[c_].dict_ : nullptr;
+}
+
+/*!
+ * \brief Codes of a dictionary column, see dictionary().
+ * \return nullptr if f_ is not a dictionary column.
+ */
+const std::vector<uint32_t>*
+SLPColumnStore::codes(Fields f_) const
+{
+  const int c_ = textIndex(f_);
+  return c_ >= 0 && dictColumns_[c_] ? &text_[c_].codes_ : nullptr;
+}
+
+/*!
+ * \brief Returns a row as a DataSet_View into the columns.
+ */
+SLPColumnStore::Row
+SLPColumnStore::row(size_t row_) const
+{
+  Row r_;
+  r_.timeStamp = timeStamp_[row_];
+  r_.cliSrcIpAddr = cliSrcIpAddr_[row_];
+  r_.responseTime = responseTime_[row_];
+  r_.httpStatus = httpStatus_[row_];
+  r_.totalSizeReply = totalSizeReply_[row_];
+  for (size_t c_ = 0; c_ < textColumns; ++c_) {
+    r_.*textMembers_[c_] = text(c_, row_);
+  }
+  return r_;
+}
+
+/*!
+ * \brief Bytes allocated by the columns and the indexes.
+ */
+size_t
+SLPColumnStore::bytes() const
+{
+  size_t n_ = zoneBytes() + addrIndexBytes() + hostIndexBytes();
+  for (int f_ = 0; f_ < static_cast<int>(Fields::Unknown); ++f_) {
+    n_ += bytes(static_cast<Fields>(f_));
+  }
+  return n_;
+}
+
+/*!
+ * \brief Bytes allocated by the column of f_, with its dictionary.
+ */
+size_t
+SLPColumnStore::bytes(Fields f_) const
+{
+  if (f_ == Fields::Timestamp) {
+    return timeStamp_.capacity() * sizeof(uint32_t);
+  }
+  if (f_ == Fields::CliSrcIpAddr) {
+    return cliSrcIpAddr_.capacity() * sizeof(uint32_t);
+  }
+  if (const std::vector<int>* col_ = ints(f_); col_ != nullptr) {
+    return col_->capacity() * sizeof(int);
+  }
+  const int c_ = textIndex(f_);
+  if (c_ < 0) {
+    return 0;
+  }
+  const TextColumn& col_ = text_[c_];
+  return col_.end_.capacity() * sizeof(uint64_t) + col_.blob_.capacity() +
+         col_.codes_.capacity() * sizeof(uint32_t) + col_.dict_.bytes();
+}
+
+/*!
+ * \brief Bytes allocated by the zone maps.
+ */
+size_t
+SLPColumnStore::zoneBytes() const
+{
+  return zones_.capacity() * sizeof(Zone);
+}
+
+/*!
+ * \brief Bytes allocated by the address index.
+ */
+size_t
+SLPColumnStore::addrIndexBytes() const
+{
+  return addrIndex_.capacity() * sizeof(uint32_t);
+}
+
+/*!
+ * \brief Bytes allocated by the host index: the host of each row, the
+ * dictionaries of hosts and domains and the postings.
+ */
+size_t
+SLPColumnStore::hostIndexBytes() const
+{
+  size_t n_ =
+    hosts_.bytes() + domains_.bytes() +
+    (hostCodes_.capacity() + hostDomain_.capacity()) * sizeof(uint32_t) +
+    (hostRows_.capacity() + domainRows_.capacity()) *
+      sizeof(std::vector<uint32_t>);
+  for (const std::vector<uint32_t>& rows_ : hostRows_) {
+    n_ += rows_.capacity() * sizeof(uint32_t);
+  }
+  for (const std::vector<uint32_t>& rows_ : domainRows_) {
+    n_ += rows_.capacity() * sizeof(uint32_t);
+  }
+  return n_;
+}
+
+/*!
+ * \brief Bytes taken by the rows, without the room reserved by the vectors
+ * and the strings. Cheaper than bytes(): the postings are not visited.
+ */
+size_t
+SLPColumnStore::usedBytes() const
+{
+  size_t n_ = size() * (2 * sizeof(uint32_t) + intColumns * sizeof(int));
+  for (const TextColumn& col_ : text_) {
+    n_ += col_.end_.size() * sizeof(uint64_t) + col_.blob_.size() +
+          col_.codes_.size() * sizeof(uint32_t) + col_.dict_.bytes();
+  }
+  // Each row is in the postings of its host and of its domain.
+  n_ += zones_.size() * sizeof(Zone) + addrIndex_.size() * sizeof(uint32_t) +
+        hosts_.bytes() + domains_.bytes() +
+        (3 * hostCodes_.size() + hostDomain_.size()) * sizeof(uint32_t) +
+        (hostRows_.size() + domainRows_.size()) * sizeof(std::vector<uint32_t>);
+  return n_;
+}
+
+/*!
+ * \brief Adds the rows to out_: the numeric columns, then each text column
+ * (end offsets and text, or dictionary and codes), the zone maps and the host
+ * index without its postings.
+ */
+void
+SLPColumnStore::save(SLPSnapshot& out_) const
+{
+  out_.add(timeStamp_);
+  out_.add(cliSrcIpAddr_);
+  out_.add(responseTime_);
+  out_.add(httpStatus_);
+  out_.add(totalSizeReply_);
+  for (size_t c_ = 0; c_ < textColumns; ++c_) {
+    const TextColumn& col_ = text_[c_];
+    if (dictColumns_[c_]) {
+      col_.dict_.save(out_);
+      out_.add(col_.codes_);
+    } else {
+      out_.add(col_.end_);
+      out_.add(col_.blob_);
+    }
+  }
+  out_.add(zones_);
+  hosts_.save(out_);
+  domains_.save(out_);
+  out_.add(hostCodes_);
+  out_.add(hostDomain_);
+}
+
+/*!
+ * \brief Replaces the rows with the ones written by save(). Every section is
+ * copied as a whole; only the postings of the host index are rebuilt.
+ * \return false, leaving the store empty, if the sections are missing or
+ * inconsistent.
+ */
+bool
+SLPColumnStore::load(SLPSnapshot& in_)
+{
+  clear();
+  bool ok_ = in_.read(timeStamp_) && in_.read(cliSrcIpAddr_) &&
+             in_.read(responseTime_) && in_.read(httpStatus_) &&
+             in_.read(totalSizeReply_);
+  const size_t n_ = size();
+  ok_ = ok_ && cliSrcIpAddr_.size() == n_ && responseTime_.size() == n_ &&
+        httpStatus_.size() == n_ && totalSizeReply_.size() == n_;
+
+  // True if v_ has a code for each row, all below size_.
+  auto inRange_ = [n_](const std::vector<uint32_t>& v_, size_t size_) {
+    return v_.size() == n_ &&
+           std::all_of(
+             v_.begin(), v_.end(), [size_](uint32_t c_) { return c_ < size_; });
+  };
+  for (size_t c_ = 0; ok_ && c_ < textColumns; ++c_) {
+    TextColumn& col_ = text_[c_];
+    if (dictColumns_[c_]) {
+      ok_ = col_.dict_.load(in_) && in_.read(col_.codes_) &&
+            inRange_(col_.codes_, col_.dict_.size());
+    } else {
+      ok_ = in_.read(col_.end_) && in_.read(col_.blob_) &&
+            col_.end_.size() == n_ &&
+            std::is_sorted(col_.end_.begin(), col_.end_.end()) &&
+            (n_ > 0 ? col_.end_.back() : 0) == col_.blob_.size();
+    }
+  }
+
+  std::vector<uint32_t> hosts_in_;
+  ok_ = ok_ && in_.read(zones_) &&
+        zones_.size() == (n_ + segmentRows - 1) / segmentRows &&
+        hosts_.load(in_) && domains_.load(in_) && in_.read(hosts_in_) &&
+        in_.read(hostDomain_) && inRange_(hosts_in_, hosts_.size()) &&
+        hostDomain_.size() == hosts_.size() &&
+        std::all_of(hostDomain_.begin(),
+                    hostDomain_.end(),
+                    [this](uint32_t d_) { return d_ < domains_.size(); });
+  if (!ok_) {
+    clear();
+    return false;
+  }
+
+  hostCodes_.reserve(n_);
+  hostRows_.resize(hosts_.size());
+  domainRows_.resize(domains_.size());
+  for (const uint32_t code_ : hosts_in_) {
+    addHost(code_);
+  }
+  sorted_ = std::is_sorted(timeStamp_.begin(), timeStamp_.end());
+  return true;
+}
+
+/*!
+ * \brief Position of an integer field in Zone::minInt_ and Zone::maxInt_,
+ * or -1.
+ */
+int
+SLPColumnStore::intIndex(Fields f_)
+{
+  switch (f_) {
+    case Fields::ResponseTime: {
+      return 0;
+    }
+    case Fields::HttpStatus: {
+      return 1;
+    }
+    case Fields::TotalSizeReply: {
+      return 2;
+    }
+    default: {
+      return -1;
+    }
+  }
+}
+
+/*!
+ * \brief Position of a text field in Zone::nulls_, or -1.
+ */
+int
+SLPColumnStore::textIndex(Fields f_)
+{
+  switch (f_) {
+    case Fields::LocalTime: {
+      return 0;
+    }
+    case Fields::UserName: {
+      return 1;
+    }
+    case Fields::UserNameIdent: {
+      return 2;
+    }
+    case Fields::ReqMethod: {
+      return 3;
+    }
+    case Fields::ReqURL: {
+      return 4;
+    }
+    case Fields::ReqProtoVersion: {
+      return 5;
+    }
+    case Fields::ReqStatusHierStatus: {
+      return 6;
+    }
+    case Fields::HierStatusIpAddress: {
+      return 7;
+    }
+    case Fields::MimeContentType: {
+      return 8;
+    }
+    case Fields::OrigRcvReqHeader: {
+      return 9;
+    }
+    case Fields::Referrer: {
+      return 10;
+    }
+    case Fields::UserAgent: {
+      return 11;
+    }
+    default: {
+      return -1;
+    }
+  }
+}
+
+/*!
+ * \internal
+ */
+std::string_view
+SLPColumnStore::text(size_t column_, size_t row_) const
+{
+  const TextColumn& col_ = text_[column_];
+  if (dictColumns_[column_]) {
+    return col_.dict_.text(col_.codes_[row_]);
+  }
+  const uint64_t begin_ = row_ > 0 ? col_.end_[row_ - 1] : 0;
+  return std::string_view(col_.blob_.data() + begin_,
+                          col_.end_[row_] - begin_);
+}
+
+/*!
+ * \internal
+ * \brief Adds the last row appended to the zone map of its segment, opening
+ * a new segment when the last one is full.
+ */
+void
+SLPColumnStore::zoneRow(size_t row_)
+{
+  const uint32_t ts_ = timeStamp_[row_];
+  const uint32_t addr_ = cliSrcIpAddr_[row_];
+  const std::array<int, intColumns> ints_ = { responseTime_[row_],
+                                              httpStatus_[row_],
+                                              totalSizeReply_[row_] };
+  if (row_ % segmentRows == 0) {
+    zones_.push_back({ ts_, ts_, addr_, addr_, ints_, ints_, {} });
+  } else {
+    Zone& z_ = zones_.back();
+    z_.minTs_ = std::min(z_.minTs_, ts_);
+    z_.maxTs_ = std::max(z_.maxTs_, ts_);
+    z_.minAddr_ = std::min(z_.minAddr_, addr_);
+    z_.maxAddr_ = std::max(z_.maxAddr_, addr_);
+    for (size_t i_ = 0; i_ < intColumns; ++i_) {
+      z_.minInt_[i_] = std::min(z_.minInt_[i_], ints_[i_]);
+      z_.maxInt_[i_] = std::max(z_.maxInt_[i_], ints_[i_]);
+    }
+  }
+  Zone& z_ = zones_.back();
+  for (size_t c_ = 0; c_ < textColumns; ++c_) {
+    z_.nulls_[c_] += isNull(text(c_, row_));
+  }
+}
+
+/*!
+ * \internal
+ * \brief Forgets the address index, which no longer matches the rows.
+ */
+void
+SLPColumnStore::dropAddrIndex()
+{
+  if (indexed_) {
+    addrIndex_.clear();
+    addrIndex_.shrink_to_fit();
+    indexed_ = false;
+  }
+}
+
+/*!
+ * \internal
+ * \brief Code of the host of url_, in lower case. A new host is given the
+ * code of its registrable domain and empty postings.
+ */
+uint32_t
+SLPColumnStore::internHost(std::string_view url_)
+{
+  std::string_view host_ = SLPUrlParts::host(url_);
+  std::string lower_;
+  if (std::any_of(host_.begin(), host_.end(), [](unsigned char c_) {
+        return std::isupper(c_);
+      })) {
+    lower_.assign(host_);
+    std::transform(
+      lower_.begin(), lower_.end(), lower_.begin(), [](unsigned char c_) {
+        return static_cast<char>(std::tolower(c_));
+      });
+    host_ = lower_;
+  }
+
+  const uint32_t code_ = hosts_.encode(host_);
+  if (code_ == hostDomain_.size()) {
+    const uint32_t domain_ =
+      domains_.encode(SLPUrlParts::registrableDomain(host_));
+    hostDomain_.push_back(domain_);
+    hostRows_.emplace_back();
+    if (domain_ == domainRows_.size()) {
+      domainRows_.emplace_back();
+    }
+  }
+  return code_;
+}
+
+/*!
+ * \internal
+ * \brief Gives host_ to the next row, and adds the row to the postings of the
+ * host and of its domain.
+ */
+void
+SLPColumnStore::addHost(uint32_t host_)
+{
+  const uint32_t row_ = static_cast<uint32_t>(hostCodes_.size());
+  hostCodes_.push_back(host_);
+  hostRows_[host_].push_back(row_);
+  domainRows_[hostDomain_[host_]].push_back(row_);
+}
+
+/*!
+ * \internal
+ * \brief Rebuilds the zone maps of the segments from the one of row from_.
+ */
+void
+SLPColumnStore::buildZones(size_t from_)
+{
+  zones_.resize(from_ / segmentRows);
+  for (size_t r_ = zones_.size() * segmentRows; r_ < size(); ++r_) {
+    zoneRow(r_);
+  }
+}
+
+/* SquidLogParser ---------------------------------------------------------- */
+SquidLogParser::SquidLogParser(LogFormat log_fmt_)
+  : mEntry(std::make_shared<Entries>())
+  , mView(std::make_shared<Views>())
+  , arena_(std::make_shared<SLPLineArena>())
+  , addrDict_(std::make_shared<SLPAddrDict>())
+  , columns_(std::make_shared<SLPColumnStore>())
+  , logFmt_(std::move(log_fmt_))
+  , parserMode_(ParserMode::Tokenizer)
+  , storageMode_(StorageMode::Copy)
+  , addrIndex_(false)
+  , memoryBudget_(0)
+  , entryBytes_(0)
+  , evictions_({})
+  , spill_()
+  , spillLine_({})
+  , rawLog_({})
+  , line_()
+  , pending_({})
+  , delimIndex_()
+  , logFileName_({})
+  , ds_squid_({})
+  , ds_view_({})
+  , dateDecoder_()
+  , re_id_fmt_squid_(std::move(cp_id_fmt_squid_))
+  , re_id_fmt_common_(std::move(cp_id_fmt_common_))
+  , re_id_fmt_combined_(std::move(cp_id_fmt_combined_))
+  , re_id_fmt_referrer_(std::move(cp_id_fmt_referrer_))
+  , re_id_fmt_useragent_(std::move(cp_id_fmt_useragent_))
+{
+  std::signal(SIGINT, signalHandler);
+};
+
+/*!
+ * \brief Creates a parser for a format compiled from a logformat directive.
+ * \param log_fmt_ Compiled format. If it is not valid, errorNum() returns
+ * SLP_ERR_INVALID_LOGFORMAT and no line is accepted.
+ */
+SquidLogParser::SquidLogParser(const SLPLogFormat& log_fmt_)
+  : SquidLogParser(LogFormat::Custom)
+{
+  logFormat_ = std::make_shared<const SLPLogFormat>(log_fmt_);
+  if (!logFormat_->isValid()) {
+    setError(SLPError::SLP_ERR_INVALID_LOGFORMAT);
+  }
+}
+
+/*!
+ * \brief Appends the log entries to the system.
+ * \param raw_log_
+ */
+SquidLogParser&
+SquidLogParser::append(const std::string& raw_log_)
+{
+  appendLine(raw_log_);
+  return *this;
+}
+
+/*!
+ * \brief Appends every complete line of a buffer, e.g. a chunk given by
+ * read(). The lines are parsed in place.
+ * \param data_ Bytes of the log file. Lines end with '\n'; a '\r' before it
+ * is taken as white space.
+ * \param size_ Number of bytes in data_.
+ * \return lineCount_t Lines accepted and rejected by the parser.
+ *
+ * \note The text after the last '\n' is kept and completed by the next call.
+ * Call flush() at the end of the input to parse it.
+ */
+SquidLogParser::lineCount_t
+SquidLogParser::appendBuffer(const char* data_, size_t size_)
+{
+  lineCount_t count_ = {};
+  const char* p_ = data_;
+  const char* end_ = data_ + size_;
+
+  if (!pending_.empty()) {
+    const char* nl_ = static_cast<const char*>(std::memchr(p_, '\n', size_));
+    if (nl_ == nullptr) {
+      pending_.append(p_, size_);
+      return count_;
+    }
+    pending_.append(p_, nl_ - p_);
+    appendCounted(pending_, count_);
+    pending_.clear();
+    p_ = nl_ + 1;
+  }
+
+  while (p_ != end_) {
+    const char* nl_ =
+      static_cast<const char*>(std::memchr(p_, '\n', end_ - p_));
+    if (nl_ == nullptr) {
+      pending_.assign(p_, end_ - p_);
+      break;
+    }
+    appendCounted(std::string_view(p_, nl_ - p_), count_);
+    p_ = nl_ + 1;
+  }
+  return count_;
+}
+
+/*!
+ * \brief Reads the whole stream with appendBuffer() and then calls flush().
+ * \param in_ Log file, opened in binary mode.
+ * \param read_size_ Bytes read at a time.
+ * \return lineCount_t Lines accepted and rejected by the parser.
+ */
+SquidLogParser::lineCount_t
+SquidLogParser::appendStream(std::istream& in_, size_t read_size_)
+{
+  lineCount_t count_ = {};
+  std::unique_ptr<char[]> buf_(new char[std::max<size_t>(read_size_, 1)]);
+
+  while (in_) {
+    in_.read(buf_.get(), std::max<size_t>(read_size_, 1));
+    const lineCount_t part_ =
+      appendBuffer(buf_.get(), static_cast<size_t>(in_.gcount()));
+    count_.Accepted += part_.Accepted;
+    count_.Rejected += part_.Rejected;
+  }
+  const lineCount_t last_ = flush();
+  count_.Accepted += last_.Accepted;
+  count_.Rejected += last_.Rejected;
+  return count_;
+}
+
+/*!
+ * \brief Parses the unterminated line kept by appendBuffer(), if any.
+ * \return lineCount_t Lines accepted and rejected by the parser.
+ */
+SquidLogParser::lineCount_t
+SquidLogParser::flush()
+{
+  lineCount_t count_ = {};
+  if (!pending_.empty()) {
+    appendCounted(pending_, count_);
+    pending_.clear();
+  }
+  return count_;
+}
+
+/*!
+ * \brief Loads a whole log file. The file is mapped in memory and cut into
+ * chunks at line boundaries. Each chunk is parsed by its own thread into a
+ * separate store, and the stores are then merged in timestamp order.
+ * \param path_ Log file.
+ * \param threads_ Number of threads; 0 uses one per hardware thread. Files
+ * smaller than a few MiB per thread use fewer threads.
+ * \return lineCount_t Lines accepted and rejected by the parser. If the file
+ * cannot be read, errorNum() returns SLP_ERR_LOG_FILE_NOT_READ.
+ *
+ * \note The entries with the same timestamp keep the order of the file.
+ * \note Compressed files (gzip, xz, zstd) are recognized by their first
+ * bytes. They are decompressed by an SLPDecompressor thread while the calling
+ * thread parses; threads_ is not used.
+ */
+SquidLogParser::lineCount_t
+SquidLogParser::loadFile(const std::string& path_, unsigned threads_)
+{
+  constexpr size_t minChunk_ = 4 << 20; // smaller ones aren't worth a thread
+
+  lineCount_t count_ = {};
+  const int fd_ = open(path_.c_str(), O_RDONLY);
+  struct stat st_;
+  if (fd_ < 0 || fstat(fd_, &st_) != 0) {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    setError(SLPError::SLP_ERR_LOG_FILE_NOT_READ);
+    return count_;
+  }
+  std::array<unsigned char, 6> magic_ = {};
+  const ssize_t m_ = pread(fd_, magic_.data(), magic_.size(), 0);
+  if (SLPDecompressor::detect(magic_.data(), m_ > 0 ? m_ : 0) !=
+      SLPDecompressor::Codec::None) {
+    close(fd_);
+    return loadCompressed(path_);
+  }
+  const size_t size_ = static_cast<size_t>(st_.st_size);
+  void* map_ =
+    size_ > 0 ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0) : nullptr;
+  close(fd_);
+  if (map_ == MAP_FAILED) {
+    setError(SLPError::SLP_ERR_LOG_FILE_NOT_READ);
+    return count_;
+  }
+  if (size_ == 0) {
+    setError(SLPError::SLP_SUCCESS);
+    return count_;
+  }
+  madvise(map_, size_, MADV_SEQUENTIAL);
+
+  const char* data_ = static_cast<const char*>(map_);
+  const char* end_ = data_ + size_;
+
+  if (threads_ == 0) {
+    threads_ = std::max(1U, std::thread::hardware_concurrency());
+  }
+  const size_t n_ =
+    std::max<size_t>(1, std::min<size_t>(threads_, size_ / minChunk_));
+
+  // cuts_[i] .. cuts_[i + 1] is the chunk i. Every chunk but the last one
+  // ends just after a '\n'.
+  std::vector<const char*> cuts_{ data_ };
+  for (size_t i_ = 1; i_ < n_; ++i_) {
+    const char* at_ = std::max(cuts_.back(), data_ + size_ / n_ * i_);
+    const char* nl_ =
+      static_cast<const char*>(std::memchr(at_, '\n', end_ - at_));
+    cuts_.push_back(nl_ != nullptr ? nl_ + 1 : end_);
+  }
+  cuts_.push_back(end_);
+
+  std::vector<std::unique_ptr<SquidLogParser>> parts_;
+  for (size_t i_ = 0; i_ < n_; ++i_) {
+    parts_.push_back(std::make_unique<SquidLogParser>(logFmt_));
+    parts_.back()->logFormat_ = logFormat_;
+    parts_.back()->parserMode_ = parserMode_;
+    parts_.back()->storageMode_ = storageMode_;
+  }
+
+  std::vector<lineCount_t> counts_(n_);
+  auto work_ = [&parts_, &cuts_, &counts_](size_t i_) {
+    counts_[i_] =
+      parts_[i_]->appendBuffer(cuts_[i_], cuts_[i_ + 1] - cuts_[i_]);
+    const lineCount_t last_ = parts_[i_]->flush();
+    counts_[i_].Accepted += last_.Accepted;
+    counts_[i_].Rejected += last_.Rejected;
+  };
+  std::vector<std::thread> workers_;
+  for (size_t i_ = 1; i_ < n_; ++i_) {
+    workers_.emplace_back(work_, i_);
+  }
+  work_(0);
+  for (std::thread& t_ : workers_) {
+    t_.join();
+  }
+  munmap(map_, size_);
+
+  std::vector<std::pair<Entries*, const SLPAddrDict*>> entries_;
+  std::vector<std::pair<Views*, const SLPAddrDict*>> views_;
+  SLPColumnStore& columns_out_ = unshared(columns_);
+  for (size_t i_ = 0; i_ < n_; ++i_) {
+    SquidLogParser& p_ = *parts_[i_];
+    entries_.emplace_back(p_.mEntry.get(), p_.addrDict_.get());
+    views_.emplace_back(p_.mView.get(), p_.addrDict_.get());
+    arena_->adopt(*p_.arena_);
+    // The chunks are in log order, so the columns are just concatenated.
+    const size_t base_ = columns_out_.size();
+    columns_out_.extend(*p_.columns_);
+    for (size_t r_ = base_; r_ < columns_out_.size(); ++r_) {
+      const uint32_t ip_ = columns_out_.addrs()[r_];
+      if (SLPAddrDict::isId(ip_)) {
+        columns_out_.setAddr(r_, addrDict_->import(*p_.addrDict_, ip_));
+      }
+    }
+    HttpCodesUniques_m.insert(p_.HttpCodesUniques_m.begin(),
+                              p_.HttpCodesUniques_m.end());
+    FiletypeUniques_m.insert(p_.FiletypeUniques_m.begin(),
+                             p_.FiletypeUniques_m.end());
+    entryBytes_ += p_.entryBytes_;
+    count_.Accepted += counts_[i_].Accepted;
+    count_.Rejected += counts_[i_].Rejected;
+  }
+  mergeParts(unshared(mEntry), entries_);
+  mergeParts(unshared(mView), views_);
+  if (memoryBudget_ != 0) {
+    enforceBudget();
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return count_;
+}
+
+/*!
+ * \internal
+ * \brief loadFile() for the compressed files.
+ */
+SquidLogParser::lineCount_t
+SquidLogParser::loadCompressed(const std::string& path_)
+{
+  lineCount_t count_ = {};
+  SLPDecompressor in_(path_);
+  if (!SLPDecompressor::supported(in_.codec())) {
+    setError(SLPError::SLP_ERR_UNSUPPORTED_COMPRESSION);
+    return count_;
+  }
+
+  for (std::string_view b_ = in_.next(); !b_.empty(); b_ = in_.next()) {
+    const lineCount_t part_ = appendBuffer(b_.data(), b_.size());
+    count_.Accepted += part_.Accepted;
+    count_.Rejected += part_.Rejected;
+  }
+  const lineCount_t last_ = flush();
+  count_.Accepted += last_.Accepted;
+  count_.Rejected += last_.Rejected;
+
+  setError(in_.failed() ? SLPError::SLP_ERR_LOG_FILE_NOT_READ
+                        : SLPError::SLP_SUCCESS);
+  return count_;
+}
+
+/*!
+ * \internal
+ * \brief Moves the entries of the sorted parts_ into dst_, in timestamp
+ * order, without copying them. On equal timestamps the first part wins.
+ * The IPv6 codes are translated from the dictionary of their part.
+ */
+template<typename TEntries>
+void
+SquidLogParser::mergeParts(
+  TEntries& dst_,
+  std::vector<std::pair<TEntries*, const SLPAddrDict*>>& parts_)
+{
+  for (;;) {
+    std::pair<TEntries*, const SLPAddrDict*>* min_ = nullptr;
+    for (auto& p_ : parts_) {
+      if (!p_.first->empty() &&
+          (min_ == nullptr ||
+           p_.first->begin()->first < min_->first->begin()->first)) {
+        min_ = &p_;
+      }
+    }
+    if (min_ == nullptr) {
+      break;
+    }
+
+    auto node_ = min_->first->extract(min_->first->begin());
+    if (SLPAddrDict::isId(node_.mapped().cliSrcIpAddr)) {
+      const uint32_t ip_ =
+        addrDict_->import(*min_->second, node_.mapped().cliSrcIpAddr);
+      node_.mapped().cliSrcIpAddr = ip_;
+      node_.key() = DataKey(node_.key().getTs(), ip_);
+    }
+    dst_.insert(dst_.end(), std::move(node_));
+  }
+}
+
+/*!
+ * \internal
+ * \brief Parses a line and stores the entry.
+ * \return false if the line was rejected by the parser.
+ */
+bool
+SquidLogParser::appendLine(std::string_view raw_log_)
+{
+  try {
+    if (parserMode_ == ParserMode::Regex) {
+      rawLog_.resize(
+        raw_log_.size()); // try to lower the dynamic memory allocation a bit.
+      removeExtraWhiteSpaces(raw_log_, rawLog_);
+      line_ = rawLog_;
+    } else {
+      line_ = raw_log_; // the tokenizer skips the extra white spaces itself.
+    }
+    if (usesViews()) {
+      switch (logFmt_) {
+        case LogFormat::Squid: {
+          return appendView<LogFormat::Squid>();
+        }
+        case LogFormat::Common: {
+          return appendView<LogFormat::Common>();
+        }
+        case LogFormat::Combined: {
+          return appendView<LogFormat::Combined>();
+        }
+        case LogFormat::Referrer: {
+          return appendView<LogFormat::Referrer>();
+        }
+        case LogFormat::UserAgent: {
+          return appendView<LogFormat::UserAgent>();
+        }
+        default: {
+          return false;
+        }
+      }
+    }
+
+    SLPError err_ = SLPError::SLP_ERR_PARSER_FAILED;
+    switch (logFmt_) {
+      case LogFormat::Squid: {
+        err_ = parserSquid();
+        break;
+      }
+      case LogFormat::Common: {
+        err_ = parserCommon();
+        break;
+      }
+      case LogFormat::Combined: {
+        err_ = parserCombined();
+        break;
+      }
+      case LogFormat::Referrer: {
+        err_ = parserReferrer();
+        break;
+      }
+      case LogFormat::UserAgent: {
+        err_ = parserUserAgent();
+        break;
+      }
+      case LogFormat::Custom: {
+        err_ = scanCustom();
+        break;
+      }
+      case LogFormat::Unknown: {
+        break;
+      }
+    }
+    if (err_ != SLPError::SLP_SUCCESS) {
+      return false;
+    }
+    Entries& entries_ = unshared(mEntry);
+    const auto it_ = entries_.emplace_hint(
+      entries_.end(),
+      DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
+      ds_squid_);
+    entryBytes_ += entryBytes(it_->second);
+    if (memoryBudget_ != 0) {
+      enforceBudget();
+    }
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  };
+
+  return true;
+}
+
+/*!
+ * \internal
+ * \brief appendLine() for the bulk functions: skips the blank lines and
+ * counts the others in count_.
+ */
+void
+SquidLogParser::appendCounted(std::string_view raw_log_, lineCount_t& count_)
+{
+  if (raw_log_.find_first_not_of(" \t\r\v\f") == std::string_view::npos) {
+    return;
+  }
+  if (appendLine(raw_log_)) {
+    ++count_.Accepted;
+  } else {
+    ++count_.Rejected;
+  }
+}
+
+/*!
+ * \brief Selects how the log lines are split into fields.
+ * \param mode_ ParserMode::Tokenizer (default) or ParserMode::Regex.
+ *
+ * \note ParserMode::Regex is noticeably slower. It is kept to validate the
+ * output of the tokenizer and as a fallback for unusual log files.
+ */
+void
+SquidLogParser::setParserMode(ParserMode mode_)
+{
+  parserMode_ = mode_;
+}
+
+/*!
+ * \brief Returns the current parser mode.
+ * \return ParserMode
+ */
+SquidLogParser::ParserMode
+SquidLogParser::parserMode() const
+{
+  return parserMode_;
+}
+
+/*!
+ * \brief Selects how the entries are kept in memory.
+ * \param mode_ StorageMode::Copy (default), StorageMode::Arena or
+ * StorageMode::Columnar.
+ *
+ * \note Should be called before the first append(). Entries stored under
+ * different modes are kept apart and are not merged in timestamp order.
+ */
+void
+SquidLogParser::setStorageMode(StorageMode mode_)
+{
+  storageMode_ = mode_;
+}
+
+/*!
+ * \brief Returns the current storage mode.
+ * \return StorageMode
+ */
+SquidLogParser::StorageMode
+SquidLogParser::storageMode() const
+{
+  return storageMode_;
+}
+
+/*!
+ * \brief Keeps an index on the client address of the StorageMode::Columnar
+ * entries, see SLPColumnStore::buildAddrIndex(). It is built when an
+ * SLPQuery is created, so that select() looks up the IPv4 ranges instead of
+ * testing every entry of the time range.
+ * \param on_ false (default) or true.
+ *
+ * \note The index costs 4 bytes per entry and a sort of the entries.
+ */
+void
+SquidLogParser::setAddrIndex(bool on_)
+{
+  addrIndex_ = on_;
+}
+
+/*!
+ * \brief True if setAddrIndex() turned the address index on.
+ * \return bool
+ */
+bool
+SquidLogParser::addrIndex() const
+{
+  return addrIndex_;
+}
+
+/*!
+ * \brief Returns the number of log entries read.
+ * \return size_t  Is an unsigned integral type.
+ */
+size_t
+SquidLogParser::size() const
+{
+  return mEntry->size() + mView->size() + columns_->size();
+}
+
+/*!
+ * \brief SquidLogParser::clear
+ *
+ * \note The entries, the lines of StorageMode::Arena and the columns of
+ * StorageMode::Columnar are handed to new stores, so that an SLPQuery created
+ * earlier keeps the old ones alive.
+ */
+void
+SquidLogParser::clear()
+{
+  mEntry = std::make_shared<Entries>();
+  entryBytes_ = 0;
+  mView = std::make_shared<Views>();
+  pending_.clear();
+  arena_ = std::make_shared<SLPLineArena>();
+  addrDict_ = std::make_shared<SLPAddrDict>();
+  columns_ = std::make_shared<SLPColumnStore>();
+}
+
+/*!
+ * \brief Bytes allocated for the entries, by column and index in
+ * StorageMode::Columnar. The nodes of the maps are estimated.
+ * \return memoryUsage_t
+ */
+SquidLogParser::memoryUsage_t
+SquidLogParser::memoryUsage() const
+{
+  memoryUsage_t m_ = {};
+  for (size_t f_ = 0; f_ < m_.Columns.size(); ++f_) {
+    m_.Columns[f_] = columns_->bytes(static_cast<Fields>(f_));
+    m_.Total += m_.Columns[f_];
+  }
+  m_.ZoneMaps = columns_->zoneBytes();
+  m_.AddrIndex = columns_->addrIndexBytes();
+  m_.HostIndex = columns_->hostIndexBytes();
+  m_.Entries = entryBytes_ + mView->size() * viewBytes_;
+  m_.Lines = arena_->capacity();
+  m_.AddrDict = addrDict_->bytes();
+  m_.Total += m_.ZoneMaps + m_.AddrIndex + m_.HostIndex + m_.Entries +
+              m_.Lines + m_.AddrDict;
+  return m_;
+}
+
+/*!
+ * \brief Limits the memory taken by the entries. When it goes over bytes_
+ * the oldest entries are evicted, until an eighth of the budget is free: the
+ * first entries of the map in StorageMode::Copy and Arena, the first segments
+ * of the columns in StorageMode::Columnar.
+ * \param bytes_ Budget, in bytes. 0 (default) removes it.
+ * \param spill_path_ If not empty, the entries evicted are appended to this
+ * file as lines of the log format, which loadFile() reads back. The entries
+ * of LogFormat::Custom are not spilled. If the file cannot be opened,
+ * errorNum() returns SLP_ERR_SPILL_FILE_NOT_OPEN and the budget is not
+ * changed.
+ *
+ * \note The budget counts the bytes in use by the entries, the lines, the
+ * columns and their indexes, not the IPv6 address dictionary. The columns
+ * are checked once per segment and keep the room of the rows evicted.
+ * loadFile() applies the budget once the file is loaded. In StorageMode::Copy
+ * and Arena nothing is evicted while an SLPQuery shares the entries, since
+ * their memory could not be freed.
+ */
+void
+SquidLogParser::setMemoryBudget(size_t bytes_, const std::string& spill_path_)
+{
+  std::shared_ptr<std::ofstream> spill_file_;
+  if (!spill_path_.empty()) {
+    spill_file_ = std::make_shared<std::ofstream>(
+      spill_path_, std::ios::binary | std::ios::app);
+    if (!*spill_file_) {
+      setError(SLPError::SLP_ERR_SPILL_FILE_NOT_OPEN);
+      return;
+    }
+  }
+  spill_ = std::move(spill_file_);
+  memoryBudget_ = bytes_;
+  setError(SLPError::SLP_SUCCESS);
+  if (memoryBudget_ != 0) {
+    enforceBudget();
+  }
+}
+
+/*!
+ * \brief Returns the budget given to setMemoryBudget(), or 0.
+ * \return size_t
+ */
+size_t
+SquidLogParser::memoryBudget() const
+{
+  return memoryBudget_;
+}
+
+/*!
+ * \brief Returns the evictions done to stay within the memory budget since
+ * the parser was created. Useful to size the budget.
+ * \return evictionCount_t
+ */
+SquidLogParser::evictionCount_t
+SquidLogParser::evictionCount() const
+{
+  return evictions_;
+}
+
+/*!
+ * \brief Saves every entry to a binary snapshot, to be read back by
+ * loadSnapshot() without parsing the log again.
+ *
+ * The entries are written as the columns of an SLPColumnStore, sorted by
+ * timestamp, whatever the storage mode: each column, dictionary and zone map
+ * is a section of an SLPSnapshot file, followed by the IPv6 addresses, the
+ * HTTP codes and the file types seen.
+ * \param path_ Snapshot file. It is replaced only once completely written.
+ * \return SLP_SUCCESS or SLP_ERR_SNAPSHOT_NOT_SAVED. The entries of
+ * LogFormat::Custom cannot be saved.
+ */
+SquidLogParser::SLPError
+SquidLogParser::saveSnapshot(const std::string& path_)
+{
+  if (logFmt_ == LogFormat::Custom || logFmt_ == LogFormat::Unknown) {
+    setError(SLPError::SLP_ERR_SNAPSHOT_NOT_SAVED);
+    return slpError_;
+  }
+
+  std::shared_ptr<const SLPColumnStore> store_ = columns_;
+  if (!mEntry->empty() || !mView->empty()) {
+    auto all_ = std::make_shared<SLPColumnStore>(*columns_);
+    for (const auto& it_ : *mEntry) {
+      all_->append(toView(it_.second));
+    }
+    for (const auto& it_ : *mView) {
+      all_->append(it_.second);
+    }
+    store_ = all_;
+  }
+  if (!store_->isSorted()) {
+    store_ = store_->sorted();
+  }
+
+  std::vector<short> codes_;
+  for (const auto& it_ : HttpCodesUniques_m) {
+    codes_.push_back(it_.first);
+  }
+  std::vector<std::string_view> types_;
+  for (const auto& it_ : FiletypeUniques_m) {
+    types_.push_back(it_.first);
+  }
+
+  SLPSnapshot out_;
+  store_->save(out_);
+  addrDict_->save(out_);
+  out_.add(std::move(codes_));
+  out_.addStrings(types_);
+  setError(out_.write(path_, static_cast<uint32_t>(logFmt_), store_->size()));
+  return slpError_;
+}
+
+/*!
+ * \brief Loads the entries of a snapshot written by saveSnapshot(). They are
+ * added to the StorageMode::Columnar entries, whatever the storage mode, so
+ * SLPQuery reads them in place.
+ *
+ * The file is mapped in memory and checked, then each section is copied to
+ * its column at once: no line is parsed. Into an empty parser the columns
+ * loaded are used as they are.
+ * \param path_ Snapshot file.
+ * \return size_t Entries loaded. If the file cannot be read, errorNum()
+ * returns SLP_ERR_SNAPSHOT_NOT_READ; if it is damaged, of another version or
+ * of another log format, SLP_ERR_SNAPSHOT_INVALID.
+ *
+ * \note The memory budget, if any, is applied once the snapshot is loaded.
+ */
+size_t
+SquidLogParser::loadSnapshot(const std::string& path_)
+{
+  SLPSnapshot in_;
+  if (const SLPError e_ = in_.open(path_); e_ != SLPError::SLP_SUCCESS) {
+    setError(e_);
+    return 0;
+  }
+  auto from_ = std::make_shared<SLPColumnStore>();
+  SLPAddrDict dict_;
+  std::vector<short> codes_;
+  std::vector<std::string_view> types_;
+  if (in_.header().logFormat_ != static_cast<uint32_t>(logFmt_) ||
+      !from_->load(in_) || from_->size() != in_.header().rows_ ||
+      !dict_.load(in_) || !in_.read(codes_) || !in_.readStrings(types_)) {
+    setError(SLPError::SLP_ERR_SNAPSHOT_INVALID);
+    return 0;
+  }
+
+  size_t base_ = 0;
+  if (columns_->size() == 0) {
+    columns_ = from_;
+  } else {
+    base_ = columns_->size();
+    unshared(columns_);
+    columns_->extend(*from_);
+  }
+  // The IPv6 clients take the ids of this parser.
+  for (size_t r_ = base_; r_ < columns_->size(); ++r_) {
+    const uint32_t ip_ = columns_->addrs()[r_];
+    if (SLPAddrDict::isId(ip_)) {
+      if (const uint32_t id_ = addrDict_->import(dict_, ip_); id_ != ip_) {
+        columns_->setAddr(r_, id_);
+      }
+    }
+  }
+  for (const short c_ : codes_) {
+    HttpCodesUniques_m.insert({ c_, 0 });
+  }
+  for (const std::string_view t_ : types_) {
+    FiletypeUniques_m.insert({ std::string(t_), 0 });
+  }
+  if (memoryBudget_ != 0) {
+    enforceBudget();
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return from_->size();
+}
+
+/*!
+ * \brief SquidLogParser::getPartInt
+ * \param f_
+ * \return int
+ */
+int
+SquidLogParser::getPartInt(Fields f_) const
+{
+  return usesViews() ? intFields(f_, ds_view_) : intFields(f_, ds_squid_);
+}
+
+/*!
+ * \brief SquidLogParser::getPartUInt
+ * \param f_
+ * \return uint32_t
+ */
+uint32_t
+SquidLogParser::getPartUInt(Fields f_) const
+{
+  return usesViews() ? uint32Fields(f_, ds_view_)
+                     : uint32Fields(f_, ds_squid_);
+}
+
+/*!
+ * \brief SquidLogParser::getPartStr
+ * \param f_
+ * \return std::string
+ */
+std::string
+SquidLogParser::getPartStr(Fields f_) const
+{
+  return usesViews() ? strFields(f_, ds_view_) : strFields(f_, ds_squid_);
+}
+
+/*!
+ * \brief Same as getPartStr(), without copying the text. The view is valid
+ * until the next append(), or until clear() with StorageMode::Arena or
+ * StorageMode::Columnar.
+ * \param f_ A text field. Timestamp and CliSrcIpAddr are numeric and give
+ * invalidText.
+ * \return std::string_view
+ */
+std::string_view
+SquidLogParser::getPartView(Fields f_) const
+{
+  return usesViews() ? viewFields(f_, ds_view_) : viewFields(f_, ds_squid_);
+}
+
+/*!
+ * \brief Returns a generic column of a LogFormat::Custom entry.
+ * \param column_ Index in SLPLogFormat::columns().
+ * \return std::string
+ */
+std::string
+SquidLogParser::getPartCustom(size_t column_) const
+{
+  return column_ < ds_squid_.customFields.size()
+           ? ds_squid_.customFields[column_]
+           : std::string(invalidText);
+}
+
+/*!
+ * \brief Returns a generic column of a LogFormat::Custom entry.
+ * \param code_ Format code, as in SLPLogFormat::columns(), e.g. ">ha".
+ * \return std::string
+ */
+std::string
+SquidLogParser::getPartCustom(std::string_view code_) const
+{
+  const int column_ = logFormat_ ? logFormat_->column(code_) : -1;
+  return column_ < 0 ? std::string(invalidText)
+                     : getPartCustom(static_cast<size_t>(column_));
+}
+
+/*!
+ * \brief addrToNumeric is a convenience function to be used
+ * in simple conversions or together with the the DataKey() object.
+ * \param addr_ IPv4 address in dot-decimal notation, or an IPv6 address.
+ * \return uint32_t Decimal representation. IPv6 addresses are represented by
+ * their SLPAddrDict id, or 0 if they were not read from the log.
+ * \note DataKey usage:
+ *
+ */
+uint32_t
+SquidLogParser::addrToNumeric(const std::string addr_) const
+{
+  return addrDict_->find(addr_);
+}
+
+/*!
+ * \brief numericToAddr, convenience function to be used in conversions.
+ * \param ip_ Decimal IPv4 representation, or the id of an IPv6 address.
+ * \return string IPv4 address in dot-decimal notation, or IPv6 address.
+ */
+std::string
+SquidLogParser::numericToAddr(const uint32_t&& ip_) const
+{
+  return (ip_ != 0UL ? addrDict_->text(ip_) : std::string());
+}
+
+/*!
+ * \brief unixTimestamp, convenience function that convert the human-readable
+ * format date to a Unix timestamp.
+ * \param d_ string date 'n' time
+ * \return uint32_t Epoch
+ * \note Date format accepted:dd/Mmm/yyyy:hh:mm:ss [+-zzzz]
+ * \note Without the UTC offset the date is taken as local time.
+ * \see SLPDateDecoder
+ */
+uint32_t
+SquidLogParser::unixTimestamp(const std::string d_) const
+{
+  return dateDecoder_.decode(d_);
+}
+
+/*!
+ * \brief unixToSquidDate, convenience function that convert the numeric
+ * Unix timestamp to a human-readable format date.
+ * \param uts_ Unix Timestamp.
+ * \return std::string Squid-format date in human-readable.
+ */
+std::string
+SquidLogParser::unixToSquidDate(std::time_t uts_) const
+{
+  char buf_[27];
+  // localtime_r(): SLPQuery calls it from several threads.
+  struct std::tm tm_ = {};
+  ::localtime_r(&uts_, &tm_);
+  ::strftime(buf_, sizeof(buf_), "%d/%b/%Y:%H:%M:%S %z", &tm_);
+  return std::string(buf_);
+}
+
+/*!
+ * \brief Converts log entries to XML format and writes to file.
+ * \param fn File name with path (Mandatory).
+ * \param Beginning date
+ * \param Beginning time
+ * \param End date
+ * \param End time
+ *
+ * \note If the user does not inform the '.xml' extension, the library will
+ * provide it. If another extension is informed, it will not be considered
+ * valid and the function will return -1.
+ *
+ * \warning Important: The SLPRawToXML object will always erase the data read
+ * after writing the XML file.
+ */
+
+SquidLogParser::SLPError
+SquidLogParser::toXML(const std::string&& fn_,
+                      const std::string&& d0_,
+                      const std::string&& ip0_,
+                      const std::string&& d1_,
+                      const std::string&& ip1_)
+{
+
+  if (fn_.empty()) {
+    setError(SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT);
+    return SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT;
+  }
+
+  if ((slpError_ == SLPError::SLP_SUCCESS) && (size() > 0)) {
+    uint32_t min = unixTimestamp(d0_);
+    uint32_t max = unixTimestamp(d1_);
+    SLPAddrDict::Range ip;
+    SLPAddrDict::range(ip0_, ip1_, ip);
+
+    SLPRawToXML xml(logFmt_, size(), logFormat_, addrDict_);
+    if (xml.save(fn_) != SLPError::SLP_SUCCESS) {
+      setError(SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT);
+      return SLPError::SLP_ERR_XML_FILE_NAME_INCONSISTENT;
+    }
+    if ((!d0_.empty() && !ip0_.empty()) && (!d1_.empty() && !ip1_.empty())) {
+      // Only the entries of [min, max] are visited.
+      for (auto [it_, end_] = timeRange(*mEntry, min, max); it_ != end_;
+           ++it_) {
+        if (addrDict_->contains(ip, it_->first.getIp())) {
+          xml.append(it_->second);
+        }
+      }
+      for (auto [it_, end_] = timeRange(*mView, min, max); it_ != end_;
+           ++it_) {
+        if (addrDict_->contains(ip, it_->first.getIp())) {
+          xml.append(toDataSet(it_->second));
+        }
+      }
+      prepareColumns();
+      const SLPColumnStore& cols_ = *columns_;
+      const size_t begin_ = cols_.lowerBound(min);
+      const size_t end_ = cols_.upperBound(max);
+      std::vector<uint32_t> rows_;
+      if (cols_.selectByAddr(ip, begin_, end_, rows_)) {
+        for (const uint32_t r_ : rows_) {
+          if (addrDict_->contains(ip, cols_.addrs()[r_])) {
+            xml.append(toDataSet(cols_.row(r_)));
+          }
+        }
+      } else {
+        cols_.forSegments(
+          begin_,
+          end_,
+          [&](const SLPColumnStore::Zone& z_, size_t r_, size_t stop_) {
+            if (z_.excludes(ip)) {
+              return;
+            }
+            for (; r_ < stop_; ++r_) {
+              if (addrDict_->contains(ip, cols_.addrs()[r_])) {
+                xml.append(toDataSet(cols_.row(r_)));
+              }
+            }
+          });
+      }
+    } else {
+      for (const auto& a : *mEntry) {
+        xml.append(a.second);
+      }
+      for (const auto& a : *mView) {
+        xml.append(toDataSet(a.second));
+      }
+      prepareColumns();
+      for (size_t r_ = 0; r_ < columns_->size(); ++r_) {
+        xml.append(toDataSet(columns_->row(r_)));
+      }
+    }
+    if (xml.close() != SLPError::SLP_SUCCESS) {
+      setError(SLPError::SLP_ERR_XML_FILE_NOT_SAVE);
+      return SLPError::SLP_ERR_XML_FILE_NOT_SAVE;
+    }
+  }
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \brief Show decoded URL
+ * \param raw_ Raw URL
+ * \return string URL decoded.
+ *
+ * \note This function is the result of Internet research and adaptations that
+ * we consider convenient.
+ */
+std::string
+SquidLogParser::ShowDecodedUrl(const std::string raw_) const
+{
+  std::string tmp_(raw_, raw_.size()); // tries to decrease dynamic allocation.
+
+  for (auto it_ = raw_.cbegin(); it_ != raw_.cend(); ++it_) {
+    switch (*it_) {
+      case '%': {
+        ++it_;
+        std::string byte_;
+        byte_.push_back(std::move(*it_));
+        ++it_;
+        byte_.push_back(std::move(*it_));
+        tmp_.push_back(
+          std::move(static_cast<unsigned char>(std::stol(byte_, nullptr, 16))));
+        break;
+      }
+      case '+': {
+        tmp_.push_back(std::move(' '));
+        break;
+      }
+      default: {
+        tmp_.push_back(std::move(*it_));
+      }
+    }
+  }
+  return tmp_;
+}
+
+/* protected----------------------------------------------------------------
+ */
+/*!
+ * \internal
+ * \brief Simple recursive uppercase to lowercase characters conversion.
+ * \param s_ Text with (maybe) uppercase  characteres.
+ * \return Text in lowercase.
+ */
+template<typename TString, typename TSize>
+TString
+SquidLogParser::toLower(TString s_, TSize sz_)
+{
+  if (sz_ != s_.size()) {
+    s_[sz_] = ::tolower(s_[sz_]);
+    s_ = toLower(s_, ++sz_);
+  }
+  return s_;
+}
+
+/*!
+ * \brief Returns the right part of string until the end. From position+1 of
+ * the informed separator.
+ *
+ * \param src_
+ * \param sep_
+ * \return std::string
+ *
+ * \example std::string s_ = strRight("NONE/200"s,'/'); // s_ = "200";
+ *
+ */
+std::string
+SquidLogParser::strRight(const std::string src_, const char sep_) const
+{
+  if (size_t f = std::string_view{ src_ }.find(sep_); f != std::string::npos) {
+    return src_.substr(f + 1, src_.length());
+  }
+  return std::string();
+}
+
+/*!
+ * \internal
+ * \brief Returns the filename extension, if there is one, in the URL passed as
+ * an argument. Only the HTTP and HTTPS protocols are valid.
+ *
+ * \param url_ URL
+ *
+ * \return Returns the extension along with the period, otherwise it returns an
+ * empty string.
+ *
+ * Examples of valid extensions: .xml .js .jpeg .woff .woff2
+ *
+ * Examples of invalid extensions: Any extension that
+ * does not consist exclusively of numbers or alphabetic characters.
+ * e.g: .gif%3Fpartner%3Dadobe%26partner_uid%3D$%7BDD_UUID%7D
+ */
+std::string
+SquidLogParser::getFiletype(const std::string& url_) const
+{
+  return std::string(getFiletypeView(url_));
+}
+
+/*!
+ * \internal
+ * \brief Same as getFiletype(), but works over a view of the URL and does not
+ * allocate. The result points into url_.
+ *
+ * \note It reproduces what std::filesystem::path::extension() returns for the
+ * URL: the text from the last '.' of the last path component, unless that
+ * component starts with the '.'.
+ */
+std::string_view
+SquidLogParser::getFiletypeView(std::string_view url_) const
+{
+  if (url_.find("http", 0, 4) == std::string_view::npos) {
+    return std::string_view();
+  }
+
+  std::string_view fname_ = url_;
+  if (const size_t f_ = url_.rfind('/'); f_ != std::string_view::npos) {
+    fname_ = url_.substr(f_ + 1);
+  }
+
+  const size_t dot_ = fname_.rfind('.');
+  if (dot_ == std::string_view::npos || dot_ == 0) {
+    return std::string_view();
+  }
+
+  std::string_view extension_ = fname_.substr(dot_);
+  if (std::any_of(extension_.cbegin(),
+                  extension_.cend(),
+                  [](unsigned char c) -> bool {
+                    if (c == '.' || c == '?') {
+                      return false;
+                    }
+                    return std::ispunct(c);
+                  })) {
+    return std::string_view();
+  }
+
+  const unsigned char last_ = extension_.back();
+  if (!std::isalpha(last_) || std::isdigit(last_)) {
+    extension_.remove_suffix(1);
+  }
+  return extension_;
+}
+
+/*!
+ * \internal
+ * \brief Returns true or false if month name is corret
+ * \param s Month name abbreviation
+ * \return true|false
+ * \code{.cc}
+ * bool b = isMonth("Jan");
+ * \endcode
+ */
+bool
+SquidLogParser::isMonth(const std::string&& s_)
+{
+  auto begin_ = std::cbegin(nmonths_);
+  auto end_ = std::cend(nmonths_);
+
+  const auto f_ = std::find_if(begin_, end_, [&s_](const char* cptr_) {
+    if (std::strcmp(s_.c_str(), cptr_) == 0) {
+      return true;
+    }
+    return false;
+  });
+
+  return (f_ != end_);
+}
+
+/*!
+ * \internal
+ * \brief Converts the month's name abbreviation to number.
+ * \param s_
+ * \return int
+ */
+int
+SquidLogParser::monthToNumber(const std::string&& s_) const
+{
+  auto begin_ = std::cbegin(nmonths_);
+  auto end_ = std::cend(nmonths_);
+
+  const auto f_ = std::find_if(begin_, end_, [&s_](const char* cptr_) {
+    if (std::strcmp(s_.c_str(), cptr_) == 0) {
+      return true;
+    }
+    return false;
+  });
+
+  if (f_ != end_) {
+    return std::distance(begin_, f_) + 1;
+  }
+  return 0;
+}
+
+/*!
+ * \brief Converts the month's number to abbreviation name.
+ * \param m_ A number between 1 and 12
+ * \return Abbrev of month's name
+ */
+std::string
+SquidLogParser::numberToMonth(const int&& m_) const
+{
+  if ((m_ >= 1) && (m_ <= 12)) {
+    return std::string(nmonths_[m_ - 1]);
+  }
+  return std::string();
+}
+
+/*!
+ * \internal
+ * \brief Parses date and time strings and save the values inside std::tm.
+ * \param d_ Date (dd/Mmm/yyyy:hh:mm:ss -0000)
+ * \return std::tm
+ */
+std::tm
+SquidLogParser::mkTime(const std::string d_) const
+{
+  struct std::tm tm_tmp = {};
+  tm_tmp.tm_year = std::move(std::stoi(d_.substr(7, 4))) - 1900;
+  tm_tmp.tm_mon = std::move(monthToNumber(d_.substr(3, 3))) - 1;
+  tm_tmp.tm_mday = std::move(std::stoi(d_.substr(0, 2)));
+  tm_tmp.tm_hour = std::move(std::stoi(d_.substr(12, 2)));
+  tm_tmp.tm_min = std::move(std::stoi(d_.substr(15, 2)));
+  tm_tmp.tm_sec = std::move(std::stoi(d_.substr(18, 2)));
+
+  return tm_tmp;
+}
+
+/*!
+ * \internal
+ * \brief SquidLogParser::setError
+ * \param e_ Error code
+ */
+void
+SquidLogParser::setError(SLPError e_)
+{
+  slpError_ = e_;
+}
+
+std::string
+SquidLogParser::getErrorRE(boost::regex_error& e_) const
+{
+  switch (e_.code()) {
+    case boost::regex_constants::error_collate: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_COLLATE);
+      break;
+    }
+    case boost::regex_constants::error_ctype: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_CTYPE);
+      break;
+    }
+    case boost::regex_constants::error_escape: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_ESCAPE);
+      break;
+    }
+    case boost::regex_constants::error_backref: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_BACKREF);
+      break;
+    }
+    case boost::regex_constants::error_brack: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_BRACK);
+      break;
+    }
+    case boost::regex_constants::error_paren: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_PAREN);
+      break;
+    }
+    case boost::regex_constants::error_brace: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_BRACE);
+      break;
+    }
+    case boost::regex_constants::error_badbrace: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_BADBRACE);
+      break;
+    }
+    case boost::regex_constants::error_range: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_RANGE);
+      break;
+    }
+    case boost::regex_constants::error_space: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_SPACE);
+      break;
+    }
+    case boost::regex_constants::error_badrepeat: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_BADREPEAT);
+      break;
+    }
+    case boost::regex_constants::error_complexity: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_COMPLEXITY);
+      break;
+    }
+    case boost::regex_constants::error_stack: {
+      const_cast<SquidLogParser*>(this)->setError(
+        SLPError::SLP_ERR_REGEX_STACK);
+      break;
+    }
+    default: {
+      const_cast<SquidLogParser*>(this)->setError(SLPError::SLP_ERR_UNKNOWN);
+    }
+  }
+  return getErrorText();
+}
+
+/*!
+ * \internal
+ * \brief Returns the value of integer fields
+ * \param f_ Field Id
+ * \param d_ Data
+ * \return int
+ */
+template<typename TDataSet>
+constexpr int
+SquidLogParser::intFields(Fields f_, const TDataSet& d_) const
+{
+
+  switch (f_) {
+    case Fields::ResponseTime: {
+      return d_.responseTime;
+    }
+    case Fields::TotalSizeReply: {
+      return d_.totalSizeReply;
+    }
+    case Fields::HttpStatus: {
+      return d_.httpStatus;
+    }
+    default: {
+      return -1;
+    }
+  }
+}
+
+/*!
+ * \internal
+ * \brief Returns the value of uint32_t fields
+ * \param f_ Field Id
+ * \param d_ Data
+ * \return uint32_t
+ */
+template<typename TDataSet>
+constexpr uint32_t
+SquidLogParser::uint32Fields(Fields f_, const TDataSet& d_) const
+{
+  switch (f_) {
+    case Fields::Timestamp: {
+      return d_.timeStamp;
+    }
+    case Fields::CliSrcIpAddr: {
+      return d_.cliSrcIpAddr;
+    }
+    default: {
+      return 0;
+    }
+  }
+}
+
+/*!
+ * \internal
+ * \brief Returns the value of string fields
+ * \param f_ Field Id
+ * \param d_ Data
+ * \return std::string
+ */
+template<typename TDataSet>
+std::string
+SquidLogParser::strFields(Fields f_, const TDataSet& d_) const
+{
+  switch (f_) {
+    case Fields::Timestamp: {
+      return unixToSquidDate(d_.timeStamp);
+    }
+    case Fields::CliSrcIpAddr: {
+      return addrDict_->text(d_.cliSrcIpAddr);
+    }
+    default: {
+      return std::string(viewFields(f_, d_));
+    }
+  }
+}
+
+/*!
+ * \internal
+ * \brief Returns the text of string fields without copying it. The numeric
+ * fields, including Timestamp and CliSrcIpAddr, give invalidText.
+ * \param f_ Field Id
+ * \param d_ Data
+ * \return std::string_view
+ */
+template<typename TDataSet>
+std::string_view
+SquidLogParser::viewFields(Fields f_, const TDataSet& d_) const
+{
+  switch (f_) {
+    case Fields::LocalTime: {
+      return d_.localTime;
+    }
+    case Fields::UserName: {
+      return d_.userName;
+    }
+    case Fields::UserNameIdent: {
+      return d_.userNameIdent;
+    }
+    case Fields::ReqMethod: {
+      return d_.reqMethod;
+    }
+    case Fields::ReqURL: {
+      return d_.reqURL;
+    }
+    case Fields::ReqProtoVersion: {
+      return d_.reqProtoVersion;
+    }
+    case Fields::ReqStatusHierStatus: {
+      return d_.reqStatusHierStatus;
+    }
+    case Fields::HierStatusIpAddress: {
+      return d_.hierStatusIpAddress;
+    }
+    case Fields::MimeContentType: {
+      return d_.mimeTypeContent;
+    }
+    case Fields::OrigRcvReqHeader: {
+      return d_.origRcvReqHeader;
+    }
+    case Fields::Referrer: {
+      return d_.referrer;
+    }
+    case Fields::UserAgent: {
+      return d_.userAgent;
+    }
+    default: {
+      return invalidText;
+    }
+  }
+}
+
+/*!
+ * \internal
+ * \brief Copies an entry of StorageMode::Arena to a DataSet_Squid that owns
+ * its strings.
+ * \param v_ Entry
+ * \return DataSet_Squid
+ */
+SquidLogData::DataSet_Squid
+SquidLogParser::toDataSet(const DataSet_View& v_) const
+{
+  return { v_.timeStamp,
+           v_.cliSrcIpAddr,
+           std::string(v_.localTime),
+           std::string(v_.userName),
+           std::string(v_.userNameIdent),
+           v_.responseTime,
+           std::string(v_.reqMethod),
+           std::string(v_.reqURL),
+           std::string(v_.reqProtoVersion),
+           v_.httpStatus,
+           std::string(v_.reqStatusHierStatus),
+           v_.totalSizeReply,
+           std::string(v_.hierStatusIpAddress),
+           std::string(v_.mimeTypeContent),
+           std::string(v_.origRcvReqHeader),
+           std::string(v_.referrer),
+           std::string(v_.userAgent),
+           {} };
+}
+
+/*!
+ * \internal
+ * \brief Views of the fields of an entry of StorageMode::Copy, valid as long
+ * as d_ is.
+ * \param d_ Entry
+ * \return DataSet_View
+ */
+SquidLogData::DataSet_View
+SquidLogParser::toView(const DataSet_Squid& d_)
+{
+  return { d_.timeStamp,
+           d_.cliSrcIpAddr,
+           d_.localTime,
+           d_.userName,
+           d_.userNameIdent,
+           d_.responseTime,
+           d_.reqMethod,
+           d_.reqURL,
+           d_.reqProtoVersion,
+           d_.httpStatus,
+           d_.reqStatusHierStatus,
+           d_.totalSizeReply,
+           d_.hierStatusIpAddress,
+           d_.mimeTypeContent,
+           d_.origRcvReqHeader,
+           d_.referrer,
+           d_.userAgent };
+}
+
+/*!
+ * \internal
+ * \brief The entries of store_ whose timestamp is within [min_, max_], found
+ * by binary search: DataKey orders the entries by timestamp only.
+ * \param store_ mEntry or mView
+ * \param min_ Lowest timestamp.
+ * \param max_ Highest timestamp.
+ * \return Iterators to the first entry and past the last one.
+ */
+template<typename TStore>
+std::pair<typename TStore::const_iterator, typename TStore::const_iterator>
+SquidLogParser::timeRange(const TStore& store_, uint32_t min_, uint32_t max_)
+{
+  if (max_ < min_) {
+    return { store_.cend(), store_.cend() };
+  }
+  return { store_.lower_bound(DataKey(min_, 0)),
+           store_.upper_bound(DataKey(max_, 0)) };
+}
+
+/*!
+ * \internal
+ * \brief This template function implements the logical AND and OR operations
+ * for functions like "between A AND B" or "between A OR B".
+ *
+ * \param data_ The data to be compared with its limits.
+ * \param min_ Lower value.
+ * \param max_ Highest value.
+ * \param cmp_ Type of logical operation: BTWAND | BTWOR
+ *
+ *
+ */
+template<typename TVarD, typename TMin, typename TMax, typename TCompare>
+bool
+SquidLogParser::decision(TVarD&& data_,
+                         TMin&& min_,
+                         TMax&& max_,
+                         TCompare&& cmp_) const
+{
+  switch (cmp_) {
+    case Compare::BTWAND: {
+      return ((data_ >= min_) && (data_ <= max_));
+    }
+    case Compare::BTWOR: {
+      return ((data_ >= min_) || (data_ <= max_));
+    }
+    default: {
+      return false;
+    }
+  }
+};
+
+/*!
+ * \internal
+ * \brief Overloaded: This template function implements the logical
+ * operations:
+ * == < > <= >= !=
+ * \param lhs_ Argument 1
+ * \param rhs_ Argument 2
+ * \param cmp_ Type of logical operation. EQ, LT, GT, LE, GE, NE
+ */
+template<typename TVarS, typename TVarD, typename TCompare>
+bool
+SquidLogParser::decision(TVarS&& lhs_, TVarD&& rhs_, TCompare&& cmp_) const
+{
+  switch (cmp_) {
+    case Compare::EQ: {
+      return lhs_ == rhs_;
+    }
+    case Compare::LT: {
+      return lhs_ < rhs_;
+    }
+    case Compare::GT: {
+      return lhs_ > rhs_;
+    }
+    case Compare::LE: {
+      return lhs_ <= rhs_;
+    }
+    case Compare::GE: {
+      return lhs_ >= rhs_;
+    }
+    case Compare::NE: {
+      return lhs_ != rhs_;
+    }
+    default: {
+      return false;
+    }
+  }
+};
+
+/*!
+ * \brief Return a error code.
+ * \return
+ */
+SquidLogParser::SLPError
+SquidLogParser::errorNum() const noexcept
+{
+  return slpError_;
+}
+
+/*!
+ * \brief Return the description of the error.
+ * \return std::string
+ */
+std::string
+SquidLogParser::getErrorText() const
+{
+  if (const auto it_(mError.find(slpError_)); it_ != mError.end()) {
+    return it_->second.data();
+  }
+  return mError.at(SLPError::SLP_ERR_UNKNOWN).data();
+}
+
+/* private------------------------------------------------------------------
+ */
+
+/*!
+ * \internal
+ *
+ * \note The constants below are defined in CMakeLists.txt
+ *
+ * DEBUG_PARSER_SQUID
+ * DEBUG_PARSER_COMMON
+ * DEBUG_PARSER_COMBINED
+ * DEBUG_PARSER_REFERRER
+ * DEBUG_PARSER_USERAGENT
+ *
+ */
+
+/*!
+ * \internal
+ * \brief SquidLogParser::parserSquid
+ * \return
+ *
+ */
+SquidLogData::SLPError
+SquidLogParser::parserSquid()
+{
+  if (parserMode_ == ParserMode::Tokenizer) {
+    return scanT<LogFormat::Squid>(ds_squid_);
+  }
+
+  if (rawLog_.empty()) {
+    setError(SLPError::SLP_SUCCESS);
+    return SLPError::SLP_SUCCESS;
+  }
+
+#ifdef DEBUG_PARSER_SQUID
+  std::cout << "raw : " << rawLog_ << "\n";
+#endif
+
+  try {
+    boost::match_results<std::string::const_iterator> match;
+    boost::regex_match(rawLog_, match, re_id_fmt_squid_);
+    if (match.empty()) {
+      setError(SLPError::SLP_ERR_PARSER_FAILED);
+      return SLPError::SLP_ERR_PARSER_FAILED;
+    }
+    ds_squid_ = {};
+    ds_squid_.timeStamp = std::move(std::stod(match[1]));
+    ds_squid_.responseTime = std::move(std::stoi(match[2]));
+    ds_squid_.cliSrcIpAddr = addrDict_->encode(match[3].str());
+    ds_squid_.reqStatusHierStatus = std::move(match[4]);
+    ds_squid_.totalSizeReply = std::move(std::stoi(match[5]));
+    ds_squid_.reqMethod = std::move(match[6]);
+    ds_squid_.reqURL = std::move(match[7]);
+    ds_squid_.userName = std::move(match[8]);
+    ds_squid_.hierStatusIpAddress = std::move(match[9]);
+    ds_squid_.mimeTypeContent = std::move(match[10]);
+
+    // stores unique http request codes for later score.
+    HttpCodesUniques_m.insert(
+      { std::move(std::stoi(strRight(ds_squid_.reqStatusHierStatus, '/'))),
+        0 });
+
+    // stores unique file extension for later score.
+    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
+      FiletypeUniques_m.insert({ ext_, 0 });
+    }
+
+#ifdef DEBUG_PARSER_SQUID
+    std::cout << "ds_squid :\n";
+    std::cout << ds_squid_.timeStamp << "\n"
+              << ds_squid_.responseTime << "\n"
+              << ds_squid_.cliSrcIpAddr << "\n"
+              << ds_squid_.reqStatusHierStatus << "\n"
+              << ds_squid_.totalSizeReply << "\n"
+              << ds_squid_.reqMethod << "\n"
+              << ds_squid_.reqURL << "\n"
+              << ds_squid_.userName << "\n"
+              << ds_squid_.hierStatusIpAddress << "\n"
+              << ds_squid_.mimeTypeContent << "\n";
+    for (size_t i = 1; i < match.size(); i++) {
+      std::cout << "> " << i << " -- " << match[i] << "\n";
+    }
+#endif
+  } catch (boost::regex_error& e_) {
+    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
+    setError(SLPError::SLP_ERR_PARSER_FAILED);
+    return SLPError::SLP_ERR_PARSER_FAILED;
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \internal
+ * \brief SquidLogParser::parserCommon
+ * \return
+ */
+SquidLogData::SLPError
+SquidLogParser::parserCommon()
+{
+  if (parserMode_ == ParserMode::Tokenizer) {
+    return scanT<LogFormat::Common>(ds_squid_);
+  }
+
+  if (rawLog_.empty()) {
+    setError(SLPError::SLP_SUCCESS);
+    return SLPError::SLP_SUCCESS;
+  }
+
+#ifdef DEBUG_PARSER_COMMON
+  std::cout << "raw : " << rawLog_ << "\n";
+#endif
+
+  try {
+    boost::match_results<std::string::const_iterator> match;
+    boost::regex_match(rawLog_, match, re_id_fmt_common_);
+    if (match.empty()) {
+      setError(SLPError::SLP_ERR_PARSER_FAILED);
+      return SLPError::SLP_ERR_PARSER_FAILED;
+    }
+
+    ds_squid_ = {};
+    ds_squid_.cliSrcIpAddr = addrDict_->encode(match[1].str());
+    ds_squid_.userNameIdent = std::move(match[2]);
+    ds_squid_.userName = std::move(match[3]);
+    ds_squid_.localTime = std::move(match[4]);
+    ds_squid_.timeStamp = dateDecoder_.decode(ds_squid_.localTime);
+    ds_squid_.reqMethod = std::move(match[5]);
+    ds_squid_.reqURL = std::move(match[6]);
+    ds_squid_.reqProtoVersion = std::move(match[7]);
+    ds_squid_.httpStatus = std::move(std::stoi(match[8]));
+    ds_squid_.totalSizeReply = std::move(std::stoi(match[9]));
+    ds_squid_.reqStatusHierStatus = std::move(match[10]);
+
+    // stores unique http request codes for later score.
+    HttpCodesUniques_m.insert({ std::move(std::stoi(match[8])), 0 });
+
+    // stores unique file extension for later score.
+    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
+      FiletypeUniques_m.insert({ ext_, 0 });
+    }
+
+#ifdef DEBUG_PARSER_COMMON
+    std::cout << "ds_common :\n";
+    std::cout << ds_squid_.cliSrcIpAddr << "\n"
+              << ds_squid_.userNameIdent << "\n"
+              << ds_squid_.userName << "\n"
+              << ds_squid_.localTime << "\n"
+              << ds_squid_.reqMethod << "\n"
+              << ds_squid_.reqURL << "\n"
+              << ds_squid_.reqProtoVersion << "\n"
+              << ds_squid_.httpStatus << "\n"
+              << ds_squid_.totalSizeReply << "\n"
+              << ds_squid_.reqStatusHierStatus << "\n";
+
+    for (size_t i = 1; i < match.size(); i++) {
+      std::cout << "> " << i << " -- " << match[i] << "\n";
+    }
+#endif
+  } catch (boost::regex_error& e_) {
+    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
+    setError(SLPError::SLP_ERR_PARSER_FAILED);
+    return SLPError::SLP_ERR_PARSER_FAILED;
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \internal
+ * \brief SquidLogParser::parserCombined
+ * \return
+ */
+SquidLogData::SLPError
+SquidLogParser::parserCombined()
+{
+  if (parserMode_ == ParserMode::Tokenizer) {
+    return scanT<LogFormat::Combined>(ds_squid_);
+  }
+
+  if (rawLog_.empty()) {
+    setError(SLPError::SLP_SUCCESS);
+    return SLPError::SLP_SUCCESS;
+  }
+
+#ifdef DEBUG_PARSER_COMBINED
+  std::cout << "raw combined : " << rawLog_ << "\n";
+#endif
+
+  try {
+    boost::match_results<std::string::const_iterator> match;
+    boost::regex_match(rawLog_, match, re_id_fmt_combined_);
+    if (match.empty()) {
+      setError(SLPError::SLP_ERR_PARSER_FAILED);
+      return SLPError::SLP_ERR_PARSER_FAILED;
+    }
+
+    ds_squid_ = {};
+    ds_squid_.cliSrcIpAddr = addrDict_->encode(match[1].str());
+    ds_squid_.userNameIdent = std::move(match[2]);
+    ds_squid_.userName = std::move(match[3]);
+    ds_squid_.localTime = std::move(match[4]);
+    ds_squid_.timeStamp = dateDecoder_.decode(ds_squid_.localTime);
+    ds_squid_.reqMethod = std::move(match[5]);
+    ds_squid_.reqURL = std::move(match[6]);
+    ds_squid_.reqProtoVersion = std::move(match[7]);
+    ds_squid_.httpStatus = std::move(std::stoi(match[8]));
+    ds_squid_.totalSizeReply = std::move(std::stoi(match[9]));
+    ds_squid_.referrer = std::move(match[10]);
+    ds_squid_.userAgent = std::move(match[11]);
+    ds_squid_.reqStatusHierStatus = std::move(match[12]);
+
+    // stores unique http request codes for later score.
+    HttpCodesUniques_m.insert({ std::move(std::stoi(match[8])), 0 });
+
+    // stores unique file extension for later score.
+    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
+      FiletypeUniques_m.insert({ ext_, 0 });
+    }
+
+#ifdef DEBUG_PARSER_COMBINED
+    std::cout << "ds_combined :\n";
+    std::cout << ds_squid_.cliSrcIpAddr << "\n"
+              << ds_squid_.userNameIdent << "\n"
+              << ds_squid_.userName << "\n"
+              << ds_squid_.localTime << "\n"
+              << ds_squid_.reqMethod << "\n"
+              << ds_squid_.reqURL << "\n"
+              << ds_squid_.reqProtoVersion << "\n"
+              << ds_squid_.httpStatus << "\n"
+              << ds_squid_.totalSizeReply << "\n"
+              << ds_squid_.referrer << "\n"
+              << ds_squid_.userAgent << "\n"
+              << ds_squid_.reqStatusHierStatus << "\n";
+
+    for (size_t i = 1; i < match.size(); i++) {
+      std::cout << "> " << i << " -- " << match[i] << "\n";
+    }
+#endif
+  } catch (boost::regex_error& e_) {
+    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
+    setError(SLPError::SLP_ERR_PARSER_FAILED);
+    return SLPError::SLP_ERR_PARSER_FAILED;
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \internal
+ * \brief SquidLogParser::parserReferrer
+ * \return
+ */
+SquidLogData::SLPError
+SquidLogParser::parserReferrer()
+{
+  if (parserMode_ == ParserMode::Tokenizer) {
+    return scanT<LogFormat::Referrer>(ds_squid_);
+  }
+
+  if (rawLog_.empty()) {
+    setError(SLPError::SLP_SUCCESS);
+    return SLPError::SLP_SUCCESS;
+  }
+
+#ifdef DEBUG_PARSER_REFERRER
+  std::cout << "raw : " << rawLog_ << "\n";
+#endif
+
+  try {
+    boost::match_results<std::string::const_iterator> match;
+    boost::regex_match(rawLog_, match, re_id_fmt_referrer_);
+    if (match.empty()) {
+      setError(SLPError::SLP_ERR_PARSER_FAILED);
+      return SLPError::SLP_ERR_PARSER_FAILED;
+    }
+
+    ds_squid_ = {};
+    ds_squid_.timeStamp = std::move(std::stoul(match[1]));
+    ds_squid_.cliSrcIpAddr = addrDict_->encode(match[2].str());
+    ds_squid_.referrer = std::move(match[3]);
+    ds_squid_.reqURL = std::move(match[4]);
+
+    // stores unique file extension for later score.
+    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
+      FiletypeUniques_m.insert({ ext_, 0 });
+    }
+
+#ifdef DEBUG_PARSER_REFERRER
+    std::cout << "ds_referrer :\n";
+    std::cout << ds_squid_.timeStamp << "\n"
+              << ds_squid_.cliSrcIpAddr << "\n"
+              << ds_squid_.referrer << "\n"
+              << ds_squid_.reqURL << "\n";
+
+    for (size_t i = 1; i <= match.size(); i++) {
+      std::cout << "> " << i << " -- " << match[i] << "\n";
+    }
+#endif
+  } catch (boost::regex_error& e_) {
+    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
+    setError(SLPError::SLP_ERR_PARSER_FAILED);
+    return SLPError::SLP_ERR_PARSER_FAILED;
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \internal
+ * \brief SquidLogParser::parserUserAgent
+ * \return
+ */
+SquidLogData::SLPError
+SquidLogParser::parserUserAgent()
+{
+  if (parserMode_ == ParserMode::Tokenizer) {
+    return scanT<LogFormat::UserAgent>(ds_squid_);
+  }
+
+  if (rawLog_.empty()) {
+    setError(SLPError::SLP_SUCCESS);
+    return SLPError::SLP_SUCCESS;
+  }
+
+#ifdef DEBUG_PARSER_USERAGENT
+  std::cout << "raw : " << rawLog_ << "\n";
+#endif
+
+  try {
+    boost::match_results<std::string::const_iterator> match;
+    boost::regex_match(rawLog_, match, re_id_fmt_useragent_);
+    if (match.empty()) {
+      setError(SLPError::SLP_ERR_PARSER_FAILED);
+      return SLPError::SLP_ERR_PARSER_FAILED;
+    }
+
+    ds_squid_ = {};
+    ds_squid_.cliSrcIpAddr = addrDict_->encode(match[1].str());
+    ds_squid_.localTime = std::move(match[2]);
+    ds_squid_.timeStamp = dateDecoder_.decode(ds_squid_.localTime);
+    ds_squid_.userAgent = std::move(match[3]);
+
+#ifdef DEBUG_PARSER_USERAGENT
+    std::cout << "ds_useragent :\n";
+    std::cout << ds_squid_.cliSrcIpAddr << "\n"
+              << ds_squid_.localTime << " "
+              << ds_squid_.timeStamp << "\n"
+              << ds_squid_.userAgent << "\n";
+
+    for (size_t i = 1; i <= match.size(); i++) {
+      std::cout << "> " << i << " -- " << match[i] << "\n";
+    }
+#endif
+  } catch (boost::regex_error& e_) {
+    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
+    setError(SLPError::SLP_ERR_PARSER_FAILED);
+    return SLPError::SLP_ERR_PARSER_FAILED;
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \internal
+ * \brief Tokenizer counterpart of the parserXXX() functions. Splits line_ in
+ * a single forward pass with SquidLogParserT<F> and fills ds_ in place. A
+ * DataSet_Squid reuses the capacity of its strings; a DataSet_View is only
+ * pointed to the bytes of line_.
+ *
+ * \note Unlike the lazy '(.*?)' groups of the combined regular expression,
+ * escaped quotes inside the User-Agent do not end the field.
+ * \return SLPError
+ */
+template<SquidLogData::LogFormat F, typename TDataSet>
+SquidLogData::SLPError
+SquidLogParser::scanT(TDataSet& ds_)
+{
+  using Parser = SquidLogParserT<F>;
+
+  if (line_.empty()) {
+    setError(SLPError::SLP_SUCCESS);
+    return SLPError::SLP_SUCCESS;
+  }
+
+  try {
+    SLPTokenizer tok_ = lineTokenizer();
+    typename Parser::Record rec_;
+    if (!Parser::parse(tok_, rec_, addrDict_.get())) {
+      setError(SLPError::SLP_ERR_PARSER_FAILED);
+      return SLPError::SLP_ERR_PARSER_FAILED;
+    }
+
+    if constexpr (std::is_same_v<TDataSet, DataSet_Squid>) {
+      clearDataSet();
+    } else {
+      ds_ = {};
+    }
+    Parser::toDataSet(rec_, ds_);
+
+    // without %ts, the time comes from %tl.
+    if constexpr (!Parser::Record::has(Fields::Timestamp) &&
+                  Parser::Record::has(Fields::LocalTime)) {
+      ds_.timeStamp =
+        dateDecoder_.decode(rec_.template get<Fields::LocalTime>());
+    }
+
+    // stores unique http request codes for later score.
+    if constexpr (Parser::hasHttpCode) {
+      HttpCodesUniques_m.insert({ Parser::httpCode(rec_), 0 });
+    }
+
+    // stores unique file extension for later score.
+    if constexpr (Parser::Record::has(Fields::ReqURL)) {
+      if (const std::string_view ext_ =
+            getFiletypeView(rec_.template get<Fields::ReqURL>());
+          !ext_.empty()) {
+        FiletypeUniques_m.insert({ std::string(ext_), 0 });
+      }
+    }
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \internal
+ * \brief append() for StorageMode::Arena and StorageMode::Columnar.
+ *
+ * Arena: copies line_ to the arena, parses the copy and stores an entry that
+ * points into it. Columnar: parses line_ and copies the fields to the
+ * columns; ds_view_ then points into the columns.
+ * \return false if the line was rejected by the parser.
+ */
+template<SquidLogData::LogFormat F>
+bool
+SquidLogParser::appendView()
+{
+  if (storageMode_ == StorageMode::Columnar) {
+    if (scanT<F>(ds_view_) != SLPError::SLP_SUCCESS) {
+      return false;
+    }
+    unshared(columns_).append(ds_view_);
+    ds_view_ = columns_->row(columns_->size() - 1);
+    if (memoryBudget_ != 0 &&
+        columns_->size() % SLPColumnStore::segmentRows == 0) {
+      enforceBudget();
+    }
+    return true;
+  }
+
+  line_ = arena_->store(line_);
+  if (scanT<F>(ds_view_) != SLPError::SLP_SUCCESS) {
+    arena_->release(line_);
+    return false;
+  }
+
+  Views& views_ = unshared(mView);
+  views_.emplace_hint(views_.end(),
+                      DataKey(ds_view_.timeStamp, ds_view_.cliSrcIpAddr),
+                      ds_view_);
+  if (memoryBudget_ != 0) {
+    enforceBudget();
+  }
+  return true;
+}
+
+/*!
+ * \internal
+ * \brief True if the entries are stored by appendView(): StorageMode::Arena
+ * or StorageMode::Columnar, the tokenizer and one of the built-in formats.
+ */
+bool
+SquidLogParser::usesViews() const
+{
+  return storageMode_ != StorageMode::Copy &&
+         parserMode_ == ParserMode::Tokenizer &&
+         logFmt_ != LogFormat::Custom && logFmt_ != LogFormat::Unknown;
+}
+
+/*!
+ * \internal
+ * \brief Readies the columns for a query: sorts them by timestamp, if they
+ * are not yet, and builds the address index if setAddrIndex() asked for it.
+ * After a sort ds_view_ is moved to the new place of the last row appended,
+ * the last one of its timestamp since the sort is stable.
+ */
+void
+SquidLogParser::prepareColumns()
+{
+  if (!columns_->isSorted()) {
+    const uint32_t last_ = columns_->timeStamps().back();
+    columns_ = columns_->sorted();
+    ds_view_ = columns_->row(columns_->upperBound(last_) - 1);
+  }
+  if (addrIndex_ && !columns_->hasAddrIndex()) {
+    columns_->buildAddrIndex();
+  }
+}
+
+/*!
+ * \internal
+ * \brief Returns the store of p_, copied first if an SLPQuery shares it, so
+ * that the query keeps seeing it as it was.
+ */
+template<typename T>
+T&
+SquidLogParser::unshared(std::shared_ptr<T>& p_)
+{
+  if (p_.use_count() > 1) {
+    p_ = std::make_shared<T>(*p_);
+  }
+  return *p_;
+}
+
+/*!
+ * \internal
+ * \brief Bytes compared to the memory budget. The columns count the bytes in
+ * use, not the room reserved.
+ */
+size_t
+SquidLogParser::budgetBytes() const
+{
+  return entryBytes_ + mView->size() * viewBytes_ + arena_->capacity() +
+         (columns_->size() > 0 ? columns_->usedBytes() : 0);
+}
+
+/*!
+ * \internal
+ * \brief Evicts the oldest entries if budgetBytes() is over the budget, down
+ * to budget - budget / evictionSlack_, so that the next lines do not evict
+ * again. Each entry is written to the spill file first, if there is one.
+ */
+void
+SquidLogParser::enforceBudget()
+{
+  const size_t before_ = budgetBytes();
+  if (memoryBudget_ == 0 || before_ <= memoryBudget_) {
+    return;
+  }
+  const size_t low_ = memoryBudget_ - memoryBudget_ / evictionSlack_;
+  size_t used_ = before_;
+  size_t evicted_ = 0;
+
+  // StorageMode::Copy: one entry at a time.
+  while (used_ > low_ && !mEntry->empty() && mEntry.use_count() == 1) {
+    const auto it_ = mEntry->begin();
+    spillEntry(it_->second);
+    const size_t bytes_ = std::min(entryBytes_, entryBytes(it_->second));
+    entryBytes_ -= bytes_;
+    used_ -= std::min(used_, bytes_);
+    mEntry->erase(it_);
+    ++evicted_;
+  }
+
+  // StorageMode::Arena: as many entries as the average line gives, then the
+  // chunks left without lines.
+  if (used_ > low_ && !mView->empty() && mView.use_count() == 1 &&
+      arena_.use_count() == 1) {
+    Views& views_ = *mView;
+    const size_t entry_ = viewBytes_ + arena_->bytes() / views_.size();
+    size_t n_ = std::min(views_.size(), (used_ - low_ + entry_ - 1) / entry_);
+    evicted_ += n_;
+    for (; n_ > 0; --n_) {
+      spillEntry(views_.begin()->second);
+      views_.erase(views_.begin());
+    }
+    // Every field of an entry is in the same line.
+    std::vector<const char*> live_;
+    live_.reserve(views_.size());
+    for (const auto& it_ : views_) {
+      live_.push_back(!it_.second.reqURL.empty() ? it_.second.reqURL.data()
+                                                 : it_.second.localTime.data());
+    }
+    arena_->releaseUnused(std::move(live_));
+    used_ = budgetBytes();
+  }
+
+  // StorageMode::Columnar: whole segments.
+  if (used_ > low_ && columns_->size() > 0) {
+    constexpr size_t seg_ = SLPColumnStore::segmentRows;
+    unshared(columns_);
+    const size_t rows_ = columns_->size();
+    const size_t row_ = std::max<size_t>(1, columns_->usedBytes() / rows_);
+    const size_t want_ = (used_ - low_ + row_ - 1) / row_;
+    const size_t n_ = std::min(rows_, (want_ + seg_ - 1) / seg_ * seg_);
+    for (size_t r_ = 0; spill_ && r_ < n_; ++r_) {
+      spillEntry(columns_->row(r_));
+    }
+    columns_->evictFront(n_);
+    evicted_ += n_;
+    ds_view_ =
+      n_ < rows_ ? columns_->row(columns_->size() - 1) : DataSet_View();
+  }
+
+  if (spill_) {
+    spill_->flush();
+  }
+  if (evicted_ > 0) {
+    const size_t after_ = budgetBytes();
+    ++evictions_.Evictions;
+    evictions_.Entries += evicted_;
+    evictions_.Bytes += before_ > after_ ? before_ - after_ : 0;
+  }
+}
+
+/*!
+ * \internal
+ * \brief Appends an entry evicted to the spill file, as a line of the log
+ * format. Does nothing without a spill file or in LogFormat::Custom.
+ */
+template<typename TDataSet>
+void
+SquidLogParser::spillEntry(const TDataSet& ds_)
+{
+  if (!spill_) {
+    return;
+  }
+  const SLPAddrDict* dict_ = addrDict_.get();
+  switch (logFmt_) {
+    case LogFormat::Squid: {
+      SquidLogParserT<LogFormat::Squid>::toLine(ds_, dict_, spillLine_);
+      break;
+    }
+    case LogFormat::Common: {
+      SquidLogParserT<LogFormat::Common>::toLine(ds_, dict_, spillLine_);
+      break;
+    }
+    case LogFormat::Combined: {
+      SquidLogParserT<LogFormat::Combined>::toLine(ds_, dict_, spillLine_);
+      break;
+    }
+    case LogFormat::Referrer: {
+      SquidLogParserT<LogFormat::Referrer>::toLine(ds_, dict_, spillLine_);
+      break;
+    }
+    case LogFormat::UserAgent: {
+      SquidLogParserT<LogFormat::UserAgent>::toLine(ds_, dict_, spillLine_);
+      break;
+    }
+    default: {
+      return;
+    }
+  }
+  *spill_ << spillLine_ << '\n';
+  ++evictions_.Spilled;
+}
+
+/*!
+ * \internal
+ * \brief Estimate of the bytes of an entry of mEntry: its node and the text
+ * that does not fit in the strings themselves.
+ */
+size_t
+SquidLogParser::entryBytes(const DataSet_Squid& ds_)
+{
+  static constexpr std::array<std::string DataSet_Squid::*, 12> text_ = {
+    &DataSet_Squid::localTime,           &DataSet_Squid::userName,
+    &DataSet_Squid::userNameIdent,       &DataSet_Squid::reqMethod,
+    &DataSet_Squid::reqURL,              &DataSet_Squid::reqProtoVersion,
+    &DataSet_Squid::reqStatusHierStatus, &DataSet_Squid::hierStatusIpAddress,
+    &DataSet_Squid::mimeTypeContent,     &DataSet_Squid::origRcvReqHeader,
+    &DataSet_Squid::referrer,            &DataSet_Squid::userAgent
+  };
+  auto heap_ = [](const std::string& s_) {
+    return s_.capacity() > std::string().capacity() ? s_.capacity() + 1 : 0;
+  };
+
+  size_t n_ = sizeof(std::pair<const DataKey, DataSet_Squid>) +
+              4 * sizeof(void*) +
+              ds_.customFields.capacity() * sizeof(std::string);
+  for (std::string DataSet_Squid::*m_ : text_) {
+    n_ += heap_(ds_.*m_);
+  }
+  for (const std::string& c_ : ds_.customFields) {
+    n_ += heap_(c_);
+  }
+  return n_;
+}
+
+/*!
+ * \internal
+ * \brief Runs the program compiled by SLPLogFormat over line_.
+ * \return SLPError
+ */
+SquidLogData::SLPError
+SquidLogParser::scanCustom()
+{
+  if (!logFormat_ || !logFormat_->isValid()) {
+    setError(SLPError::SLP_ERR_INVALID_LOGFORMAT);
+    return SLPError::SLP_ERR_INVALID_LOGFORMAT;
+  }
+
+  if (line_.empty()) {
+    setError(SLPError::SLP_SUCCESS);
+    return SLPError::SLP_SUCCESS;
+  }
+
+  try {
+    clearDataSet();
+    if (!logFormat_->parse(line_, ds_squid_, addrDict_.get())) {
+      setError(SLPError::SLP_ERR_PARSER_FAILED);
+      return SLPError::SLP_ERR_PARSER_FAILED;
+    }
+
+    // without %ts, the time comes from %tl as in the common format.
+    if (!logFormat_->hasField(Fields::Timestamp)) {
+      ds_squid_.timeStamp = dateDecoder_.decode(ds_squid_.localTime);
+    }
+
+    if (logFormat_->hasField(Fields::HttpStatus)) {
+      HttpCodesUniques_m.insert(
+        { static_cast<short>(ds_squid_.httpStatus), 0 });
+    }
+    if (const std::string_view ext_ = getFiletypeView(ds_squid_.reqURL);
+        !ext_.empty()) {
+      FiletypeUniques_m.insert({ std::string(ext_), 0 });
+    }
+  } catch (const std::exception& e_) {
+    printException(e_, __FUNCTION__, __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  setError(SLPError::SLP_SUCCESS);
+  return SLPError::SLP_SUCCESS;
+}
+
+/*!
+ * \internal
+ * \brief Indexes the delimiters of line_ and returns a tokenizer that walks
+ * them.
+ */
+SLPTokenizer
+SquidLogParser::lineTokenizer()
+{
+  delimIndex_.build(line_.data(), line_.size());
+  return SLPTokenizer(
+    line_, line_.data(), delimIndex_.begin(), delimIndex_.end());
+}
+
+/*!
+ * \internal
+ * \brief Resets ds_squid_ without giving back the memory already reserved by
+ * its strings. Used by the tokenizer, which reuses ds_squid_ for every line.
+ */
+void
+SquidLogParser::clearDataSet()
+{
+  ds_squid_.timeStamp = 0;
+  ds_squid_.cliSrcIpAddr = 0;
+  ds_squid_.localTime.clear();
+  ds_squid_.userName.clear();
+  ds_squid_.userNameIdent.clear();
+  ds_squid_.responseTime = 0;
+  ds_squid_.reqMethod.clear();
+  ds_squid_.reqURL.clear();
+  ds_squid_.reqProtoVersion.clear();
+  ds_squid_.httpStatus = 0;
+  ds_squid_.reqStatusHierStatus.clear();
+  ds_squid_.totalSizeReply = 0;
+  ds_squid_.hierStatusIpAddress.clear();
+  ds_squid_.mimeTypeContent.clear();
+  ds_squid_.origRcvReqHeader.clear();
+  ds_squid_.referrer.clear();
+  ds_squid_.userAgent.clear();
+  for (std::string& c_ : ds_squid_.customFields) {
+    c_.clear();
+  }
+}
+
+/*!
+ * \internal
+ * \brief Normalize a string removing the extra white spaces between words.
+ * \param input_
+ * \param output_
+ * \note The first white space of each run is kept, as std::unique_copy()
+ * would do, but the runs are located through the SLPDelimIndex.
+ */
+void
+SquidLogParser::removeExtraWhiteSpaces(std::string_view input_,
+                                       std::string& output_)
+{
+  output_.clear(); // unless you want to add at the end of existing string...
+  delimIndex_.build(input_.data(), input_.size());
+
+  // The white spaces are the only delimiters below '!', and two of them are
+  // adjacent when their offsets are consecutive in the index.
+  auto isBlank_ = [&input_](uint32_t at_) {
+    return static_cast<unsigned char>(input_[at_]) <= ' ';
+  };
+  size_t from_ = 0;
+  const uint32_t* prev_ = nullptr;
+  for (const uint32_t* d_ = delimIndex_.begin(); d_ != delimIndex_.end();
+       ++d_) {
+    if (prev_ != nullptr && *prev_ + 1 == *d_ && isBlank_(*prev_) &&
+        isBlank_(*d_)) {
+      output_.append(input_, from_, *d_ - from_);
+      from_ = *d_ + 1;
+    }
+    prev_ = d_;
+  }
+  output_.append(input_, from_, std::string::npos);
+}
+
+/*!
+ * \internal
+ * \brief SLPDatabase::signalHandler
+ * \param signum_
+ */
+void
+SquidLogParser::signalHandler(const int signum_)
+{
+  std::cout << "\n\nSquidLogParser Library Interrupt signal [ "
+            << (signum_ == 2 ? "Control-C" : std::to_string(signum_))
+            << " ] received.\n\n";
+  exit(signum_);
+}
+
+/*!
+ * \internal
+ * \brief Prints formatted exception messages.
+ * \param e_
+ * \param fname_
+ * \param line_
+ */
+void
+SquidLogParser::printException(const std::exception& e_,
+                               const char* fname_,
+                               const int line_)
+{
+  std::cout << "\nSquidLogParser Caught an exception at " << fname_
+            << "::" << line_ << " " << e_.what() << '\n';
+}
+
+/* SLPExpr ---------------------------------------------------------------- */
+/*!
+ * \internal
+ * \brief Constructs a node of the given kind, without terms.
+ */
+SLPExpr::SLPExpr(Kind kind_)
+  : kind_(kind_)
+  , fld_(Fields::Timestamp)
+  , cmp_(Compare::EQ)
+{
+}
+
+/*!
+ * \brief "fld_ cmp_ t_", compared as SLPQuery::field() does.
+ * \param fld_ enum Fields.
+ * \param cmp_ enum Compare.
+ * \param t_ Value to compare.
+ * \return SLPExpr
+ */
+SLPExpr
+SLPExpr::field(Fields fld_, Compare cmp_, var_t t_)
+{
+  SLPExpr e_(Kind::Field);
+  e_.fld_ = fld_;
+  e_.cmp_ = cmp_;
+  e_.values_.push_back(std::move(t_));
+  return e_;
+}
+
+/*!
+ * \brief "fld_ IN (list_)": the field is equal to one of the values, which
+ * must all be of the same type.
+ * \param fld_ enum Fields.
+ * \param list_ Values.
+ * \return SLPExpr
+ */
+SLPExpr
+SLPExpr::in(Fields fld_, std::vector<var_t> list_)
+{
+  SLPExpr e_(Kind::In);
+  e_.fld_ = fld_;
+  e_.values_ = std::move(list_);
+  return e_;
+}
+
+/*!
+ * \brief The timestamp is within [d0_, d1_].
+ * \param d0_ Begin date. Format: dd/Mmm/yyyy:hh:mm:ss
+ * \param d1_ End date. Format: dd/Mmm/yyyy:hh:mm:ss
+ * \return SLPExpr
+ */
+SLPExpr
+SLPExpr::time(const std::string& d0_, const std::string& d1_)
+{
+  SLPExpr e_(Kind::Time);
+  e_.lo_ = d0_;
+  e_.hi_ = d1_;
+  return e_;
+}
+
+/*!
+ * \brief The client address is within [ip0_, ip1_], as in
+ * SLPQuery::select(). Without ip1_, ip0_ is an address or a CIDR block.
+ * \param ip0_ Begin IP address or CIDR block.
+ * \param ip1_ End IP address or CIDR block.
+ * \return SLPExpr
+ */
+SLPExpr
+SLPExpr::addr(const std::string& ip0_, const std::string& ip1_)
+{
+  SLPExpr e_(Kind::Addr);
+  e_.lo_ = ip0_;
+  e_.hi_ = ip1_.empty() ? ip0_ : ip1_;
+  return e_;
+}
+
+/*!
+ * \brief AND of terms_. Without terms it accepts every entry.
+ * \param terms_ Conditions.
+ * \return SLPExpr
+ */
+SLPExpr
+SLPExpr::allOf(std::vector<SLPExpr> terms_)
+{
+  SLPExpr e_(Kind::And);
+  e_.terms_ = std::move(terms_);
+  return e_;
+}
+
+/*!
+ * \brief OR of terms_. Without terms it accepts no entry.
+ * \param terms_ Conditions.
+ * \return SLPExpr
+ */
+SLPExpr
+SLPExpr::anyOf(std::vector<SLPExpr> terms_)
+{
+  SLPExpr e_(Kind::Or);
+  e_.terms_ = std::move(terms_);
+  return e_;
+}
+
+/*!
+ * \brief NOT term_.
+ * \param term_ Condition.
+ * \return SLPExpr
+ */
+SLPExpr
+SLPExpr::negate(SLPExpr term_)
+{
+  SLPExpr e_(Kind::Not);
+  e_.terms_.push_back(std::move(term_));
+  return e_;
+}
+
+/*!
+ * \internal
+ * \brief a_ kind_ b_, where kind_ is And or Or. The terms of a_ and b_ that
+ * are of the same kind are added instead of nesting them, so that where()
+ * can order all of them.
+ */
+SLPExpr
+SLPExpr::join(Kind kind_, SLPExpr a_, SLPExpr b_)
+{
+  SLPExpr e_(kind_);
+  if (a_.kind_ == kind_) {
+    e_.terms_ = std::move(a_.terms_);
+  } else {
+    e_.terms_.push_back(std::move(a_));
+  }
+  if (b_.kind_ == kind_) {
+    std::move(
+      b_.terms_.begin(), b_.terms_.end(), std::back_inserter(e_.terms_));
+  } else {
+    e_.terms_.push_back(std::move(b_));
+  }
+  return e_;
+}
+
+/*!
+ * \brief a_ AND b_.
+ */
+SLPExpr
+operator&&(SLPExpr a_, SLPExpr b_)
+{
+  return SLPExpr::join(SLPExpr::Kind::And, std::move(a_), std::move(b_));
+}
+
+/*!
+ * \brief a_ OR b_.
+ */
+SLPExpr
+operator||(SLPExpr a_, SLPExpr b_)
+{
+  return SLPExpr::join(SLPExpr::Kind::Or, std::move(a_), std::move(b_));
+}
+
+/*!
+ * \brief NOT a_.
+ */
+SLPExpr
+operator!(SLPExpr a_)
+{
+  return SLPExpr::negate(std::move(a_));
+}
+
+/* SLPQuery --------------------------------------------------------------- */
+/*!
+ * \brief Constructs a SLPQuery object.
+ * \param pf_ Object pointer
+ */
+SLPQuery::SLPQuery(SquidLogParser* obj_)
+  : SquidLogParser(*obj_)
+  , entryRows_({})
+  , viewRows_({})
+  , logFmt_(getFormat())
+  , slpError_(SLPError::SLP_SUCCESS)
+  , threads_(0)
+  , info_t({})
+{
+  // The stores of obj_ are shared, not copied: the entries, the lines of
+  // StorageMode::Arena and the columns, once sorted.
+  obj_->prepareColumns();
+  columns_ = obj_->columns_;
+}
+
+/*!
+ * \brief Selects the records given the following arguments: Being date, begin
+ * IP, end date and end IP.
+ * \param d0_  Begin date. Format: dd/Mmm/yyyy:hh:mm:ss
+ * \param ip0_ Being IP address.
+ * \param d1_  End date. Format: dd/Mmm/yyyy:hh:mm:ss
+ * \param ip1_ Ende IP address.
+ * \return *this
+ */
+SLPQuery&
+SLPQuery::select(const std::string&& d0_,
+                 const std::string&& ip0_,
+                 const std::string&& d1_,
+                 const std::string&& ip1_)
+{
+  info_t = {};
+  if ((!d0_.empty() && !ip0_.empty()) && (d1_.empty() && ip1_.empty())) { // a,b
+    info_t.begin_date_ = unixTimestamp(d0_);
+    if (info_t.begin_date_ > 0 &&
+        SLPAddrDict::range(ip0_, ip0_, info_t.ip_)) {
+      info_t.end_date_ = info_t.begin_date_;
+      setError(SLPError::SLP_SUCCESS);
+      info_t.flag_ = true;
+    } else {
+      setError(SLPError::SLP_ERR_INVALID_TS_OR_IP);
+      info_t.flag_ = false;
+    }
+  } else if ((!d0_.empty() && !ip0_.empty()) &&
+             (!d1_.empty() && !ip1_.empty())) { // a,b,c,d
+    info_t.begin_date_ = unixTimestamp(d0_);
+    info_t.end_date_ = unixTimestamp(d1_);
+    if ((info_t.begin_date_ > 0 && info_t.end_date_ > 0) &&
+        SLPAddrDict::range(ip0_, ip1_, info_t.ip_)) {
+      setError(SLPError::SLP_SUCCESS);
+      info_t.flag_ = true;
+    } else {
+      setError(SLPError::SLP_ERR_INVALID_TS_OR_IP);
+      info_t.flag_ = false;
+    }
+  } else {
+    setError(SLPError::SLP_ERR_INCOMPLETE_NUM_ARGS);
+    info_t.flag_ = false;
+  }
+
+  return *this;
+}
+
+/*!
+ * \brief Tells the select() function which field should be used as a
+ * conditional key for searching.
+ * \param fld_ enum Fields.
+ * \param cmp_ enum Compare.
+ * \param t_ Value to compare.
+ */
+void
+SLPQuery::field(Fields fld_, Compare cmp_, Visitor::var_t&& t_)
+{
+  if (info_t.flag_) {
+    // Compiled once: an invalid regex selects nothing.
+    const Predicate pred_(*this, fld_, cmp_, t_);
+    if (!pred_.isValid()) {
+      return;
+    }
+
+    const SLPAddrDict::Range ip_ = info_t.ip_;
+    auto match_ = [this, &ip_, &pred_](const auto& it_) {
+      return addrDict_->contains(ip_, it_.first.getIp()) && pred_(it_.second);
+    };
+
+    // Only the addresses of the entries selected are kept.
+    selectRows(entryRows_, *mEntry, match_);
+    selectRows(viewRows_, *mView, match_);
+
+    fieldColumns(fld_, cmp_, t_, pred_.regex());
+  }
+}
+
+/*!
+ * \brief Selects the entries of the range of select() that satisfy expr_.
+ * The expression is compiled once and evaluated in a single pass over the
+ * entries; the terms of each AND and OR are ordered by their selectivity,
+ * estimated on a sample of the entries, so that the test of an entry stops
+ * as soon as its result is known. As with field(), the entries selected are
+ * added to those of the previous calls.
+ * \param expr_ Condition.
+ */
+void
+SLPQuery::where(const SLPExpr& expr_)
+{
+  if (!info_t.flag_) {
+    return;
+  }
+  Condition cond_;
+  if (!compile(expr_, cond_)) {
+    return;
+  }
+
+  // The entries sampled in each store.
+  std::vector<const DataSet_Squid*> squid_;
+  std::vector<const DataSet_View*> views_;
+  std::vector<uint32_t> sampled_;
+  sample(*mEntry, squid_);
+  sample(*mView, views_);
+  const SLPColumnStore& cols_ = *columns_;
+  const size_t begin_ = cols_.lowerBound(info_t.begin_date_);
+  const size_t end_ = cols_.upperBound(info_t.end_date_);
+  const size_t step_ = std::max<size_t>(1, (end_ - begin_) / sampleRows_);
+  for (size_t r_ = begin_; r_ < end_ && sampled_.size() < sampleRows_;
+       r_ += step_) {
+    sampled_.push_back(static_cast<uint32_t>(r_));
+  }
+  const size_t total_ = squid_.size() + views_.size() + sampled_.size();
+  cond_.order([&](const Condition& c_) {
+    size_t n_ = 0;
+    for (const DataSet_Squid* d_ : squid_) {
+      n_ += c_(*d_);
+    }
+    for (const DataSet_View* d_ : views_) {
+      n_ += c_(*d_);
+    }
+    for (const uint32_t r_ : sampled_) {
+      n_ += c_(size_t(r_));
+    }
+    return total_ == 0 ? 1.0 : double(n_) / double(total_);
+  });
+
+  const SLPAddrDict::Range ip_ = info_t.ip_;
+  auto match_ = [this, &ip_, &cond_](const auto& it_) {
+    return addrDict_->contains(ip_, it_.first.getIp()) && cond_(it_.second);
+  };
+  selectRows(entryRows_, *mEntry, match_);
+  selectRows(viewRows_, *mView, match_);
+  whereColumns(cond_);
+}
+
+/*!
+ * \brief Sets the number of threads of SLPThreadPool::shared() that scan
+ * the entries in field() and where() and count them in the sum*() and
+ * countBy*() functions. The entries are cut in parts, each one scanned by
+ * one thread, and the partial results are merged in order: the results are
+ * the same whatever the number of threads. Small selections are scanned by
+ * the calling thread only.
+ * \param n_ Number of threads, at most one per hardware thread; 0 uses all
+ * of them (the default) and 1 only the calling thread.
+ */
+void
+SLPQuery::setThreads(unsigned n_)
+{
+  threads_ = n_;
+}
+
+/*!
+ * \brief Returns the number of threads given to setThreads(), or 0.
+ */
+unsigned
+SLPQuery::threads() const
+{
+  return threads_;
+}
+
+/*!
+ * \internal
+ * \brief Compiles e_ to c_. An invalid date, address, regex or IN list sets
+ * the error and returns false.
+ * \param e_ Expression.
+ * \param c_ Compiled condition.
+ * \return bool
+ */
+bool
+SLPQuery::compile(const SLPExpr& e_, Condition& c_)
+{
+  using Kind = SLPExpr::Kind;
+
+  c_.kind_ = e_.kind_;
+  c_.query_ = this;
+  switch (e_.kind_) {
+    case Kind::Field:
+    case Kind::In: {
+      c_.pred_ =
+        e_.kind_ == Kind::Field
+          ? std::make_unique<Predicate>(*this, e_.fld_, e_.cmp_, e_.values_[0])
+          : std::make_unique<Predicate>(*this, e_.fld_, e_.values_);
+      if (!c_.pred_->isValid()) {
+        setError(SLPError::SLP_ERR_INVALID_EXPR);
+        return false;
+      }
+      c_.pred_->resolveRows();
+      return true;
+    }
+    case Kind::Time: {
+      c_.min_ = unixTimestamp(e_.lo_);
+      c_.max_ = unixTimestamp(e_.hi_);
+      if (c_.min_ == 0 || c_.max_ == 0) {
+        setError(SLPError::SLP_ERR_INVALID_TS_OR_IP);
+        return false;
+      }
+      return true;
+    }
+    case Kind::Addr: {
+      if (!SLPAddrDict::range(e_.lo_, e_.hi_, c_.ip_)) {
+        setError(SLPError::SLP_ERR_INVALID_TS_OR_IP);
+        return false;
+      }
+      return true;
+    }
+    case Kind::And:
+    case Kind::Or:
+    case Kind::Not: {
+      c_.terms_.resize(e_.terms_.size());
+      for (size_t i_ = 0; i_ < e_.terms_.size(); ++i_) {
+        if (!compile(e_.terms_[i_], c_.terms_[i_])) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+/*!
+ * \internal
+ * \brief Tests an entry of mEntry or mView.
+ * \param d_ Entry.
+ * \return bool
+ */
+template<typename TDataSet>
+bool
+SLPQuery::Condition::operator()(const TDataSet& d_) const
+{
+  switch (kind_) {
+    case SLPExpr::Kind::Field:
+    case SLPExpr::Kind::In: {
+      return (*pred_)(d_);
+    }
+    case SLPExpr::Kind::Time: {
+      return d_.timeStamp >= min_ && d_.timeStamp <= max_;
     }
-    case boost::regex_constants::error_escape: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_ESCAPE);
-      break;
+    case SLPExpr::Kind::Addr: {
+      return query_->addrDict_->contains(ip_, d_.cliSrcIpAddr);
     }
-    case boost::regex_constants::error_backref: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_BACKREF);
-      break;
+    case SLPExpr::Kind::And: {
+      for (const Condition& c_ : terms_) {
+        if (!c_(d_)) {
+          return false;
+        }
+      }
+      return true;
     }
-    case boost::regex_constants::error_brack: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_BRACK);
-      break;
+    case SLPExpr::Kind::Or: {
+      for (const Condition& c_ : terms_) {
+        if (c_(d_)) {
+          return true;
+        }
+      }
+      return false;
     }
-    case boost::regex_constants::error_paren: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_PAREN);
-      break;
+    case SLPExpr::Kind::Not: {
+      return !terms_[0](d_);
     }
-    case boost::regex_constants::error_brace: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_BRACE);
-      break;
+  }
+  return false;
+}
+
+/*!
+ * \internal
+ * \brief Tests a row of columns_.
+ * \param r_ Row.
+ * \return bool
+ */
+bool
+SLPQuery::Condition::operator()(size_t r_) const
+{
+  switch (kind_) {
+    case SLPExpr::Kind::Field:
+    case SLPExpr::Kind::In: {
+      return (*pred_)(r_);
     }
-    case boost::regex_constants::error_badbrace: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_BADBRACE);
-      break;
+    case SLPExpr::Kind::Time: {
+      const uint32_t ts_ = query_->columns_->timeStamps()[r_];
+      return ts_ >= min_ && ts_ <= max_;
     }
-    case boost::regex_constants::error_range: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_RANGE);
-      break;
+    case SLPExpr::Kind::Addr: {
+      return query_->addrDict_->contains(ip_, query_->columns_->addrs()[r_]);
     }
-    case boost::regex_constants::error_space: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_SPACE);
-      break;
+    case SLPExpr::Kind::And: {
+      for (const Condition& c_ : terms_) {
+        if (!c_(r_)) {
+          return false;
+        }
+      }
+      return true;
     }
-    case boost::regex_constants::error_badrepeat: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_BADREPEAT);
+    case SLPExpr::Kind::Or: {
+      for (const Condition& c_ : terms_) {
+        if (c_(r_)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    case SLPExpr::Kind::Not: {
+      return !terms_[0](r_);
+    }
+  }
+  return false;
+}
+
+/*!
+ * \internal
+ * \brief Estimates pass_ and cost_ and orders the terms. rate_(c_) gives the
+ * fraction of the sampled entries that the comparisons accept; AND, OR and
+ * NOT combine the fractions of their terms as if they were independent.
+ * The terms of an AND are ordered by cost_ / (1 - pass_), those of an OR by
+ * cost_ / pass_, which minimizes the expected cost of the test.
+ * \param rate_ Function of the sample.
+ */
+template<typename TRate>
+void
+SLPQuery::Condition::order(TRate&& rate_)
+{
+  constexpr double epsilon_ = 1e-6;
+
+  switch (kind_) {
+    case SLPExpr::Kind::Field:
+    case SLPExpr::Kind::In:
+    case SLPExpr::Kind::Time:
+    case SLPExpr::Kind::Addr: {
+      pass_ = rate_(*this);
+      cost_ = pred_ ? pred_->cost() : 1.0;
       break;
     }
-    case boost::regex_constants::error_complexity: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_COMPLEXITY);
+    case SLPExpr::Kind::Not: {
+      terms_[0].order(rate_);
+      pass_ = 1.0 - terms_[0].pass_;
+      cost_ = terms_[0].cost_;
       break;
     }
-    case boost::regex_constants::error_stack: {
-      const_cast<SquidLogParser*>(this)->setError(
-        SLPError::SLP_ERR_REGEX_STACK);
+    case SLPExpr::Kind::And:
+    case SLPExpr::Kind::Or: {
+      const bool and_ = kind_ == SLPExpr::Kind::And;
+      for (Condition& c_ : terms_) {
+        c_.order(rate_);
+      }
+      std::stable_sort(
+        terms_.begin(),
+        terms_.end(),
+        [and_, epsilon_](const Condition& a_, const Condition& b_) {
+          const double pa_ = and_ ? 1.0 - a_.pass_ : a_.pass_;
+          const double pb_ = and_ ? 1.0 - b_.pass_ : b_.pass_;
+          return a_.cost_ / (pa_ + epsilon_) < b_.cost_ / (pb_ + epsilon_);
+        });
+      // Expected cost: each term is tested while the result is not known.
+      double go_ = 1.0;
+      cost_ = 0.0;
+      for (const Condition& c_ : terms_) {
+        cost_ += go_ * c_.cost_;
+        go_ *= and_ ? c_.pass_ : 1.0 - c_.pass_;
+      }
+      pass_ = and_ ? go_ : 1.0 - go_;
       break;
     }
-    default: {
-      const_cast<SquidLogParser*>(this)->setError(SLPError::SLP_ERR_UNKNOWN);
+  }
+}
+
+/*!
+ * \internal
+ * \brief Appends to out_ the first sampleRows_ entries of store_ in the
+ * range of select().
+ */
+template<typename TStore>
+void
+SLPQuery::sample(const TStore& store_,
+                 std::vector<const typename TStore::mapped_type*>& out_) const
+{
+  auto [it_, end_] = timeRange(store_, info_t.begin_date_, info_t.end_date_);
+  for (; it_ != end_ && out_.size() < sampleRows_; ++it_) {
+    if (addrDict_->contains(info_t.ip_, it_->first.getIp())) {
+      out_.push_back(&it_->second);
     }
   }
-  return getErrorText();
 }
 
 /*!
  * \internal
- * \brief Returns the value of integer fields
- * \param f_ Field Id
- * \param d_ Data
- * \return int
+ * \brief where() for StorageMode::Columnar: appends to rows_ the rows of the
+ * range of select() that c_ accepts, found by binary search. The segments
+ * whose zone map excludes the addresses are skipped.
  */
-constexpr int
-SquidLogParser::intFields(Fields f_, const DataSet_Squid& d_) const
+void
+SLPQuery::whereColumns(const Condition& c_)
 {
+  const SLPColumnStore& cols_ = *columns_;
+  const std::vector<uint32_t>& addrs_ = cols_.addrs();
+  const size_t before_ = rows_.size();
+  collectRows(
+    cols_.lowerBound(info_t.begin_date_),
+    cols_.upperBound(info_t.end_date_),
+    SLPColumnStore::segmentRows,
+    [&](size_t begin_, size_t end_, std::vector<uint32_t>& out_) {
+      cols_.forSegments(
+        begin_,
+        end_,
+        [&](const SLPColumnStore::Zone& z_, size_t r_, size_t stop_) {
+          if (z_.excludes(info_t.ip_)) {
+            return;
+          }
+          for (; r_ < stop_; ++r_) {
+            if (addrDict_->contains(info_t.ip_, addrs_[r_]) && c_(r_)) {
+              out_.push_back(static_cast<uint32_t>(r_));
+            }
+          }
+        });
+    });
+  mergeRows(before_);
+}
 
-  switch (f_) {
-    case Fields::ResponseTime: {
-      return d_.responseTime;
+/*!
+ * \internal
+ * \brief Compiles "field cmp_ t_". The regex of Compare::REGEX is built
+ * here; if it is invalid the error is printed, as before, and isValid()
+ * returns false.
+ * \param query_ Query whose entries will be tested.
+ * \param fld_ enum Fields.
+ * \param cmp_ enum Compare.
+ * \param t_ Value to compare.
+ */
+SLPQuery::Predicate::Predicate(const SLPQuery& query_,
+                               Fields fld_,
+                               Compare cmp_,
+                               const var_t& t_)
+  : query_(query_)
+  , fld_(fld_)
+  , cmp_(cmp_)
+  , type_(query_.varType(t_))
+  , valid_(true)
+  , in_(false)
+  , int_(0)
+  , uint_(0)
+  , cols_(*query_.columns_)
+  , intCol_(nullptr)
+  , uintCol_(nullptr)
+  , codes_(nullptr)
+  , row_(&rowConstant<false>)
+{
+  switch (type_) {
+    case TypeVar::TInt: {
+      int_ = std::get<int>(t_);
+      break;
     }
-    case Fields::TotalSizeReply: {
-      return d_.totalSizeReply;
+    case TypeVar::TUint: {
+      uint_ = std::get<uint32_t>(t_);
+      break;
     }
-    case Fields::HttpStatus: {
-      return d_.httpStatus;
+    case TypeVar::TString: {
+      str_ = std::get<std::string>(t_);
+      if (cmp_ == Compare::REGEX) {
+        try {
+          re_.assign(str_.c_str());
+        } catch (boost::regex_error& e_) {
+          std::cout << "SLPQuery::fields() regex error: "
+                    << query_.getErrorRE(e_) << '\n';
+          valid_ = false;
+        }
+      }
+      break;
     }
-    default: {
-      return -1;
+    case TypeVar::TLong: {
+      break;
     }
   }
+  compile();
 }
 
 /*!
  * \internal
- * \brief Returns the value of uint32_t fields
- * \param f_ Field Id
- * \param d_ Data
- * \return uint32_t
+ * \brief Compiles "field IN (list_)". The values must all be of the same
+ * type, which is compared as field() would compare one of them; otherwise
+ * isValid() returns false. An empty list accepts nothing.
+ * \param query_ Query whose entries will be tested.
+ * \param fld_ enum Fields.
+ * \param list_ Values.
  */
-constexpr uint32_t
-SquidLogParser::uint32Fields(Fields f_, const DataSet_Squid& d_) const
+SLPQuery::Predicate::Predicate(const SLPQuery& query_,
+                               Fields fld_,
+                               const std::vector<var_t>& list_)
+  : query_(query_)
+  , fld_(fld_)
+  , cmp_(Compare::EQ)
+  , type_(list_.empty() ? TypeVar::TLong : query_.varType(list_.front()))
+  , valid_(true)
+  , in_(true)
+  , int_(0)
+  , uint_(0)
+  , cols_(*query_.columns_)
+  , intCol_(nullptr)
+  , uintCol_(nullptr)
+  , codes_(nullptr)
+  , row_(&rowConstant<false>)
 {
-  switch (f_) {
-    case Fields::Timestamp: {
-      return d_.timeStamp;
-    }
-    case Fields::CliSrcIpAddr: {
-      return d_.cliSrcIpAddr;
+  for (const var_t& v_ : list_) {
+    if (query_.varType(v_) != type_) {
+      valid_ = false;
+      break;
     }
-    default: {
-      return 0;
+    switch (type_) {
+      case TypeVar::TInt: {
+        ints_.push_back(std::get<int>(v_));
+        break;
+      }
+      case TypeVar::TUint: {
+        uints_.push_back(std::get<uint32_t>(v_));
+        break;
+      }
+      case TypeVar::TString: {
+        strs_.push_back(std::get<std::string>(v_));
+        break;
+      }
+      case TypeVar::TLong: {
+        break;
+      }
     }
   }
+  std::sort(ints_.begin(), ints_.end());
+  std::sort(uints_.begin(), uints_.end());
+  std::sort(strs_.begin(), strs_.end());
+  compile();
 }
 
 /*!
  * \internal
- * \brief Returns the value of string fields
- * \param f_ Field Id
- * \param d_ Data
- * \return std::string
+ * \brief Matches the value of the field with the value of field() through
+ * TOp, one of std::equal_to<>, std::less<>, ...
  */
-std::string
-SquidLogParser::strFields(Fields f_, const DataSet_Squid& d_) const
+template<typename TOp>
+struct SLPQuery::Predicate::ByOperator
 {
-  switch (f_) {
+  static bool match(const Predicate& p_, int v_) { return TOp()(v_, p_.int_); }
+  static bool match(const Predicate& p_, uint32_t v_)
+  {
+    return TOp()(v_, p_.uint_);
+  }
+  static bool match(const Predicate& p_, std::string_view v_)
+  {
+    return TOp()(v_, std::string_view(p_.str_));
+  }
+};
+
+/*!
+ * \internal
+ * \brief Compare::REGEX
+ */
+struct SLPQuery::Predicate::ByRegex
+{
+  static bool match(const Predicate& p_, std::string_view v_)
+  {
+    return boost::regex_search(v_.begin(), v_.end(), p_.re_);
+  }
+};
+
+/*!
+ * \internal
+ * \brief Compare::HOST and Compare::DOMAIN
+ */
+struct SLPQuery::Predicate::ByHost
+{
+  static bool match(const Predicate& p_, std::string_view v_)
+  {
+    return SLPUrlParts::hostMatches(v_, p_.str_, p_.cmp_ == Compare::DOMAIN);
+  }
+};
+
+/*!
+ * \internal
+ * \brief The value of the field is one of the IN list.
+ */
+struct SLPQuery::Predicate::InList
+{
+  static bool match(const Predicate& p_, int v_)
+  {
+    return std::binary_search(p_.ints_.begin(), p_.ints_.end(), v_);
+  }
+  static bool match(const Predicate& p_, uint32_t v_)
+  {
+    return std::binary_search(p_.uints_.begin(), p_.uints_.end(), v_);
+  }
+  static bool match(const Predicate& p_, std::string_view v_)
+  {
+    return std::binary_search(
+      p_.strs_.begin(), p_.strs_.end(), v_, std::less<>());
+  }
+};
+
+/*!
+ * \internal
+ * \brief Resolves the tests of both kinds of entry.
+ */
+void
+SLPQuery::Predicate::compile()
+{
+  resolve(squid_);
+  resolve(view_);
+}
+
+/*!
+ * \internal
+ * \brief Estimated cost of a test, relative to an integer comparison: the
+ * text is compared in place, the regex and the hosts are searched, and
+ * Timestamp and CliSrcIpAddr are formatted first when compared as text.
+ */
+double
+SLPQuery::Predicate::cost() const noexcept
+{
+  if (type_ != TypeVar::TString) {
+    return in_ ? 2.0 : 1.0;
+  }
+  double cost_ = SLPColumnStore::isText(fld_) ? 2.0 : 8.0;
+  if (cmp_ == Compare::REGEX) {
+    cost_ += 8.0;
+  } else if (cmp_ == Compare::HOST || cmp_ == Compare::DOMAIN) {
+    cost_ += 4.0;
+  } else if (in_) {
+    cost_ += 1.0;
+  }
+  return cost_;
+}
+
+/*!
+ * \internal
+ * \brief Resolves the members of the field in TDataSet and the test of the
+ * comparison. A numeric comparison on a field that is not of its type
+ * compares the value intFields() or uint32Fields() give for it (-1 or 0),
+ * so it is resolved to a constant here.
+ * \param a_ Accessors to fill in.
+ */
+template<typename TDataSet>
+void
+SLPQuery::Predicate::resolve(Access<TDataSet>& a_) const
+{
+  switch (fld_) {
     case Fields::Timestamp: {
-      return unixToSquidDate(d_.timeStamp);
+      a_.uint_ = &TDataSet::timeStamp;
+      break;
     }
     case Fields::CliSrcIpAddr: {
-      return IPv4Addr::ltoip(d_.cliSrcIpAddr);
+      a_.uint_ = &TDataSet::cliSrcIpAddr;
+      break;
+    }
+    case Fields::ResponseTime: {
+      a_.int_ = &TDataSet::responseTime;
+      break;
+    }
+    case Fields::TotalSizeReply: {
+      a_.int_ = &TDataSet::totalSizeReply;
+      break;
+    }
+    case Fields::HttpStatus: {
+      a_.int_ = &TDataSet::httpStatus;
+      break;
     }
     case Fields::LocalTime: {
-      return d_.localTime;
+      a_.text_ = &TDataSet::localTime;
+      break;
     }
     case Fields::UserName: {
-      return d_.userName;
+      a_.text_ = &TDataSet::userName;
+      break;
     }
     case Fields::UserNameIdent: {
-      return d_.userNameIdent;
+      a_.text_ = &TDataSet::userNameIdent;
+      break;
     }
     case Fields::ReqMethod: {
-      return d_.reqMethod;
+      a_.text_ = &TDataSet::reqMethod;
+      break;
     }
     case Fields::ReqURL: {
-      return d_.reqURL;
+      a_.text_ = &TDataSet::reqURL;
+      break;
     }
     case Fields::ReqProtoVersion: {
-      return d_.reqProtoVersion;
+      a_.text_ = &TDataSet::reqProtoVersion;
+      break;
+    }
+    case Fields::ReqStatusHierStatus: {
+      a_.text_ = &TDataSet::reqStatusHierStatus;
+      break;
+    }
+    case Fields::HierStatusIpAddress: {
+      a_.text_ = &TDataSet::hierStatusIpAddress;
+      break;
+    }
+    case Fields::MimeContentType: {
+      a_.text_ = &TDataSet::mimeTypeContent;
+      break;
+    }
+    case Fields::OrigRcvReqHeader: {
+      a_.text_ = &TDataSet::origRcvReqHeader;
+      break;
+    }
+    case Fields::Referrer: {
+      a_.text_ = &TDataSet::referrer;
+      break;
+    }
+    case Fields::UserAgent: {
+      a_.text_ = &TDataSet::userAgent;
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+
+  const Test<TDataSet> none_ = &constant<TDataSet, false>;
+  a_.test_ = none_;
+  switch (type_) {
+    case TypeVar::TInt: {
+      if (a_.int_ != nullptr) {
+        a_.test_ = byNumber(
+          [](auto m_) { return &intTest<decltype(m_), TDataSet>; }, none_);
+      } else if (byNumber(
+                   [this](auto m_) { return decltype(m_)::match(*this, -1); },
+                   false)) {
+        a_.test_ = &constant<TDataSet, true>;
+      }
+      break;
     }
-    case Fields::ReqStatusHierStatus: {
-      return d_.reqStatusHierStatus;
+    case TypeVar::TUint: {
+      if (a_.uint_ != nullptr) {
+        a_.test_ = byNumber(
+          [](auto m_) { return &uintTest<decltype(m_), TDataSet>; }, none_);
+      } else if (byNumber(
+                   [this](auto m_) {
+                     return decltype(m_)::match(*this, uint32_t(0));
+                   },
+                   false)) {
+        a_.test_ = &constant<TDataSet, true>;
+      }
+      break;
     }
-    case Fields::HierStatusIpAddress: {
-      return d_.hierStatusIpAddress;
+    case TypeVar::TString: {
+      // Timestamp, CliSrcIpAddr and the integer fields as strFields() gives
+      // them.
+      if (a_.text_ != nullptr) {
+        a_.test_ = byText(
+          [](auto m_) { return &textTest<decltype(m_), TDataSet>; }, none_);
+      } else {
+        a_.test_ = byText(
+          [](auto m_) { return &strTest<decltype(m_), TDataSet>; }, none_);
+      }
+      break;
     }
-    case Fields::MimeContentType: {
-      return d_.mimeTypeContent;
+    case TypeVar::TLong: {
+      break;
     }
-    case Fields::OrigRcvReqHeader: {
-      return d_.origRcvReqHeader;
+  }
+}
+
+/*!
+ * \internal
+ * \brief Resolves the test of the rows of columns_, used by where(). The
+ * values of a dictionary column are tested once each, here.
+ */
+void
+SLPQuery::Predicate::resolveRows()
+{
+  row_ = &rowConstant<false>;
+  switch (type_) {
+    case TypeVar::TInt: {
+      intCol_ = cols_.ints(fld_);
+      if (intCol_ != nullptr) {
+        row_ = byNumber([](auto m_) { return &rowInt<decltype(m_)>; },
+                        RowTest(&rowConstant<false>));
+      } else if (byNumber(
+                   [this](auto m_) { return decltype(m_)::match(*this, -1); },
+                   false)) {
+        row_ = &rowConstant<true>;
+      }
+      break;
     }
-    case Fields::Referrer: {
-      return d_.referrer;
+    case TypeVar::TUint: {
+      uintCol_ = fld_ == Fields::Timestamp      ? &cols_.timeStamps()
+                 : fld_ == Fields::CliSrcIpAddr ? &cols_.addrs()
+                                                : nullptr;
+      if (uintCol_ != nullptr) {
+        row_ = byNumber([](auto m_) { return &rowUint<decltype(m_)>; },
+                        RowTest(&rowConstant<false>));
+      } else if (byNumber(
+                   [this](auto m_) {
+                     return decltype(m_)::match(*this, uint32_t(0));
+                   },
+                   false)) {
+        row_ = &rowConstant<true>;
+      }
+      break;
     }
-    case Fields::UserAgent: {
-      return d_.userAgent;
+    case TypeVar::TString: {
+      const SLPDictionary* dict_ = cols_.dictionary(fld_);
+      if (dict_ != nullptr) {
+        codes_ = cols_.codes(fld_);
+        hit_.assign(dict_->size(), 0);
+        byText(
+          [this, dict_](auto m_) {
+            for (uint32_t c_ = 0; c_ < hit_.size(); ++c_) {
+              hit_[c_] = decltype(m_)::match(*this, dict_->text(c_));
+            }
+            return true;
+          },
+          false);
+        row_ = &rowCode;
+      } else if (SLPColumnStore::isText(fld_)) {
+        row_ = byText([](auto m_) { return &rowText<decltype(m_)>; },
+                      RowTest(&rowConstant<false>));
+      } else {
+        row_ = byText([](auto m_) { return &rowStr<decltype(m_)>; },
+                      RowTest(&rowConstant<false>));
+      }
+      break;
     }
-    default: {
-      return invalidText.data();
+    case TypeVar::TLong: {
+      break;
     }
   }
 }
 
 /*!
  * \internal
- * \brief This template function implements the logical AND and OR operations
- * for functions like "between A AND B" or "between A OR B".
- *
- * \param data_ The data to be compared with its limits.
- * \param min_ Lower value.
- * \param max_ Highest value.
- * \param cmp_ Type of logical operation: BTWAND | BTWOR
- *
- *
+ * \brief Instantiates pick_ with the matcher of a numeric comparison.
  */
-template<typename TVarD, typename TMin, typename TMax, typename TCompare>
-bool
-SquidLogParser::decision(TVarD&& data_,
-                         TMin&& min_,
-                         TMax&& max_,
-                         TCompare&& cmp_) const
+template<typename TResult, typename TPick>
+TResult
+SLPQuery::Predicate::byNumber(TPick&& pick_, TResult none_) const
+{
+  if (in_) {
+    return pick_(InList());
+  }
+  return byOperator(pick_, none_);
+}
+
+/*!
+ * \internal
+ * \brief Instantiates pick_ with the matcher of a text comparison.
+ */
+template<typename TResult, typename TPick>
+TResult
+SLPQuery::Predicate::byText(TPick&& pick_, TResult none_) const
 {
+  if (in_) {
+    return pick_(InList());
+  }
   switch (cmp_) {
-    case Compare::BTWAND: {
-      return ((data_ >= min_) && (data_ <= max_));
+    case Compare::REGEX: {
+      return pick_(ByRegex());
     }
-    case Compare::BTWOR: {
-      return ((data_ >= min_) || (data_ <= max_));
+    case Compare::HOST:
+    case Compare::DOMAIN: {
+      return pick_(ByHost());
     }
     default: {
-      return false;
+      return byOperator(pick_, none_);
     }
   }
-};
+}
 
 /*!
  * \internal
- * \brief Overloaded: This template function implements the logical
- * operations:
- * == < > <= >= !=
- * \param lhs_ Argument 1
- * \param rhs_ Argument 2
- * \param cmp_ Type of logical operation. EQ, LT, GT, LE, GE, NE
+ * \brief Instantiates pick_ with ByOperator of the function object of cmp_.
+ * The other operators give none_, nothing is selected, as decision() does.
  */
-template<typename TVarS, typename TVarD, typename TCompare>
-bool
-SquidLogParser::decision(TVarS&& lhs_, TVarD&& rhs_, TCompare&& cmp_) const
+template<typename TResult, typename TPick>
+TResult
+SLPQuery::Predicate::byOperator(TPick&& pick_, TResult none_) const
 {
   switch (cmp_) {
     case Compare::EQ: {
-      return lhs_ == rhs_;
+      return pick_(ByOperator<std::equal_to<>>());
     }
     case Compare::LT: {
-      return lhs_ < rhs_;
+      return pick_(ByOperator<std::less<>>());
     }
     case Compare::GT: {
-      return lhs_ > rhs_;
+      return pick_(ByOperator<std::greater<>>());
     }
     case Compare::LE: {
-      return lhs_ <= rhs_;
+      return pick_(ByOperator<std::less_equal<>>());
     }
     case Compare::GE: {
-      return lhs_ >= rhs_;
+      return pick_(ByOperator<std::greater_equal<>>());
     }
     case Compare::NE: {
-      return lhs_ != rhs_;
+      return pick_(ByOperator<std::not_equal_to<>>());
     }
     default: {
-      return false;
+      return none_;
     }
   }
-};
-
-/*!
- * \brief Return a error code.
- * \return
- */
-SquidLogParser::SLPError
-SquidLogParser::errorNum() const noexcept
-{
-  return slpError_;
 }
 
 /*!
- * \brief Return the description of the error.
- * \return std::string
+ * \internal
+ * \brief Test of a comparison whose result does not depend on the entry.
  */
-std::string
-SquidLogParser::getErrorText() const
+template<typename TDataSet, bool TResult>
+bool
+SLPQuery::Predicate::constant(const Predicate&,
+                              const Access<TDataSet>&,
+                              const TDataSet&)
 {
-  if (const auto it_(mError.find(slpError_)); it_ != mError.end()) {
-    return it_->second.data();
-  }
-  return mError.at(SLPError::SLP_ERR_UNKNOWN).data();
+  return TResult;
 }
 
-/* private------------------------------------------------------------------
- */
-
 /*!
  * \internal
- *
- * \note The constants below are defined in CMakeLists.txt
- *
- * DEBUG_PARSER_SQUID
- * DEBUG_PARSER_COMMON
- * DEBUG_PARSER_COMBINED
- * DEBUG_PARSER_REFERRER
- * DEBUG_PARSER_USERAGENT
- *
+ * \brief Tests an integer field.
  */
+template<typename TMatch, typename TDataSet>
+bool
+SLPQuery::Predicate::intTest(const Predicate& p_,
+                             const Access<TDataSet>& a_,
+                             const TDataSet& d_)
+{
+  return TMatch::match(p_, d_.*a_.int_);
+}
 
 /*!
  * \internal
- * \brief SquidLogParser::parserSquid
- * \return
- *
+ * \brief Tests Timestamp or CliSrcIpAddr.
  */
-SquidLogData::SLPError
-SquidLogParser::parserSquid()
+template<typename TMatch, typename TDataSet>
+bool
+SLPQuery::Predicate::uintTest(const Predicate& p_,
+                              const Access<TDataSet>& a_,
+                              const TDataSet& d_)
 {
-
-  if (rawLog_.empty()) {
-    setError(SLPError::SLP_SUCCESS);
-    return SLPError::SLP_SUCCESS;
-  }
-
-#ifdef DEBUG_PARSER_SQUID
-  std::cout << "raw : " << rawLog_ << "\n";
-#endif
-
-  try {
-    boost::match_results<std::string::const_iterator> match;
-    boost::regex_match(rawLog_, match, re_id_fmt_squid_);
-    if (match.empty()) {
-      setError(SLPError::SLP_ERR_PARSER_FAILED);
-      return SLPError::SLP_ERR_PARSER_FAILED;
-    }
-    ds_squid_ = {};
-    ds_squid_.timeStamp = std::move(std::stod(match[1]));
-    ds_squid_.responseTime = std::move(std::stoi(match[2]));
-    ds_squid_.cliSrcIpAddr = std::move(IPv4Addr::iptol(match[3]));
-    ds_squid_.reqStatusHierStatus = std::move(match[4]);
-    ds_squid_.totalSizeReply = std::move(std::stoi(match[5]));
-    ds_squid_.reqMethod = std::move(match[6]);
-    ds_squid_.reqURL = std::move(match[7]);
-    ds_squid_.userName = std::move(match[8]);
-    ds_squid_.hierStatusIpAddress = std::move(match[9]);
-    ds_squid_.mimeTypeContent = std::move(match[10]);
-
-    // stores unique http request codes for later score.
-    HttpCodesUniques_m.insert(
-      { std::move(std::stoi(strRight(ds_squid_.reqStatusHierStatus, '/'))),
-        0 });
-
-    // stores unique file extension for later score.
-    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
-      FiletypeUniques_m.insert({ ext_, 0 });
-    }
-
-#ifdef DEBUG_PARSER_SQUID
-    std::cout << "ds_squid :\n";
-    std::cout << ds_squid_.timeStamp << "\n"
-              << ds_squid_.responseTime << "\n"
-              << ds_squid_.cliSrcIpAddr << "\n"
-              << ds_squid_.reqStatusHierStatus << "\n"
-              << ds_squid_.totalSizeReply << "\n"
-              << ds_squid_.reqMethod << "\n"
-              << ds_squid_.reqURL << "\n"
-              << ds_squid_.userName << "\n"
-              << ds_squid_.hierStatusIpAddress << "\n"
-              << ds_squid_.mimeTypeContent << "\n";
-    for (size_t i = 1; i < match.size(); i++) {
-      std::cout << "> " << i << " -- " << match[i] << "\n";
-    }
-#endif
-  } catch (boost::regex_error& e_) {
-    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
-    setError(SLPError::SLP_ERR_PARSER_FAILED);
-    return SLPError::SLP_ERR_PARSER_FAILED;
-  } catch (const std::exception& e_) {
-    printException(e_, __FUNCTION__, __LINE__);
-    exit(EXIT_FAILURE);
-  }
-
-  setError(SLPError::SLP_SUCCESS);
-  return SLPError::SLP_SUCCESS;
+  return TMatch::match(p_, d_.*a_.uint_);
 }
 
 /*!
  * \internal
- * \brief SquidLogParser::parserCommon
- * \return
+ * \brief Tests a text field in place.
  */
-SquidLogData::SLPError
-SquidLogParser::parserCommon()
-{
-  if (rawLog_.empty()) {
-    setError(SLPError::SLP_SUCCESS);
-    return SLPError::SLP_SUCCESS;
-  }
-
-#ifdef DEBUG_PARSER_COMMON
-  std::cout << "raw : " << rawLog_ << "\n";
-#endif
-
-  try {
-    boost::match_results<std::string::const_iterator> match;
-    boost::regex_match(rawLog_, match, re_id_fmt_common_);
-    if (match.empty()) {
-      setError(SLPError::SLP_ERR_PARSER_FAILED);
-      return SLPError::SLP_ERR_PARSER_FAILED;
-    }
-
-    ds_squid_ = {};
-    ds_squid_.cliSrcIpAddr = std::move(IPv4Addr::iptol(match[1]));
-    ds_squid_.userNameIdent = std::move(match[2]);
-    ds_squid_.userName = std::move(match[3]);
-    ds_squid_.localTime = std::move(match[4]);
-    ds_squid_.reqMethod = std::move(match[5]);
-    ds_squid_.reqURL = std::move(match[6]);
-    ds_squid_.reqProtoVersion = std::move(match[7]);
-    ds_squid_.httpStatus = std::move(std::stoi(match[8]));
-    ds_squid_.totalSizeReply = std::move(std::stoi(match[9]));
-    ds_squid_.reqStatusHierStatus = std::move(match[10]);
-
-    // stores unique http request codes for later score.
-    HttpCodesUniques_m.insert({ std::move(std::stoi(match[8])), 0 });
-
-    // stores unique file extension for later score.
-    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
-      FiletypeUniques_m.insert({ ext_, 0 });
-    }
-
-#ifdef DEBUG_PARSER_COMMON
-    std::cout << "ds_common :\n";
-    std::cout << ds_squid_.cliSrcIpAddr << "\n"
-              << ds_squid_.userNameIdent << "\n"
-              << ds_squid_.userName << "\n"
-              << ds_squid_.localTime << "\n"
-              << ds_squid_.reqMethod << "\n"
-              << ds_squid_.reqURL << "\n"
-              << ds_squid_.reqProtoVersion << "\n"
-              << ds_squid_.httpStatus << "\n"
-              << ds_squid_.totalSizeReply << "\n"
-              << ds_squid_.reqStatusHierStatus << "\n";
-
-    for (size_t i = 1; i < match.size(); i++) {
-      std::cout << "> " << i << " -- " << match[i] << "\n";
-    }
-#endif
-  } catch (boost::regex_error& e_) {
-    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
-    setError(SLPError::SLP_ERR_PARSER_FAILED);
-    return SLPError::SLP_ERR_PARSER_FAILED;
-  } catch (const std::exception& e_) {
-    printException(e_, __FUNCTION__, __LINE__);
-    exit(EXIT_FAILURE);
-  }
+template<typename TMatch, typename TDataSet>
+bool
+SLPQuery::Predicate::textTest(const Predicate& p_,
+                              const Access<TDataSet>& a_,
+                              const TDataSet& d_)
+{
+  return TMatch::match(p_, std::string_view(d_.*a_.text_));
+}
 
-  setError(SLPError::SLP_SUCCESS);
-  return SLPError::SLP_SUCCESS;
+/*!
+ * \internal
+ * \brief Tests the text of a numeric field.
+ */
+template<typename TMatch, typename TDataSet>
+bool
+SLPQuery::Predicate::strTest(const Predicate& p_,
+                             const Access<TDataSet>&,
+                             const TDataSet& d_)
+{
+  const std::string s_ = p_.query_.strFields(p_.fld_, d_);
+  return TMatch::match(p_, std::string_view(s_));
 }
 
 /*!
  * \internal
- * \brief SquidLogParser::parserCombined
- * \return
+ * \brief Row test whose result does not depend on the row.
  */
-SquidLogData::SLPError
-SquidLogParser::parserCombined()
+template<bool TResult>
+bool
+SLPQuery::Predicate::rowConstant(const Predicate&, size_t)
 {
-  if (rawLog_.empty()) {
-    setError(SLPError::SLP_SUCCESS);
-    return SLPError::SLP_SUCCESS;
-  }
+  return TResult;
+}
 
-#ifdef DEBUG_PARSER_COMBINED
-  std::cout << "raw combined : " << rawLog_ << "\n";
-#endif
+/*!
+ * \internal
+ * \brief Tests a row of an integer column.
+ */
+template<typename TMatch>
+bool
+SLPQuery::Predicate::rowInt(const Predicate& p_, size_t r_)
+{
+  return TMatch::match(p_, (*p_.intCol_)[r_]);
+}
 
-  try {
-    boost::match_results<std::string::const_iterator> match;
-    boost::regex_match(rawLog_, match, re_id_fmt_combined_);
-    if (match.empty()) {
-      setError(SLPError::SLP_ERR_PARSER_FAILED);
-      return SLPError::SLP_ERR_PARSER_FAILED;
-    }
+/*!
+ * \internal
+ * \brief Tests a row of the timestamps or of the addresses.
+ */
+template<typename TMatch>
+bool
+SLPQuery::Predicate::rowUint(const Predicate& p_, size_t r_)
+{
+  return TMatch::match(p_, (*p_.uintCol_)[r_]);
+}
 
-    ds_squid_ = {};
-    ds_squid_.cliSrcIpAddr = std::move(IPv4Addr::iptol(match[1]));
-    ds_squid_.userNameIdent = std::move(match[2]);
-    ds_squid_.userName = std::move(match[3]);
-    ds_squid_.localTime = std::move(match[4]);
-    ds_squid_.reqMethod = std::move(match[5]);
-    ds_squid_.reqURL = std::move(match[6]);
-    ds_squid_.reqProtoVersion = std::move(match[7]);
-    ds_squid_.httpStatus = std::move(std::stoi(match[8]));
-    ds_squid_.totalSizeReply = std::move(std::stoi(match[9]));
-    ds_squid_.referrer = std::move(match[10]);
-    ds_squid_.userAgent = std::move(match[11]);
-    ds_squid_.reqStatusHierStatus = std::move(match[12]);
+/*!
+ * \internal
+ * \brief Tests a row of a text column without dictionary.
+ */
+template<typename TMatch>
+bool
+SLPQuery::Predicate::rowText(const Predicate& p_, size_t r_)
+{
+  return TMatch::match(p_, p_.cols_.text(p_.fld_, r_));
+}
 
-    // stores unique http request codes for later score.
-    HttpCodesUniques_m.insert({ std::move(std::stoi(match[8])), 0 });
+/*!
+ * \internal
+ * \brief Tests the text of a numeric field of a row.
+ */
+template<typename TMatch>
+bool
+SLPQuery::Predicate::rowStr(const Predicate& p_, size_t r_)
+{
+  const std::string s_ = p_.query_.strFields(p_.fld_, p_.cols_.row(r_));
+  return TMatch::match(p_, std::string_view(s_));
+}
 
-    // stores unique file extension for later score.
-    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
-      FiletypeUniques_m.insert({ ext_, 0 });
-    }
+/*!
+ * \internal
+ * \brief Tests a row of a dictionary column by its code.
+ */
+bool
+SLPQuery::Predicate::rowCode(const Predicate& p_, size_t r_)
+{
+  return p_.hit_[(*p_.codes_)[r_]] != 0;
+}
 
-#ifdef DEBUG_PARSER_COMBINED
-    std::cout << "ds_combined :\n";
-    std::cout << ds_squid_.cliSrcIpAddr << "\n"
-              << ds_squid_.userNameIdent << "\n"
-              << ds_squid_.userName << "\n"
-              << ds_squid_.localTime << "\n"
-              << ds_squid_.reqMethod << "\n"
-              << ds_squid_.reqURL << "\n"
-              << ds_squid_.reqProtoVersion << "\n"
-              << ds_squid_.httpStatus << "\n"
-              << ds_squid_.totalSizeReply << "\n"
-              << ds_squid_.referrer << "\n"
-              << ds_squid_.userAgent << "\n"
-              << ds_squid_.reqStatusHierStatus << "\n";
+/*!
+ * \internal
+ * \brief Appends to rows_ the address of each entry of store_ in the time
+ * range of select() that match_ accepts; the range is found by binary
+ * search, the other entries are not visited. rows_ stays in key order,
+ * merged with the entries selected by the previous calls to field(), as a
+ * std::multimap of them would be.
+ * A large range is cut in parts of equal duration, each one found by binary
+ * search and scanned by one thread; the parts are appended in order.
+ */
+template<typename TRows, typename TStore, typename TMatch>
+void
+SLPQuery::selectRows(TRows& rows_, const TStore& store_, TMatch&& match_)
+{
+  const uint32_t min_ = info_t.begin_date_;
+  const uint32_t max_ = info_t.end_date_;
+  const size_t before_ = rows_.size();
+  const auto range_ = timeRange(store_, min_, max_);
+  auto scan_ = [&match_](auto it_, auto end_, TRows& out_) {
+    for (; it_ != end_; ++it_) {
+      if (match_(*it_)) {
+        out_.push_back(&*it_);
+      }
+    }
+  };
 
-    for (size_t i = 1; i < match.size(); i++) {
-      std::cout << "> " << i << " -- " << match[i] << "\n";
+  const size_t parts_ =
+    max_ < min_
+      ? 1
+      : std::min<size_t>(parts(store_.size()), size_t(max_ - min_) + 1);
+  if (parts_ <= 1) {
+    scan_(range_.first, range_.second, rows_);
+  } else {
+    const uint64_t span_ = uint64_t(max_ - min_) + 1;
+    auto cut_ = [&range_, &store_, min_, span_, parts_](size_t i_) {
+      return i_ == 0        ? range_.first
+             : i_ == parts_ ? range_.second
+                            : store_.lower_bound(DataKey(
+                                uint32_t(min_ + span_ * i_ / parts_), 0));
+    };
+    std::vector<TRows> found_(parts_);
+    parallel(parts_,
+             [&](size_t i_) { scan_(cut_(i_), cut_(i_ + 1), found_[i_]); });
+    for (const TRows& f_ : found_) {
+      rows_.insert(rows_.end(), f_.begin(), f_.end());
     }
-#endif
-  } catch (boost::regex_error& e_) {
-    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
-    setError(SLPError::SLP_ERR_PARSER_FAILED);
-    return SLPError::SLP_ERR_PARSER_FAILED;
-  } catch (const std::exception& e_) {
-    printException(e_, __FUNCTION__, __LINE__);
-    exit(EXIT_FAILURE);
   }
-
-  setError(SLPError::SLP_SUCCESS);
-  return SLPError::SLP_SUCCESS;
+  std::inplace_merge(
+    rows_.begin(),
+    rows_.begin() + before_,
+    rows_.end(),
+    [](const auto* a_, const auto* b_) { return a_->first < b_->first; });
 }
 
 /*!
  * \internal
- * \brief SquidLogParser::parserReferrer
- * \return
+ * \brief Calls f_(key, entry) for the entries [begin_, end_) of the
+ * selection of mEntry and mView, entryRows_ followed by viewRows_, in key
+ * order within each store. The selection is scanned in parts, see
+ * partials().
  */
-SquidLogData::SLPError
-SquidLogParser::parserReferrer()
+template<typename TFunc>
+void
+SLPQuery::forSelected(size_t begin_, size_t end_, TFunc&& f_) const
 {
-  if (rawLog_.empty()) {
-    setError(SLPError::SLP_SUCCESS);
-    return SLPError::SLP_SUCCESS;
+  const size_t n_ = entryRows_.size();
+  for (size_t i_ = begin_; i_ < std::min(end_, n_); ++i_) {
+    f_(entryRows_[i_]->first, entryRows_[i_]->second);
   }
-
-#ifdef DEBUG_PARSER_REFERRER
-  std::cout << "raw : " << rawLog_ << "\n";
-#endif
-
-  try {
-    boost::match_results<std::string::const_iterator> match;
-    boost::regex_match(rawLog_, match, re_id_fmt_referrer_);
-    if (match.empty()) {
-      setError(SLPError::SLP_ERR_PARSER_FAILED);
-      return SLPError::SLP_ERR_PARSER_FAILED;
-    }
-
-    ds_squid_ = {};
-    ds_squid_.timeStamp = std::move(std::stoul(match[1]));
-    ds_squid_.cliSrcIpAddr = std::move(IPv4Addr::iptol(match[2]));
-    ds_squid_.referrer = std::move(match[3]);
-    ds_squid_.reqURL = std::move(match[4]);
-
-    // stores unique file extension for later score.
-    if (const std::string ext_ = getFiletype(ds_squid_.reqURL); !ext_.empty()) {
-      FiletypeUniques_m.insert({ ext_, 0 });
-    }
-
-#ifdef DEBUG_PARSER_REFERRER
-    std::cout << "ds_referrer :\n";
-    std::cout << ds_squid_.timeStamp << "\n"
-              << ds_squid_.cliSrcIpAddr << "\n"
-              << ds_squid_.referrer << "\n"
-              << ds_squid_.reqURL << "\n";
-
-    for (size_t i = 1; i <= match.size(); i++) {
-      std::cout << "> " << i << " -- " << match[i] << "\n";
-    }
-#endif
-  } catch (boost::regex_error& e_) {
-    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
-    setError(SLPError::SLP_ERR_PARSER_FAILED);
-    return SLPError::SLP_ERR_PARSER_FAILED;
-  } catch (const std::exception& e_) {
-    printException(e_, __FUNCTION__, __LINE__);
-    exit(EXIT_FAILURE);
+  for (size_t i_ = std::max(begin_, n_); i_ < end_; ++i_) {
+    f_(viewRows_[i_ - n_]->first, viewRows_[i_ - n_]->second);
   }
-
-  setError(SLPError::SLP_SUCCESS);
-  return SLPError::SLP_SUCCESS;
 }
 
 /*!
  * \internal
- * \brief SquidLogParser::parserUserAgent
- * \return
+ * \brief Number of parts in which a scan of n_ entries is cut: 1 if the
+ * query has a single thread or n_ is small.
  */
-SquidLogData::SLPError
-SquidLogParser::parserUserAgent()
+size_t
+SLPQuery::parts(size_t n_) const
 {
-  if (rawLog_.empty()) {
-    setError(SLPError::SLP_SUCCESS);
-    return SLPError::SLP_SUCCESS;
+  if (threads_ == 1 || n_ < 2 * minPartSize_) {
+    return 1;
   }
+  const size_t threads_n_ = std::min<size_t>(
+    SLPThreadPool::concurrency(threads_), SLPThreadPool::shared().size());
+  if (threads_n_ == 1) {
+    return 1;
+  }
+  return std::min(threads_n_ * partsPerThread_, n_ / minPartSize_);
+}
 
-#ifdef DEBUG_PARSER_USERAGENT
-  std::cout << "raw : " << rawLog_ << "\n";
-#endif
-
-  try {
-    boost::match_results<std::string::const_iterator> match;
-    boost::regex_match(rawLog_, match, re_id_fmt_useragent_);
-    if (match.empty()) {
-      setError(SLPError::SLP_ERR_PARSER_FAILED);
-      return SLPError::SLP_ERR_PARSER_FAILED;
-    }
-
-    ds_squid_ = {};
-    ds_squid_.cliSrcIpAddr = std::move(IPv4Addr::iptol(match[1]));
-    ds_squid_.localTime = std::move(match[2]);
-    ds_squid_.userAgent = std::move(match[3]);
-
-#ifdef DEBUG_PARSER_USERAGENT
-    std::cout << "ds_useragent :\n";
-    std::cout << ds_squid_.cliSrcIpAddr << "\n"
-              << ds_squid_.localTime << " "
-              << unixTimestamp(ds_squid_.localTime) << "\n"
-              << ds_squid_.userAgent << "\n";
-
-    for (size_t i = 1; i <= match.size(); i++) {
-      std::cout << "> " << i << " -- " << match[i] << "\n";
-    }
-#endif
-  } catch (boost::regex_error& e_) {
-    std::cout << "SquidLogParser regex error = " << e_.what() << "\n";
-    setError(SLPError::SLP_ERR_PARSER_FAILED);
-    return SLPError::SLP_ERR_PARSER_FAILED;
-  } catch (const std::exception& e_) {
-    printException(e_, __FUNCTION__, __LINE__);
-    exit(EXIT_FAILURE);
+/*!
+ * \internal
+ * \brief Calls f_(i) for each part i in [0, parts_), on the threads of the
+ * query. A single part is run by the calling thread.
+ */
+template<typename TFunc>
+void
+SLPQuery::parallel(size_t parts_, TFunc&& f_) const
+{
+  if (parts_ == 1) {
+    f_(size_t(0));
+    return;
   }
+  SLPThreadPool::shared().run(parts_, threads_, f_);
+}
 
-  setError(SLPError::SLP_SUCCESS);
-  return SLPError::SLP_SUCCESS;
+/*!
+ * \internal
+ * \brief Cuts [0, n_) in parts and calls f_(acc, begin, end) for each one,
+ * on the threads of the query. Returns the TAcc of each part, in order,
+ * for the caller to merge.
+ */
+template<typename TAcc, typename TFunc>
+std::vector<TAcc>
+SLPQuery::partials(size_t n_, TFunc&& f_) const
+{
+  std::vector<TAcc> acc_(parts(n_));
+  const size_t parts_ = acc_.size();
+  parallel(parts_, [&acc_, &f_, n_, parts_](size_t i_) {
+    f_(acc_[i_], n_ * i_ / parts_, n_ * (i_ + 1) / parts_);
+  });
+  return acc_;
 }
 
 /*!
  * \internal
- * \brief Normalize a string removing the extra white spaces between words.
- * \param input_
- * \param output_
- * \note Adapted from:
- * https://stackoverflow.com/questions/35301432/remove-extra-white-spaces-in-c/35302029
+ * \brief Appends to rows_ the rows found by scan_(begin, end, out) in
+ * [begin_, end_). The span is cut in parts whose bounds are multiples of
+ * align_, scanned by the threads of the query, and appended in order.
  */
+template<typename TScan>
 void
-SquidLogParser::removeExtraWhiteSpaces(const std::string& input_,
-                                       std::string& output_)
+SLPQuery::collectRows(size_t begin_, size_t end_, size_t align_, TScan&& scan_)
 {
-  output_.clear(); // unless you want to add at the end of existing string...
-  std::unique_copy(
-    input_.cbegin(),
-    input_.cend(),
-    std::back_insert_iterator<std::string>(output_),
-    [](char a_, char b_) { return ::isspace(a_) && ::isspace(b_); });
+  const size_t parts_ = begin_ < end_ ? parts(end_ - begin_) : 1;
+  if (parts_ <= 1) {
+    scan_(begin_, end_, rows_);
+    return;
+  }
+  auto cut_ = [begin_, end_, align_, parts_](size_t i_) {
+    if (i_ == parts_) {
+      return end_;
+    }
+    const size_t at_ = begin_ + (end_ - begin_) * i_ / parts_;
+    return std::max(begin_, at_ - at_ % align_);
+  };
+  std::vector<std::vector<uint32_t>> found_(parts_);
+  parallel(parts_,
+           [&](size_t i_) { scan_(cut_(i_), cut_(i_ + 1), found_[i_]); });
+  for (const std::vector<uint32_t>& f_ : found_) {
+    rows_.insert(rows_.end(), f_.begin(), f_.end());
+  }
 }
 
 /*!
  * \internal
- * \brief SLPDatabase::signalHandler
- * \param signum_
+ * \brief Converts the keys of the batched getInt(), getUInt() and getStr().
  */
-void
-SquidLogParser::signalHandler(const int signum_)
+std::vector<DataKey>
+SLPQuery::dataKeys(const Keys_V& keys_) const
 {
-  std::cout << "\n\nSquidLogParser Library Interrupt signal [ "
-            << (signum_ == 2 ? "Control-C" : std::to_string(signum_))
-            << " ] received.\n\n";
-  exit(signum_);
+  std::vector<DataKey> dk_;
+  dk_.reserve(keys_.size());
+  for (const auto& k_ : keys_) {
+    dk_.emplace_back(unixTimestamp(k_.first), addrToNumeric(k_.second));
+  }
+  return dk_;
 }
 
 /*!
  * \internal
- * \brief Prints formatted exception messages.
- * \param e_
- * \param fname_
- * \param line_
+ * \brief Calls f_(i, entry) for each entry selected whose key is keys_[i],
+ * in the order of forSelected() for each key. The selections are in
+ * timestamp order, so they are walked once along with the keys, sorted:
+ * the entries of each timestamp are found by binary search from those of
+ * the previous one, and each entry is given to the keys of its address.
  */
+template<typename TFunc>
 void
-SquidLogParser::printException(const std::exception& e_,
-                               const char* fname_,
-                               const int line_)
+SLPQuery::forSelectedAt(const std::vector<DataKey>& keys_, TFunc&& f_) const
 {
-  std::cout << "\nSquidLogParser Caught an exception at " << fname_
-            << "::" << line_ << " " << e_.what() << '\n';
+  std::vector<size_t> order_(keys_.size());
+  std::iota(order_.begin(), order_.end(), 0);
+  std::sort(order_.begin(), order_.end(), [&keys_](size_t a_, size_t b_) {
+    return std::make_pair(keys_[a_].getTs(), keys_[a_].getIp()) <
+           std::make_pair(keys_[b_].getTs(), keys_[b_].getIp());
+  });
+
+  // ts_, ip_ and entry_ read the key and the entry of an element of sel_.
+  auto walk_ = [&keys_, &order_, &f_](
+                 const auto& sel_, auto&& ts_, auto&& ip_, auto&& entry_) {
+    auto it_ = sel_.begin();
+    for (auto k_ = order_.begin(); k_ != order_.end();) {
+      const uint32_t t_ = keys_[*k_].getTs();
+      const auto last_ =
+        std::find_if(k_, order_.end(), [&keys_, t_](size_t i_) {
+          return keys_[i_].getTs() != t_;
+        });
+      it_ = std::lower_bound(
+        it_, sel_.end(), t_, [&ts_](const auto& a_, uint32_t v_) {
+          return ts_(a_) < v_;
+        });
+      for (; it_ != sel_.end() && ts_(*it_) == t_; ++it_) {
+        const uint32_t ip_v_ = ip_(*it_);
+        auto i_ = std::lower_bound(
+          k_, last_, ip_v_, [&keys_](size_t a_, uint32_t v_) {
+            return keys_[a_].getIp() < v_;
+          });
+        for (; i_ != last_ && keys_[*i_].getIp() == ip_v_; ++i_) {
+          f_(*i_, entry_(*it_));
+        }
+      }
+      k_ = last_;
+    }
+  };
+
+  auto ts_ = [](const auto* e_) { return e_->first.getTs(); };
+  auto ip_ = [](const auto* e_) { return e_->first.getIp(); };
+  auto entry_ = [](const auto* e_) -> const auto& { return e_->second; };
+  walk_(entryRows_, ts_, ip_, entry_);
+  walk_(viewRows_, ts_, ip_, entry_);
+
+  const std::vector<uint32_t>& ts_col_ = columns_->timeStamps();
+  const std::vector<uint32_t>& addrs_ = columns_->addrs();
+  walk_(
+    rows_,
+    [&ts_col_](uint32_t r_) { return ts_col_[r_]; },
+    [&addrs_](uint32_t r_) { return addrs_[r_]; },
+    [this](uint32_t r_) { return columns_->row(r_); });
 }
 
-/* SLPQuery --------------------------------------------------------------- */
 /*!
- * \brief Constructs a SLPQuery object.
- * \param pf_ Object pointer
+ * \internal
+ * \brief Merges the rows appended to rows_ from before_ on with the rows
+ * selected before them, in timestamp order, as selectRows() does.
  */
-SLPQuery::SLPQuery(SquidLogParser* obj_)
-  : SquidLogParser(*obj_)
-  , mSubset_({})
-  , logFmt_(getFormat())
-  , slpError_(SLPError::SLP_SUCCESS)
-  , info_t({})
+void
+SLPQuery::mergeRows(size_t before_)
 {
+  const std::vector<uint32_t>& ts_col_ = columns_->timeStamps();
+  if (before_ == 0 || before_ == rows_.size() ||
+      ts_col_[rows_[before_ - 1]] <= ts_col_[rows_[before_]]) {
+    return; // already in order
+  }
+  std::inplace_merge(rows_.begin(),
+                     rows_.begin() + before_,
+                     rows_.end(),
+                     [&ts_col_](uint32_t a_, uint32_t b_) {
+                       return ts_col_[a_] < ts_col_[b_];
+                     });
 }
 
 /*!
- * \brief Selects the records given the following arguments: Being date, begin
- * IP, end date and end IP.
- * \param d0_  Begin date. Format: dd/Mmm/yyyy:hh:mm:ss
- * \param ip0_ Being IP address.
- * \param d1_  End date. Format: dd/Mmm/yyyy:hh:mm:ss
- * \param ip1_ Ende IP address.
- * \return *this
+ * \internal
+ * \brief True if no value in [min_, max_] can satisfy "value cmp_ v_".
  */
-SLPQuery&
-SLPQuery::select(const std::string&& d0_,
-                 const std::string&& ip0_,
-                 const std::string&& d1_,
-                 const std::string&& ip1_)
+template<typename T>
+bool
+SLPQuery::zoneExcludes(Compare cmp_, T min_, T max_, T v_)
 {
-  info_t = {};
-  if ((!d0_.empty() && !ip0_.empty()) && (d1_.empty() && ip1_.empty())) { // a,b
-    info_t.begin_date_ = unixTimestamp(d0_);
-    info_t.begin_ip_ = addrToNumeric(ip0_);
-    if (info_t.begin_date_ > 0 && info_t.begin_ip_ > 0) {
-      info_t.end_date_ = info_t.begin_date_;
-      info_t.end_ip_ = info_t.begin_ip_;
-      setError(SLPError::SLP_SUCCESS);
-      info_t.flag_ = true;
-    } else {
-      setError(SLPError::SLP_ERR_INVALID_TS_OR_IP);
-      info_t.flag_ = false;
+  switch (cmp_) {
+    case Compare::EQ: {
+      return v_ < min_ || v_ > max_;
     }
-  } else if ((!d0_.empty() && !ip0_.empty()) &&
-             (!d1_.empty() && !ip1_.empty())) { // a,b,c,d
-    info_t.begin_date_ = unixTimestamp(d0_);
-    info_t.end_date_ = unixTimestamp(d1_);
-    info_t.begin_ip_ = addrToNumeric(ip0_);
-    info_t.end_ip_ = addrToNumeric(ip1_);
-    if ((info_t.begin_date_ > 0 && info_t.begin_ip_ > 0) &&
-        (info_t.end_date_ > 0 && info_t.end_ip_ > 0)) {
-      setError(SLPError::SLP_SUCCESS);
-      info_t.flag_ = true;
-    } else {
-      setError(SLPError::SLP_ERR_INVALID_TS_OR_IP);
-      info_t.flag_ = false;
+    case Compare::NE: {
+      return min_ == v_ && max_ == v_;
+    }
+    case Compare::LT: {
+      return min_ >= v_;
+    }
+    case Compare::LE: {
+      return min_ > v_;
+    }
+    case Compare::GT: {
+      return max_ <= v_;
+    }
+    case Compare::GE: {
+      return max_ < v_;
+    }
+    default: {
+      return false;
     }
-  } else {
-    setError(SLPError::SLP_ERR_INCOMPLETE_NUM_ARGS);
-    info_t.flag_ = false;
   }
-
-  return *this;
 }
 
 /*!
- * \brief Tells the select() function which field should be used as a
- * conditional key for searching.
- * \param fld_ enum Fields.
- * \param cmp_ enum Compare.
- * \param t_ Value to compare.
+ * \internal
+ * \brief field() for StorageMode::Columnar: appends to rows_ the rows
+ * selected, nothing is copied. Only the rows in the time range are visited,
+ * and the segments whose zone map excludes the addresses or the value are
+ * skipped. With an address index the rows of the address range found in it
+ * are visited instead, when they are fewer. Compare::HOST and
+ * Compare::DOMAIN on ReqURL visit only the rows given by the host index.
+ * re_ is the regex of Compare::REGEX, compiled by field(). rows_ stays in
+ * timestamp order, see mergeRows().
  */
 void
-SLPQuery::field(Fields fld_, Compare cmp_, Visitor::var_t&& t_)
+SLPQuery::fieldColumns(Fields fld_,
+                       Compare cmp_,
+                       const var_t& t_,
+                       const boost::regex& re_)
 {
-  if (info_t.flag_) {
-    uint32_t min_ = std::move(info_t.begin_date_);
-    uint32_t max_ = std::move(info_t.end_date_);
-    uint32_t ip0_ = std::move(info_t.begin_ip_);
-    uint32_t ip1_ = std::move(info_t.end_ip_);
-
-    auto procRegex_ = [*this, &min_, &max_, &ip0_, &ip1_, &fld_, &t_](
-                        const std::pair<DataKey, DataSet_Squid>& it_) {
-      if ((it_.first.getTs() >= min_) && (it_.first.getTs() <= max_) &&
-          (it_.first.getIp() >= ip0_) && (it_.first.getIp() <= ip1_)) {
-        Visitor::TypeVar tv_ = varType(t_);
-        if (tv_ == TypeVar::TString) {
-          try {
-            boost::regex re_(std::get<std::string>(t_).c_str());
-            boost::smatch smatch_res_;
-            std::string s_ = strFields(fld_, it_.second);
-            if (boost::regex_search(s_, smatch_res_, re_)) {
-              return true;
-            }
+  using Zone = SLPColumnStore::Zone;
+
+  const SLPColumnStore& cols_ = *columns_;
+  const size_t begin_ = cols_.lowerBound(info_t.begin_date_);
+  const size_t end_ = cols_.upperBound(info_t.end_date_);
+  const std::vector<uint32_t>& addrs_ = cols_.addrs();
+  const bool text_ = SLPColumnStore::isText(fld_);
+  const size_t before_ = rows_.size();
+
+  // The rows of the host index, or of the address index if it gives fewer
+  // rows than the time range.
+  const bool byHost_ = fld_ == Fields::ReqURL &&
+                       (cmp_ == Compare::HOST || cmp_ == Compare::DOMAIN) &&
+                       varType(t_) == TypeVar::TString;
+  std::vector<uint32_t> indexRows_;
+  bool indexed_ = byHost_;
+  if (byHost_) {
+    cols_.selectByHost(std::get<std::string>(t_),
+                       cmp_ == Compare::DOMAIN,
+                       begin_,
+                       end_,
+                       indexRows_);
+  } else {
+    indexed_ = cols_.selectByAddr(info_t.ip_, begin_, end_, indexRows_);
+  }
 
-          } catch (boost::regex_error& e_) {
-            std::cout << "SLPQuery::fields() regex error: " << getErrorRE(e_)
-                      << '\n';
+  // The rows are scanned in parts by the threads of the query.
+  auto scan_ = [&](auto&& skip_, auto&& match_) {
+    if (indexed_) {
+      collectRows(
+        0,
+        indexRows_.size(),
+        1,
+        [&](size_t i_, size_t stop_, std::vector<uint32_t>& out_) {
+          for (; i_ < stop_; ++i_) {
+            const uint32_t r_ = indexRows_[i_];
+            if (!skip_(cols_.zones()[r_ / SLPColumnStore::segmentRows]) &&
+                addrDict_->contains(info_t.ip_, addrs_[r_]) && match_(r_)) {
+              out_.push_back(r_);
+            }
           }
-        }
-      }
-      return false;
-    };
+        });
+      return;
+    }
+    collectRows(
+      begin_,
+      end_,
+      SLPColumnStore::segmentRows,
+      [&](size_t from_, size_t to_, std::vector<uint32_t>& out_) {
+        cols_.forSegments(
+          from_, to_, [&](const Zone& z_, size_t r_, size_t stop_) {
+            if (z_.excludes(info_t.ip_) || skip_(z_)) {
+              return;
+            }
+            for (; r_ < stop_; ++r_) {
+              if (addrDict_->contains(info_t.ip_, addrs_[r_]) &&
+                  match_(r_)) {
+                out_.push_back(static_cast<uint32_t>(r_));
+              }
+            }
+          });
+      });
+  };
+  auto none_ = [](const Zone&) { return false; };
+  // Timestamp, CliSrcIpAddr and the integer fields as text.
+  auto str_ = [this, &cols_, fld_](size_t r_) {
+    return strFields(fld_, cols_.row(r_));
+  };
 
-    auto procTypes_ = [*this, &min_, &max_, &ip0_, &ip1_, &fld_, &cmp_, &t_](
-                        const std::pair<DataKey, DataSet_Squid>& it_) {
-      if ((it_.first.getTs() >= min_) && (it_.first.getTs() <= max_) &&
-          (it_.first.getIp() >= ip0_) && (it_.first.getIp() <= ip1_)) {
-        Visitor::TypeVar tv_ = varType(t_);
-        switch (tv_) {
-          case TypeVar::TInt: {
-            return decision(
-              intFields(fld_, it_.second), std::get<int>(t_), cmp_);
-            break;
-          }
-          case TypeVar::TUint: {
-            return decision(
-              uint32Fields(fld_, it_.second), std::get<uint32_t>(t_), cmp_);
-            break;
+  switch (varType(t_)) {
+    case TypeVar::TInt: {
+      const std::vector<int>* col_ = cols_.ints(fld_);
+      const int i_ = SLPColumnStore::intIndex(fld_);
+      const int v_ = std::get<int>(t_);
+      scan_(
+        [i_, v_, cmp_](const Zone& z_) {
+          return i_ >= 0 &&
+                 zoneExcludes(cmp_, z_.minInt_[i_], z_.maxInt_[i_], v_);
+        },
+        [this, col_, v_, cmp_](size_t r_) {
+          return decision(col_ != nullptr ? (*col_)[r_] : -1, v_, cmp_);
+        });
+      break;
+    }
+    case TypeVar::TUint: {
+      const std::vector<uint32_t>* col_ =
+        fld_ == Fields::Timestamp      ? &cols_.timeStamps()
+        : fld_ == Fields::CliSrcIpAddr ? &addrs_
+                                       : nullptr;
+      const uint32_t v_ = std::get<uint32_t>(t_);
+      scan_(
+        [fld_, v_, cmp_](const Zone& z_) {
+          return fld_ == Fields::Timestamp
+                   ? zoneExcludes(cmp_, z_.minTs_, z_.maxTs_, v_)
+                 : fld_ == Fields::CliSrcIpAddr
+                   ? zoneExcludes(cmp_, z_.minAddr_, z_.maxAddr_, v_)
+                   : false;
+        },
+        [this, col_, v_, cmp_](size_t r_) {
+          return decision(col_ != nullptr ? (*col_)[r_] : 0U, v_, cmp_);
+        });
+      break;
+    }
+    case TypeVar::TString: {
+      if (byHost_) {
+        scan_(none_, [](size_t) { return true; });
+        break;
+      }
+      const std::string& v_ = std::get<std::string>(t_);
+      const std::string_view sv_ = v_;
+      auto test_ = [this, &re_, &sv_, cmp_](std::string_view s_) {
+        switch (cmp_) {
+          case Compare::REGEX: {
+            return boost::regex_search(s_.begin(), s_.end(), re_);
           }
-          case TypeVar::TString: {
-            return decision(
-              strFields(fld_, it_.second), std::get<std::string>(t_), cmp_);
+          case Compare::HOST:
+          case Compare::DOMAIN: {
+            return SLPUrlParts::hostMatches(s_, sv_, cmp_ == Compare::DOMAIN);
           }
-          case TypeVar::TLong: {
-            break;
+          default: {
+            return decision(s_, sv_, cmp_);
           }
-        } // switch
+        }
+      };
+      // Looking for "" or "-" in a segment without them.
+      const int ti_ = SLPColumnStore::textIndex(fld_);
+      const bool null_ =
+        ti_ >= 0 && cmp_ == Compare::EQ && SLPColumnStore::isNull(sv_);
+      auto skip_ = [ti_, null_](const Zone& z_) {
+        return null_ && z_.nulls_[ti_] == 0;
+      };
+
+      const SLPDictionary* dict_ = cols_.dictionary(fld_);
+      const std::vector<uint32_t>* codes_ = cols_.codes(fld_);
+      if (dict_ != nullptr &&
+          (cmp_ == Compare::EQ || cmp_ == Compare::NE)) {
+        // Compares codes: a value not in the dictionary is in no row.
+        const uint32_t code_ = dict_->find(sv_);
+        const bool eq_ = cmp_ == Compare::EQ;
+        scan_(skip_, [codes_, code_, eq_](size_t r_) {
+          return ((*codes_)[r_] == code_) == eq_;
+        });
+      } else if (dict_ != nullptr) {
+        // Tests each distinct value once.
+        std::vector<char> hit_(dict_->size());
+        for (uint32_t c_ = 0; c_ < hit_.size(); ++c_) {
+          hit_[c_] = test_(dict_->text(c_));
+        }
+        scan_(skip_,
+              [codes_, &hit_](size_t r_) { return hit_[(*codes_)[r_]] != 0; });
+      } else if (text_) {
+        scan_(skip_, [&](size_t r_) { return test_(cols_.text(fld_, r_)); });
+      } else {
+        scan_(none_, [&](size_t r_) { return test_(str_(r_)); });
       }
-      return false;
-    };
-
-    auto cbegin_ = std::make_move_iterator(mEntry.cbegin());
-    auto cend_ = std::make_move_iterator(mEntry.cend());
-
-    if (cmp_ == Compare::REGEX) {
-      std::copy_if(cbegin_,
-                   cend_,
-                   std::inserter(mSubset_, std::begin(mSubset_)),
-                   procRegex_);
-    } else {
-      std::copy_if(cbegin_,
-                   cend_,
-                   std::inserter(mSubset_, std::begin(mSubset_)),
-                   procTypes_);
+      break;
+    }
+    case TypeVar::TLong: {
+      break;
     }
   }
+  mergeRows(before_);
 }
 
 /*!
@@ -1545,19 +7610,12 @@ SLPQuery::getInt(const std::string&& ts_,
                  Fields fld_) const
 {
   std::vector<int> v_ = {};
-  DataKey dk_(unixTimestamp(ts_), IPv4Addr::iptol(ip_));
+  const std::vector<DataKey> dk_{ DataKey(unixTimestamp(ts_),
+                                          addrToNumeric(ip_)) };
 
-  std::for_each(
-    mSubset_.cbegin(),
-    mSubset_.cend(),
-    [this, &fld_, &dk_, &v_](const std::pair<DataKey, DataSet_Squid>& it_) {
-      if ((it_.first.getTs() == dk_.getTs()) &&
-          (it_.first.getIp() == dk_.getIp())) {
-        v_.push_back(std::move(intFields(fld_, it_.second)));
-        return true;
-      }
-      return false;
-    });
+  forSelectedAt(dk_, [this, &fld_, &v_](size_t, const auto& d_) {
+    v_.push_back(intFields(fld_, d_));
+  });
   return v_;
 }
 
@@ -1574,19 +7632,12 @@ SLPQuery::getUInt(const std::string&& ts_,
                   Fields fld_) const
 {
   std::vector<uint32_t> v_ = {};
-  DataKey dk_(unixTimestamp(ts_), IPv4Addr::iptol(ip_));
+  const std::vector<DataKey> dk_{ DataKey(unixTimestamp(ts_),
+                                          addrToNumeric(ip_)) };
 
-  std::for_each(
-    mSubset_.cbegin(),
-    mSubset_.cend(),
-    [this, &fld_, &dk_, &v_](const std::pair<DataKey, DataSet_Squid>& it_) {
-      if ((it_.first.getTs() == dk_.getTs()) &&
-          (it_.first.getIp() == dk_.getIp())) {
-        v_.push_back(std::move(uint32Fields(fld_, it_.second)));
-        return true;
-      }
-      return false;
-    });
+  forSelectedAt(dk_, [this, &fld_, &v_](size_t, const auto& d_) {
+    v_.push_back(uint32Fields(fld_, d_));
+  });
   return v_;
 }
 
@@ -1603,19 +7654,70 @@ SLPQuery::getStr(const std::string&& ts_,
                  Fields fld_) const
 {
   std::vector<std::string> v_ = {};
-  DataKey dk_(unixTimestamp(ts_), IPv4Addr::iptol(ip_));
+  const std::vector<DataKey> dk_{ DataKey(unixTimestamp(ts_),
+                                          addrToNumeric(ip_)) };
 
-  std::for_each(
-    mSubset_.cbegin(),
-    mSubset_.cend(),
-    [this, &fld_, &dk_, &v_](const std::pair<DataKey, DataSet_Squid>& it_) {
-      if ((it_.first.getTs() == dk_.getTs()) &&
-          (it_.first.getIp() == dk_.getIp())) {
-        v_.push_back(strFields(fld_, it_.second));
-        return true;
-      }
-      return false;
-    });
+  forSelectedAt(dk_, [this, &fld_, &v_](size_t, const auto& d_) {
+    v_.push_back(strFields(fld_, d_));
+  });
+  return v_;
+}
+
+/*!
+ * \brief Batched getInt(): the values of fld_ for each key, in the order of
+ * keys_. The selection is walked once for all the keys, see forSelectedAt().
+ * \param keys_ Timestamp and IP address of each lookup.
+ * \param fld_ enum Fields value.
+ * \return std::vector<std::vector<int>> One vector per key, empty if no entry
+ * selected has that key.
+ *
+ * \code
+ * const SLPQuery::Keys_V keys_ = {
+ *   { "03/Feb/2022:11:39:34", "192.168.1.10" },
+ *   { "03/Feb/2022:11:40:02", "192.168.1.12" }
+ * };
+ * const auto sizes_ = qry->getInt(keys_, Fields::TotalSizeReply);
+ * \endcode
+ */
+std::vector<std::vector<int>>
+SLPQuery::getInt(const Keys_V& keys_, Fields fld_) const
+{
+  std::vector<std::vector<int>> v_(keys_.size());
+  forSelectedAt(dataKeys(keys_), [this, &fld_, &v_](size_t i_, const auto& d_) {
+    v_[i_].push_back(intFields(fld_, d_));
+  });
+  return v_;
+}
+
+/*!
+ * \brief Batched getUInt(), as the batched getInt().
+ * \param keys_ Timestamp and IP address of each lookup.
+ * \param fld_ enum Fields value.
+ * \return std::vector<std::vector<uint32_t>> One vector per key.
+ */
+std::vector<std::vector<uint32_t>>
+SLPQuery::getUInt(const Keys_V& keys_, Fields fld_) const
+{
+  std::vector<std::vector<uint32_t>> v_(keys_.size());
+  forSelectedAt(dataKeys(keys_), [this, &fld_, &v_](size_t i_, const auto& d_) {
+    v_[i_].push_back(uint32Fields(fld_, d_));
+  });
+  return v_;
+}
+
+/*!
+ * \brief Batched getStr(), as the batched getInt().
+ * \param keys_ Timestamp and IP address of each lookup.
+ * \param fld_ enum Fields value.
+ * \return std::vector<std::vector<std::string>> One vector per key.
+ */
+std::vector<std::vector<std::string>>
+SLPQuery::getStr(const Keys_V& keys_, Fields fld_) const
+{
+  std::vector<std::vector<std::string>> v_(keys_.size());
+  forSelectedAt(dataKeys(keys_), [this, &fld_, &v_](size_t i_, const auto& d_) {
+    v_[i_].push_back(strFields(fld_, d_));
+  });
   return v_;
 }
 
@@ -1626,13 +7728,16 @@ SLPQuery::getStr(const std::string&& ts_,
 long
 SLPQuery::sumTotalSizeReply() const
 {
-  return std::accumulate(
-    mSubset_.cbegin(),
-    mSubset_.cend(),
-    0,
-    [](long sum_, const std::pair<DataKey, DataSet_Squid>& d_) {
-      return sum_ + d_.second.totalSizeReply;
-    });
+  const std::vector<long> subset_ =
+    partials<long>(entryRows_.size() + viewRows_.size(),
+                   [this](long& sum_, size_t begin_, size_t end_) {
+                     forSelected(
+                       begin_, end_, [&sum_](const DataKey&, const auto& d_) {
+                         sum_ += d_.totalSizeReply;
+                       });
+                   });
+  return std::accumulate(subset_.begin(), subset_.end(), 0L) +
+         sumColumn(Fields::TotalSizeReply);
 }
 
 /*!
@@ -1643,13 +7748,33 @@ SLPQuery::sumTotalSizeReply() const
 long
 SLPQuery::sumResponseTime() const
 {
-  return std::accumulate(
-    mSubset_.cbegin(),
-    mSubset_.cend(),
-    0,
-    [](long sum_, const std::pair<DataKey, DataSet_Squid>& d_) {
-      return sum_ + d_.second.responseTime;
+  const std::vector<long> subset_ =
+    partials<long>(entryRows_.size() + viewRows_.size(),
+                   [this](long& sum_, size_t begin_, size_t end_) {
+                     forSelected(
+                       begin_, end_, [&sum_](const DataKey&, const auto& d_) {
+                         sum_ += d_.responseTime;
+                       });
+                   });
+  return std::accumulate(subset_.begin(), subset_.end(), 0L) +
+         sumColumn(Fields::ResponseTime);
+}
+
+/*!
+ * \internal
+ * \brief Sum of an integer column over rows_.
+ */
+long
+SLPQuery::sumColumn(Fields fld_) const
+{
+  const std::vector<int>& col_ = *columns_->ints(fld_);
+  const std::vector<long> sums_ = partials<long>(
+    rows_.size(), [this, &col_](long& sum_, size_t i_, size_t end_) {
+      for (; i_ < end_; ++i_) {
+        sum_ += col_[rows_[i_]];
+      }
     });
+  return std::accumulate(sums_.begin(), sums_.end(), 0L);
 }
 
 /*!
@@ -1661,35 +7786,56 @@ SLPQuery::sumResponseTime() const
 SLPQuery::accReqMethods_t
 SLPQuery::countByReqMethod() const
 {
+  using Acc = accReqMethods_t;
+  Acc rm_t_ = {};
+
+  // Same order as MethodType and MethodText_t.
+  int Acc::*const counters_[] = { &Acc::Get,     &Acc::Put,   &Acc::Post,
+                                  &Acc::Connect, &Acc::Head,  &Acc::Delete,
+                                  &Acc::Options, &Acc::Patch, &Acc::Trace };
+  auto count_ = [this, &counters_](Acc& t_, std::string_view m_, int n_) {
+    for (size_t i_ = 0; i_ < std::size(counters_); ++i_) {
+      if (m_ == MethodText_t[i_].sv_) {
+        t_.*counters_[i_] += n_;
+        return;
+      }
+    }
+    t_.Others += n_;
+  };
 
-  accReqMethods_t rm_t_ = {};
-
-  std::for_each(
-    mSubset_.cbegin(),
-    mSubset_.cend(),
-    [this, &rm_t_](const std::pair<DataKey, DataSet_Squid>& d_) {
-      if (d_.second.reqMethod == MethodText(MethodType::MTGet)) {
-        ++rm_t_.Get;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTPut)) {
-        ++rm_t_.Put;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTPost)) {
-        ++rm_t_.Post;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTConnect)) {
-        ++rm_t_.Connect;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTHead)) {
-        ++rm_t_.Head;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTDelete)) {
-        ++rm_t_.Delete;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTOptions)) {
-        ++rm_t_.Options;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTPatch)) {
-        ++rm_t_.Patch;
-      } else if (d_.second.reqMethod == MethodText(MethodType::MTTrace)) {
-        ++rm_t_.Trace;
-      } else {
-        ++rm_t_.Others;
+  // Each part of the selection is counted apart, then added.
+  const std::vector<Acc> parts_ =
+    partials<Acc>(entryRows_.size() + viewRows_.size(),
+                  [this, &count_](Acc& t_, size_t begin_, size_t end_) {
+                    forSelected(begin_,
+                                end_,
+                                [&count_, &t_](const DataKey&, const auto& d_) {
+                                  count_(t_, d_.reqMethod, 1);
+                                });
+                  });
+  for (const Acc& t_ : parts_) {
+    for (int Acc::*const c_ : counters_) {
+      rm_t_.*c_ += t_.*c_;
+    }
+    rm_t_.Others += t_.Others;
+  }
+
+  // StorageMode::Columnar: counts the codes, then names each one once.
+  const SLPDictionary& methods_ = *columns_->dictionary(Fields::ReqMethod);
+  const std::vector<uint32_t>& codes_ = *columns_->codes(Fields::ReqMethod);
+  const std::vector<std::vector<int>> counts_ = partials<std::vector<int>>(
+    rows_.size(),
+    [this, &methods_, &codes_](std::vector<int>& n_, size_t i_, size_t end_) {
+      n_.resize(methods_.size());
+      for (; i_ < end_; ++i_) {
+        ++n_[codes_[rows_[i_]]];
       }
     });
+  for (const std::vector<int>& n_ : counts_) {
+    for (uint32_t c_ = 0; c_ < n_.size(); ++c_) {
+      count_(rm_t_, methods_.text(c_), n_[c_]);
+    }
+  }
   return rm_t_;
 }
 
@@ -1714,35 +7860,86 @@ SLPQuery::countByHttpCodes(const short&& code_)
       HttpCodesUniques_m.insert_or_assign(a.first, 0);
     }
 
-    std::for_each(mSubset_.cbegin(),
-                  mSubset_.cend(),
-                  [&code_, this](const std::pair<DataKey, DataSet_Squid>& d_) {
-                    short c_ = 0;
-                    switch (logFmt_) {
-                      case LogFormat::Common:
-                        [[fallthrough]];
-                      case LogFormat::Combined: {
-                        c_ = std::move(d_.second.httpStatus);
-                        break;
-                      }
-                      default: {
-                        c_ = std::move(std::stoi(
-                          strRight(d_.second.reqStatusHierStatus, '/')));
-                      }
-                    }
+    auto score_ = [&code_, this](short c_, int n_) {
+      if (code_ == 0) { // all
+        if (const auto& it_ = HttpCodesUniques_m.find(c_);
+            it_ != HttpCodesUniques_m.end()) {
+          HttpCodesUniques_m[c_] += n_;
+        }
+      } else if (c_ == code_) {
+        if (const auto& it_ = HttpCodesUniques_m.find(code_);
+            it_ != HttpCodesUniques_m.end()) {
+          HttpCodesUniques_m[code_] += n_;
+        }
+      }
+    };
 
-                    if (code_ == 0) { // all
-                      if (const auto& it_ = HttpCodesUniques_m.find(c_);
-                          it_ != HttpCodesUniques_m.end()) {
-                        HttpCodesUniques_m[c_] += 1;
-                      }
-                    } else if (c_ == code_) {
-                      if (const auto& it_ = HttpCodesUniques_m.find(code_);
-                          it_ != HttpCodesUniques_m.end()) {
-                        HttpCodesUniques_m[code_] += 1;
-                      }
-                    }
-                  });
+    const bool httpStatus_ = logFmt_ == LogFormat::Common ||
+                             logFmt_ == LogFormat::Combined ||
+                             logFmt_ == LogFormat::Custom;
+
+    // Each part of the selection counts the codes on its own map, added to
+    // HttpCodesUniques_m by score_ at the end.
+    using Codes = std::map<short, int>;
+    auto scores_ = [&score_](const std::vector<Codes>& parts_) {
+      for (const Codes& c_ : parts_) {
+        for (const auto& it_ : c_) {
+          score_(it_.first, it_.second);
+        }
+      }
+    };
+    scores_(partials<Codes>(
+      entryRows_.size() + viewRows_.size(),
+      [&httpStatus_, this](Codes& c_, size_t begin_, size_t end_) {
+        forSelected(
+          begin_,
+          end_,
+          [&c_, &httpStatus_, this](const DataKey&, const auto& d_) {
+            ++c_[httpStatus_ ? d_.httpStatus
+                             : std::stoi(strRight(
+                                 std::string(d_.reqStatusHierStatus), '/'))];
+          });
+      }));
+
+    // StorageMode::Columnar. Without the status column, the code is read
+    // once per distinct value of ReqStatusHierStatus, e.g. TCP_MISS/200.
+    if (httpStatus_) {
+      const std::vector<int>& status_ = *columns_->ints(Fields::HttpStatus);
+      scores_(partials<Codes>(
+        rows_.size(), [this, &status_](Codes& c_, size_t i_, size_t end_) {
+          for (; i_ < end_; ++i_) {
+            ++c_[status_[rows_[i_]]];
+          }
+        }));
+    } else {
+      const SLPDictionary& values_ =
+        *columns_->dictionary(Fields::ReqStatusHierStatus);
+      const std::vector<uint32_t>& codes_ =
+        *columns_->codes(Fields::ReqStatusHierStatus);
+      std::vector<int> n_(values_.size());
+      const std::vector<std::vector<int>> counts_ = partials<std::vector<int>>(
+        rows_.size(), [this, &codes_, &n_](std::vector<int>& p_, size_t i_,
+                                           size_t end_) {
+          p_.resize(n_.size());
+          for (; i_ < end_; ++i_) {
+            ++p_[codes_[rows_[i_]]];
+          }
+        });
+      for (const std::vector<int>& p_ : counts_) {
+        std::transform(
+          p_.begin(), p_.end(), n_.begin(), n_.begin(), std::plus<int>());
+      }
+      for (uint32_t v_ = 0; v_ < n_.size(); ++v_) {
+        const std::string_view s_ = values_.text(v_);
+        short c_ = 0;
+        if (const size_t f_ = s_.find('/'); f_ != std::string_view::npos) {
+          std::from_chars(s_.data() + f_ + 1, s_.data() + s_.size(), c_);
+        }
+        if (n_[v_] > 0) {
+          score_(c_, n_[v_]);
+        }
+      }
+    }
   }
 }
 
@@ -1840,24 +8037,52 @@ SLPQuery::countByFiletype(const std::string&& extension_)
       FiletypeUniques_m.insert_or_assign(a.first, 0);
     }
 
-    std::for_each(
-      mSubset_.cbegin(),
-      mSubset_.cend(),
-      [&extension_, this](const std::pair<DataKey, DataSet_Squid>& d_) {
-        const std::string ext_ = getFiletype(std::move(d_.second.reqURL));
+    auto score_ = [&extension_, this](const std::string& ext_, int n_) {
+      if (extension_.empty()) { // all
+        if (const auto& it_ = FiletypeUniques_m.find(ext_);
+            it_ != FiletypeUniques_m.end()) {
+          FiletypeUniques_m[ext_] += n_;
+        }
+      } else if (ext_ == extension_) {
+        if (const auto& it_ = FiletypeUniques_m.find(ext_);
+            it_ != FiletypeUniques_m.end()) {
+          FiletypeUniques_m[ext_] += n_;
+        }
+      }
+    };
 
-        if (extension_.empty()) { // all
-          if (const auto& it_ = FiletypeUniques_m.find(ext_);
-              it_ != FiletypeUniques_m.end()) {
-            FiletypeUniques_m[ext_] += 1;
-          }
-        } else if (ext_ == extension_) {
-          if (const auto& it_ = FiletypeUniques_m.find(ext_);
-              it_ != FiletypeUniques_m.end()) {
-            FiletypeUniques_m[ext_] += 1;
-          }
+    // Each part of the selection counts the extensions on its own map,
+    // added to FiletypeUniques_m by score_ at the end.
+    using Extensions = std::map<std::string, int, std::less<>>;
+    auto count_ = [this](Extensions& e_, std::string_view url_) {
+      const std::string_view ext_ = getFiletypeView(url_);
+      if (const auto it_ = e_.find(ext_); it_ != e_.end()) {
+        ++it_->second;
+      } else {
+        e_.emplace(ext_, 1);
+      }
+    };
+    auto scores_ = [&score_](const std::vector<Extensions>& parts_) {
+      for (const Extensions& e_ : parts_) {
+        for (const auto& it_ : e_) {
+          score_(it_.first, it_.second);
         }
-      });
+      }
+    };
+    scores_(partials<Extensions>(
+      entryRows_.size() + viewRows_.size(),
+      [this, &count_](Extensions& e_, size_t begin_, size_t end_) {
+        forSelected(
+          begin_, end_, [&count_, &e_](const DataKey&, const auto& d_) {
+            count_(e_, d_.reqURL);
+          });
+      }));
+    scores_(partials<Extensions>(
+      rows_.size(), [this, &count_](Extensions& e_, size_t i_, size_t end_) {
+        for (; i_ < end_; ++i_) {
+          count_(e_, columns_->text(Fields::ReqURL, rows_[i_]));
+        }
+      }));
     return (extension_.empty() ? FiletypeUniques_m.size()
                                : FiletypeUniques_m[extension_]);
   }
@@ -1955,22 +8180,24 @@ SLPQuery::MethodText(MethodType mt_) const
 }
 
 /*!
- * \brief Returns the size of mSubset.
+ * \brief Returns the number of entries selected.
  * \return size_t
  */
 size_t
 SLPQuery::size() const
 {
-  return mSubset_.size();
+  return entryRows_.size() + viewRows_.size() + rows_.size();
 }
 
 /*!
- * \brief Clear all values mSubset.
+ * \brief Forgets the entries selected.
  */
 void
 SLPQuery::clear()
 {
-  mSubset_.clear();
+  entryRows_.clear();
+  viewRows_.clear();
+  rows_.clear();
 }
 
 /* SLPUrlParts--------------------------------------------------------------
@@ -2057,6 +8284,101 @@ SLPUrlParts::getFragment() const
   return url_t.fragment_;
 }
 
+/*!
+ * \brief Host of a URL, without the userinfo and the port, as a view into
+ * url_. The URL is split as parseUrl() does, and the URLs without scheme,
+ * e.g. "example.com:443" of CONNECT, are taken as a host. IPv6 literals keep
+ * their brackets.
+ * \return An empty view if url_ has no host, e.g. "/index.html".
+ */
+std::string_view
+SLPUrlParts::host(std::string_view url_)
+{
+  const size_t scheme_ = url_.find("://");
+  if (scheme_ != std::string_view::npos && scheme_ < url_.find('/')) {
+    url_.remove_prefix(scheme_ + 3);
+  } else if (!url_.empty() && url_.front() == '/') {
+    return std::string_view();
+  }
+  url_ = url_.substr(0, url_.find_first_of("/?#"));
+  if (const size_t at_ = url_.rfind('@'); at_ != std::string_view::npos) {
+    url_.remove_prefix(at_ + 1);
+  }
+  if (!url_.empty() && url_.front() == '[') {
+    return url_.substr(0, url_.find(']') + 1);
+  }
+  url_ = url_.substr(0, url_.find(':'));
+  if (!url_.empty() && url_.back() == '.') {
+    url_.remove_suffix(1);
+  }
+  return url_;
+}
+
+/*!
+ * \brief Registrable domain of a host: its last two labels, or three below
+ * the usual second-level labels of a country code, e.g. "example.com.br" or
+ * "example.co.uk". It is an approximation: the Public Suffix List is not
+ * used.
+ * \return host_ itself for an IP address or a host of few labels.
+ */
+std::string_view
+SLPUrlParts::registrableDomain(std::string_view host_)
+{
+  static constexpr std::array<std::string_view, 13> second_ = {
+    "ac", "co", "com", "edu", "go", "gob", "gov",
+    "mil", "ne", "net", "nom", "or", "org"
+  };
+
+  if (host_.empty() || host_.front() == '[' ||
+      std::isdigit(static_cast<unsigned char>(host_.back()))) {
+    return host_;
+  }
+  const size_t tld_ = host_.rfind('.');
+  if (tld_ == std::string_view::npos || tld_ == 0) {
+    return host_;
+  }
+  const size_t sld_ = host_.rfind('.', tld_ - 1);
+  if (sld_ == std::string_view::npos) {
+    return host_;
+  }
+  const std::string_view label_ = host_.substr(sld_ + 1, tld_ - sld_ - 1);
+  if (host_.size() - tld_ - 1 == 2 &&
+      std::find(second_.begin(), second_.end(), label_) != second_.end() &&
+      sld_ > 0) {
+    const size_t third_ = host_.rfind('.', sld_ - 1);
+    return third_ == std::string_view::npos ? host_
+                                            : host_.substr(third_ + 1);
+  }
+  return host_.substr(sld_ + 1);
+}
+
+/*!
+ * \brief True if the host of url_ is host_, or one of its subdomains if
+ * subdomains_ is true. The case is ignored.
+ */
+bool
+SLPUrlParts::hostMatches(std::string_view url_,
+                         std::string_view host_,
+                         bool subdomains_)
+{
+  if (!host_.empty() && host_.back() == '.') {
+    host_.remove_suffix(1);
+  }
+  const std::string_view h_ = host(url_);
+  if (h_.size() < host_.size() || (!subdomains_ && h_.size() != host_.size())) {
+    return false;
+  }
+  const size_t at_ = h_.size() - host_.size();
+  if (at_ > 0 && h_[at_ - 1] != '.') {
+    return false;
+  }
+  return std::equal(
+    host_.begin(), host_.end(), h_.begin() + at_, [](char a_, char b_) {
+      return std::tolower(static_cast<unsigned char>(a_)) ==
+             std::tolower(static_cast<unsigned char>(b_));
+    });
+}
+
 /*!
  * \private
  * \brief Parses URLs (http[s]) the log line.
@@ -2211,11 +8533,18 @@ SLPUrlParts::getUserInfo(size_t& pos_)
  * \brief Constructs a PFRawToXML object.
  * \param log_data_t
  */
-SLPRawToXML::SLPRawToXML(LogFormat fmt_, size_t count_)
+SLPRawToXML::SLPRawToXML(LogFormat fmt_,
+                         size_t count_,
+                         std::shared_ptr<const SLPLogFormat> custom_,
+                         std::shared_ptr<SLPAddrDict> dict_)
   : slpError_(SLPError::SLP_SUCCESS)
   , logFmt_(std::move(fmt_))
   , cnt_(std::move(count_))
 {
+  logFormat_ = std::move(custom_);
+  if (dict_) {
+    addrDict_ = std::move(dict_);
+  }
 }
 
 /*!
@@ -2253,6 +8582,8 @@ SLPRawToXML::save(const std::string fn_)
         return "Referrer";
       case LogFormat::UserAgent:
         return "UserAgent";
+      case LogFormat::Custom:
+        return "Custom";
       default:
         return "None";
     }
@@ -2338,7 +8669,7 @@ SLPRawToXML::writePart()
       data->SetText(ds_squid_.responseTime);
       elem0->InsertEndChild(data);
       data = doc.NewElement("clisrcipaddr");
-      data->SetText(IPv4Addr::ltoip(ds_squid_.cliSrcIpAddr).c_str());
+      data->SetText(addrDict_->text(ds_squid_.cliSrcIpAddr).c_str());
       elem0->InsertEndChild(data);
       data = doc.NewElement("reqstatushierstatus");
       data->SetText(ds_squid_.reqStatusHierStatus.c_str());
@@ -2367,7 +8698,7 @@ SLPRawToXML::writePart()
       [[fallthrough]];
     case LogFormat::Combined: {
       XMLElement* data = doc.NewElement("clisrcpipaddr");
-      data->SetText(IPv4Addr::ltoip(ds_squid_.cliSrcIpAddr).c_str());
+      data->SetText(addrDict_->text(ds_squid_.cliSrcIpAddr).c_str());
       elem0->InsertEndChild(data);
       data = doc.NewElement("usernamefromident");
       data->SetText(ds_squid_.userNameIdent.c_str());
@@ -2411,7 +8742,7 @@ SLPRawToXML::writePart()
       data->SetText(ds_squid_.timeStamp);
       elem0->InsertEndChild(data);
       data = doc.NewElement("clisrcpipaddr");
-      data->SetText(IPv4Addr::ltoip(ds_squid_.cliSrcIpAddr).c_str());
+      data->SetText(addrDict_->text(ds_squid_.cliSrcIpAddr).c_str());
       elem0->InsertEndChild(data);
       data = doc.NewElement("referrer");
       data->SetText(ds_squid_.referrer.c_str());
@@ -2423,7 +8754,7 @@ SLPRawToXML::writePart()
     }
     case LogFormat::UserAgent: {
       XMLElement* data = doc.NewElement("clisrcpipaddr");
-      data->SetText(IPv4Addr::ltoip(ds_squid_.cliSrcIpAddr).c_str());
+      data->SetText(addrDict_->text(ds_squid_.cliSrcIpAddr).c_str());
       elem0->InsertEndChild(data);
       data = doc.NewElement("localtime");
       data->SetText(ds_squid_.localTime.c_str());
@@ -2431,6 +8762,65 @@ SLPRawToXML::writePart()
       data = doc.NewElement("useragent");
       data->SetText(ds_squid_.userAgent.c_str());
       elem0->InsertEndChild(data);
+      break;
+    }
+    case LogFormat::Custom: {
+      if (!logFormat_) {
+        break;
+      }
+      // Same element names as the built-in formats, then the generic columns.
+      constexpr std::pair<Fields, const char*> names_[] = {
+        { Fields::Timestamp, "timestamp" },
+        { Fields::CliSrcIpAddr, "clisrcipaddr" },
+        { Fields::LocalTime, "localtime" },
+        { Fields::UserName, "username" },
+        { Fields::UserNameIdent, "usernamefromident" },
+        { Fields::ResponseTime, "responsetime" },
+        { Fields::ReqMethod, "reqmethod" },
+        { Fields::ReqURL, "requrl" },
+        { Fields::ReqProtoVersion, "reqprotoversion" },
+        { Fields::HttpStatus, "httpstatus" },
+        { Fields::ReqStatusHierStatus, "reqstatushierstatus" },
+        { Fields::TotalSizeReply, "totalsizereply" },
+        { Fields::HierStatusIpAddress, "hierstatusipaddress" },
+        { Fields::MimeContentType, "mimetypecontent" },
+        { Fields::OrigRcvReqHeader, "origrcvreqheader" },
+        { Fields::Referrer, "referrer" },
+        { Fields::UserAgent, "useragent" }
+      };
+      for (const auto& [f_, name_] : names_) {
+        if (!logFormat_->hasField(f_)) {
+          continue;
+        }
+        XMLElement* data = doc.NewElement(name_);
+        switch (f_) {
+          case Fields::Timestamp: {
+            data->SetText(ds_squid_.timeStamp);
+            break;
+          }
+          case Fields::ResponseTime:
+            [[fallthrough]];
+          case Fields::HttpStatus:
+            [[fallthrough]];
+          case Fields::TotalSizeReply: {
+            data->SetText(intFields(f_, ds_squid_));
+            break;
+          }
+          default: {
+            data->SetText(strFields(f_, ds_squid_).c_str());
+          }
+        }
+        elem0->InsertEndChild(data);
+      }
+      for (size_t i_ = 0; i_ < logFormat_->columns().size() &&
+                          i_ < ds_squid_.customFields.size();
+           ++i_) {
+        XMLElement* data = doc.NewElement("custom");
+        data->SetAttribute("code", logFormat_->columns()[i_].c_str());
+        data->SetText(ds_squid_.customFields[i_].c_str());
+        elem0->InsertEndChild(data);
+      }
+      break;
     }
     default: {
       // do nothing
@@ -2502,6 +8892,11 @@ SLPDatabase::SLPDatabase(LogFormat format_,
     return;
   }
 
+  if (logFmt_ == LogFormat::Custom) { // there is no table layout for it.
+    dberror_ = DBError::DBE_ERR_LOGFORMAT;
+    return;
+  }
+
   if (!d_ptr_->dbname_.empty()) {
 
     if (d_ptr_->hname_.empty()) {
@@ -2580,42 +8975,45 @@ SLPDatabase::insert(const std::string& raw_log_)
   try {
     rawLog_.resize(raw_log_.size());
     removeExtraWhiteSpaces(raw_log_, rawLog_);
+    line_ = rawLog_;
     switch (logFmt_) {
       case LogFormat::Squid: {
         if (parserSquid() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
+          unshared(mEntry).insert(
+            { DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
+              ds_squid_ });
         }
         break;
       }
       case LogFormat::Common: {
         if (parserCommon() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(unixTimestamp(ds_squid_.localTime),
-                                  ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
+          unshared(mEntry).insert(
+            { DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
+              ds_squid_ });
         }
         break;
       }
       case LogFormat::Combined: {
         if (parserCombined() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(unixTimestamp(ds_squid_.localTime),
-                                  ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
+          unshared(mEntry).insert(
+            { DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
+              ds_squid_ });
         }
         break;
       }
       case LogFormat::Referrer: {
         if (parserReferrer() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
+          unshared(mEntry).insert(
+            { DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
+              ds_squid_ });
         }
         break;
       }
       case LogFormat::UserAgent: {
         if (parserUserAgent() == SLPError::SLP_SUCCESS) {
-          mEntry.insert({ DataKey(unixTimestamp(ds_squid_.localTime),
-                                  ds_squid_.cliSrcIpAddr),
-                          ds_squid_ });
+          unshared(mEntry).insert(
+            { DataKey(ds_squid_.timeStamp, ds_squid_.cliSrcIpAddr),
+              ds_squid_ });
         }
         break;
       }
@@ -2858,10 +9256,9 @@ SLPDatabase::buidDMLInsertTbl()
       }
       stmt_.erase(stmt_.end() - 1);
 
-      std::string id_month_ =
-        "FROM_UNIXTIME(" +
-        std::to_string(unixTimestamp(getPartStr(Fields::LocalTime))) +
-        ",'%c'),";
+      std::string id_month_ = "FROM_UNIXTIME(" +
+                              std::to_string(getPartUInt(Fields::Timestamp)) +
+                              ",'%c'),";
 
       stmt_ += ") VALUE (";
       stmt_ += id_month_;
@@ -2904,10 +9301,9 @@ SLPDatabase::buidDMLInsertTbl()
       stmt_ += composeStmnt(scm_uagent_a, false);
       stmt_.erase(stmt_.end() - 1);
 
-      std::string id_month_ =
-        "FROM_UNIXTIME(" +
-        std::to_string(unixTimestamp(getPartStr(Fields::LocalTime))) +
-        ",'%c'),";
+      std::string id_month_ = "FROM_UNIXTIME(" +
+                              std::to_string(getPartUInt(Fields::Timestamp)) +
+                              ",'%c'),";
 
       stmt_ += ") VALUE (";
       stmt_ += id_month_;
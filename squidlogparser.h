@@ -43,12 +43,43 @@
  * class IPv4Addr: General handling of IPv4 addresses. It supports the basic
  * operations needed for IPv4 addresses.
  *
+ * class IPv6Addr: Parsing and formatting of IPv6 addresses.
+ *
+ * class SLPAddrDict: 32-bit encoding of the IPv4 and IPv6 client addresses.
+ *
  * template Visitor: Implements Visitor, a helper function for deducing the type
  * of data stored in the variable std::variant.
+ *
+ * class SLPDelimIndex: SIMD (AVX2/SSE4.2, selected at run time) scan that
+ * locates every field delimiter of a buffer.
+ *
+ * class SLPTokenizer: Single-pass, allocation-free field splitter used by the
+ * log format parsers.
+ *
+ * class SLPLineArena: Chunked store that owns the raw lines when the entries
+ * are kept as views (StorageMode::Arena).
+ *
+ * class SLPDictionary: Grow-only table of the distinct values of a text
+ * column, each one numbered by a small integer code.
+ *
+ * class SLPDateDecoder: Fixed-width, cached decoder of the Squid date format.
+ *
+ * class SLPDecompressor: Reads a plain, gzip, xz or zstd log file on its own
+ * thread, one block ahead of the parser.
+ *
+ * class SLPThreadPool: Work-stealing pool of threads shared by the queries.
  * ----------------------------------------------------------------------------
  * struct SquidLogData
+ * class SLPLogFormat
+ * struct SLPFormatDesc, SLPRecord and class SquidLogParserT: Compile-time
+ * descriptions of the built-in formats and the parsers generated from them.
+ * class SLPSnapshot: Versioned, checksummed binary file of the columns, read
+ * through a memory map.
+ * class SLPColumnStore: Column-oriented store used by StorageMode::Columnar.
  * class DataKey
  * class SquidLogParser
+ * class SLPExpr: Condition of SLPQuery::where(), a tree of comparisons
+ * combined with AND, OR and NOT.
  * class SLPQuery
  * class SLPUrlParts
  * class SLPRawToXML
@@ -62,22 +93,29 @@
 #include <algorithm>
 #include <arpa/inet.h> // inet_pton()
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <charconv> // std::from_chars()
 #include <chrono>
 #include <climits> // INT_MAX, LONG_MAX, UINT_MAX, ...
 #include <cmath>   // std::isless(), std::isgreater(), ...
+#include <condition_variable>
 #include <csignal>
 #include <cstddef> // size_t
 #include <cstdint>
 #include <cstring>
 #include <ctime>
+#include <deque>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iomanip> // std::setw()
 #include <iostream>
 #include <iterator> // std::back_inserter() ...
 #include <map>
 #include <memory>
+#include <mutex>
 #include <numeric> // accumulate
 #include <regex>
 #include <set>
@@ -89,6 +127,7 @@
 #include <unordered_map>
 #include <utility>
 #include <variant>
+#include <vector>
 
 namespace fsys = std::filesystem; // Do Not Change!
 
@@ -128,37 +167,136 @@ using namespace tinyxml2; // mandatory
 
 namespace squidlogparser {
 
+class SLPSnapshot;
+
 /* Utilities---------------------------------------------------------------- */
 
 /*!
  * \brief General handling of IPv4 addresses. It supports the basic operations
  * needed for IPv4 addresses.
+ *
+ * parse() and format() are the allocation-free counterparts of iptol() and
+ * ltoip(), meant for code that converts an address per log line.
+ *
+ * \code
+ * uint32_t n_ = 0;
+ * if (IPv4Addr::parse("192.168.1.110", n_)) {
+ *   IPv4Addr::Buffer buf_;
+ *   std::string_view s_ = IPv4Addr::format(n_, buf_); // "192.168.1.110"
+ * }
+ * \endcode
  */
 class SquidLogParser_EXPORT IPv4Addr
 {
 public:
+  using Buffer = std::array<char, 16>; // "255.255.255.255" + '\0'
+
   explicit IPv4Addr();
   explicit IPv4Addr(const std::string addr_);
   explicit IPv4Addr(const char* addr_);
 
-  inline std::string getAddr() const;
-  inline uint32_t getInt() const;
+  std::string getAddr() const;
+  uint32_t getInt() const;
 
   static bool isValid(const std::string addr_);
   static uint32_t iptol(const std::string addr_);
-  inline static std::string ltoip(uint32_t addr_);
+  static std::string ltoip(uint32_t addr_);
+
+  static bool parse(std::string_view s_, uint32_t& addr_);
+  static std::string_view format(uint32_t addr_, Buffer& buf_);
 
   IPv4Addr& operator=(const IPv4Addr& rhs_);
-  inline bool operator>(const IPv4Addr& rhs_) const;
-  inline bool operator<(const IPv4Addr& rhs_) const;
-  inline bool operator==(const IPv4Addr& rhs_) const;
-  inline bool operator!=(const IPv4Addr& rhs_) const;
+  bool operator>(const IPv4Addr& rhs_) const { return num_ > rhs_.num_; }
+  bool operator<(const IPv4Addr& rhs_) const { return num_ < rhs_.num_; }
+  bool operator==(const IPv4Addr& rhs_) const { return num_ == rhs_.num_; }
+  bool operator!=(const IPv4Addr& rhs_) const { return num_ != rhs_.num_; }
 
 private:
   std::string str_;
   uint32_t num_;
+};
+
+/*!
+ * \brief Parsing and formatting of IPv6 addresses, allocation-free as in
+ * IPv4Addr::parse() and IPv4Addr::format().
+ *
+ * \code
+ * IPv6Addr::Bytes a_;
+ * if (IPv6Addr::parse("2001:DB8:0:0:0:0:0:1", a_)) {
+ *   IPv6Addr::Buffer buf_;
+ *   std::string_view s_ = IPv6Addr::format(a_, buf_); // "2001:db8::1"
+ * }
+ * \endcode
+ */
+class SquidLogParser_EXPORT IPv6Addr
+{
+public:
+  using Bytes = std::array<uint8_t, 16>; // network byte order
+  using Buffer = std::array<char, 46>;   // INET6_ADDRSTRLEN
+
+  static bool parse(std::string_view s_, Bytes& addr_);
+  static std::string_view format(const Bytes& addr_, Buffer& buf_);
+
+  static Bytes fromIPv4(uint32_t addr_);
+  static bool toIPv4(const Bytes& addr_, uint32_t& v4_);
+};
+
+/*!
+ * \brief Encodes the client addresses in 32 bits.
+ *
+ * IPv4 addresses keep their numeric value. Each distinct IPv6 address gets
+ * an id from 1 to maxId, i.e. a value in 0.0.0.0/8, a range that is not a
+ * valid client source address; IPv4-mapped IPv6 addresses are stored as the
+ * IPv4 address they carry. So a log with only IPv4 clients costs nothing
+ * more than before, and 0 still means "invalid address".
+ */
+class SquidLogParser_EXPORT SLPAddrDict
+{
+public:
+  static constexpr uint32_t maxId = 0x00FFFFFF;
+
+  /*!
+   * \brief Closed range of addresses, ordered as IPv6 addresses (the IPv4
+   * ones as ::ffff:a.b.c.d). Built by range().
+   */
+  struct Range
+  {
+    IPv6Addr::Bytes lo_ = {};
+    IPv6Addr::Bytes hi_ = {};
+    uint32_t lo4_ = 0;
+    uint32_t hi4_ = 0;
+    bool v4_ = false; // both ends are IPv4
+  };
+
+  static bool isId(uint32_t code_) { return code_ != 0 && code_ <= maxId; }
+
+  uint32_t encode(std::string_view s_);
+  uint32_t import(const SLPAddrDict& from_, uint32_t code_);
+  uint32_t find(std::string_view s_) const;
+  bool decode(uint32_t code_, IPv6Addr::Bytes& addr_) const;
+  std::string text(uint32_t code_) const;
+
+  static bool range(std::string_view lo_, std::string_view hi_, Range& r_);
+  bool contains(const Range& r_, uint32_t code_) const;
+
+  size_t size() const { return addrs_.size(); }
+  size_t bytes() const;
+  void clear();
 
-  static void splitP(std::array<std::string, 4>& arr_, const std::string src_);
+  void save(SLPSnapshot& out_) const;
+  bool load(SLPSnapshot& in_);
+
+private:
+  struct Hash
+  {
+    size_t operator()(const IPv6Addr::Bytes& a_) const;
+  };
+
+  std::unordered_map<IPv6Addr::Bytes, uint32_t, Hash> ids_;
+  std::vector<IPv6Addr::Bytes> addrs_; // addrs_[id - 1]
+
+  static uint32_t fromIPv4(uint32_t v4_);
+  uint32_t add(const IPv6Addr::Bytes& a_);
 };
 
 /* ------------------------------------------------------------------------- */
@@ -190,6 +328,526 @@ public:
   TypeVar varType(var_t t_) const;
 };
 
+/* ------------------------------------------------------------------------- */
+/*!
+ * \internal
+ * \brief Finds every field delimiter of a buffer in a single sweep and stores
+ * their offsets in ascending order.
+ *
+ * The delimiters are the white spaces ('\t' to '\r' and ' '), '"', '[', ']'
+ * and '\', i.e. every character at which SLPTokenizer may have to stop. The
+ * buffer is scanned 32 (AVX2) or 16 (SSE4.2) bytes at a time; the kernel is
+ * selected at run time according to the CPU, with a portable scalar loop as
+ * the fallback. Offsets are 32 bits wide, so a single call must not be handed
+ * more than 4GiB.
+ */
+class SquidLogParser_EXPORT SLPDelimIndex
+{
+public:
+  enum class Kernel
+  {
+    Scalar = 0x00,
+    SSE42,
+    AVX2
+  };
+
+  explicit SLPDelimIndex(Kernel kernel_ = bestKernel());
+
+  size_t build(const char* buf_, size_t len_);
+
+  const uint32_t* begin() const { return pos_.data(); }
+  const uint32_t* end() const { return pos_.data() + size_; }
+  size_t size() const { return size_; }
+  Kernel kernel() const { return kernel_; }
+
+  static Kernel bestKernel();
+  static bool isDelimiter(const char c_)
+  {
+    return c_ == ' ' || (c_ >= '\t' && c_ <= '\r') || c_ == '"' ||
+           (c_ >= '[' && c_ <= ']');
+  }
+
+private:
+  Kernel kernel_;
+  std::vector<uint32_t> pos_;
+  size_t size_;
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \internal
+ * \brief Single-pass, allocation-free field splitter for a log line.
+ *
+ * Fields are handed out as std::string_view into the line being scanned, so
+ * the caller decides when (and if) the bytes are copied. Runs of white spaces
+ * count as a single separator, so the line does not need to be normalized by
+ * removeExtraWhiteSpaces() beforehand.
+ *
+ * When an SLPDelimIndex of the line is supplied, the end of a field is found
+ * by walking the delimiter offsets instead of every character of the field.
+ */
+class SquidLogParser_EXPORT SLPTokenizer
+{
+public:
+  explicit SLPTokenizer(std::string_view line_)
+    : SLPTokenizer(line_, nullptr, nullptr, nullptr)
+  {
+  }
+
+  /*!
+   * \param line_ The text to be split.
+   * \param origin_ Address to which the offsets of the index are relative.
+   * \param first_ First offset of the SLPDelimIndex that covers line_.
+   * \param last_ One past the last offset.
+   */
+  SLPTokenizer(std::string_view line_,
+               const char* origin_,
+               const uint32_t* first_,
+               const uint32_t* last_)
+    : pos_(line_.data())
+    , end_(line_.data() + line_.size())
+    , base_(origin_)
+    , delimBegin_(first_)
+    , delim_(first_)
+    , delimEnd_(last_)
+  {
+  }
+
+  /*!
+   * \brief Returns a tokenizer for inner_, which must be a part of the line,
+   * sharing the same delimiter index.
+   */
+  SLPTokenizer sub(std::string_view inner_) const
+  {
+    if (delimBegin_ == nullptr) {
+      return SLPTokenizer(inner_);
+    }
+    const uint32_t from_ = static_cast<uint32_t>(inner_.data() - base_);
+    return SLPTokenizer(inner_,
+                        base_,
+                        std::lower_bound(delimBegin_, delimEnd_, from_),
+                        delimEnd_);
+  }
+
+  /*!
+   * \brief Returns the next white space delimited field.
+   * \param field_ Receives the field.
+   * \return false if there are no more fields.
+   */
+  bool next(std::string_view& field_)
+  {
+    skipSpaces();
+    if (pos_ == end_) {
+      return false;
+    }
+    const char* begin_ = pos_;
+    pos_ = seek(pos_, [](const char c_) { return isSpace(c_); });
+    field_ = std::string_view(begin_, pos_ - begin_);
+    return true;
+  }
+
+  /*!
+   * \brief Returns everything after the current field, without the trailing
+   * white spaces. Equivalent to the '(.*)$' group of the regular expressions.
+   * \param field_ Receives the remainder (may be empty).
+   * \return false if the last field was not followed by a separator.
+   */
+  bool rest(std::string_view& field_)
+  {
+    if (pos_ == end_) {
+      return false;
+    }
+    skipSpaces();
+    const char* last_ = end_;
+    while (last_ != pos_ && isSpace(*(last_ - 1))) {
+      --last_;
+    }
+    field_ = std::string_view(pos_, last_ - pos_);
+    pos_ = end_;
+    return true;
+  }
+
+  /*!
+   * \brief Returns the contents of the next "[...]" group, e.g. [%tl].
+   * \param field_ Receives the text between the brackets.
+   * \return false if the next field is not enclosed in brackets.
+   */
+  bool bracketed(std::string_view& field_)
+  {
+    skipSpaces();
+    if (pos_ == end_ || *pos_ != '[') {
+      return false;
+    }
+    const char* begin_ = ++pos_;
+    pos_ = seek(pos_, [](const char c_) { return c_ == ']'; });
+    if (pos_ == end_) {
+      return false;
+    }
+    field_ = std::string_view(begin_, pos_ - begin_);
+    ++pos_;
+    return true;
+  }
+
+  /*!
+   * \brief Returns the contents of the next quoted field, e.g.
+   * "%{User-Agent}>h". A backslash escapes the next character, so \" does
+   * not close the field. Escape sequences are returned as they are.
+   * \param field_ Receives the text between the quotes.
+   * \return false if the next field is not quoted or if it is not closed.
+   */
+  bool quoted(std::string_view& field_)
+  {
+    skipSpaces();
+    if (pos_ == end_ || *pos_ != '"') {
+      return false;
+    }
+    const char* begin_ = ++pos_;
+    for (;;) {
+      pos_ = seek(pos_, [](const char c_) { return c_ == '"' || c_ == '\\'; });
+      if (pos_ == end_ || *pos_ == '"') {
+        break;
+      }
+      pos_ += (pos_ + 1 != end_) ? 2 : 1; // skips the escaped character
+    }
+    if (pos_ == end_) {
+      return false;
+    }
+    field_ = std::string_view(begin_, pos_ - begin_);
+    ++pos_;
+    return true;
+  }
+
+  /*!
+   * \brief Returns true if only white spaces are left.
+   */
+  bool atEnd()
+  {
+    skipSpaces();
+    return pos_ == end_;
+  }
+
+  /*!
+   * \brief Converts the leading digits of s_ to a number, the same way
+   * std::stoi() does, but without allocating or throwing.
+   * \return false if s_ does not start with a number or if it overflows.
+   */
+  template<typename TNum>
+  static bool toNumber(std::string_view s_, TNum& n_)
+  {
+    const char* first_ = s_.data();
+    const char* last_ = first_ + s_.size();
+    if (first_ != last_ && *first_ == '+') {
+      ++first_;
+    }
+    return std::from_chars(first_, last_, n_).ec == std::errc();
+  }
+
+  /*!
+   * \brief Converts a dotted-decimal IPv4 address to its numeric form.
+   * \see IPv4Addr::parse()
+   * \return false if s_ is not a valid IPv4 address.
+   */
+  static bool toIPv4(std::string_view s_, uint32_t& addr_)
+  {
+    return IPv4Addr::parse(s_, addr_);
+  }
+
+private:
+  const char* pos_;
+  const char* end_;
+  const char* base_;
+  const uint32_t* delimBegin_;
+  const uint32_t* delim_;
+  const uint32_t* delimEnd_;
+
+  static bool isSpace(const char c_)
+  {
+    return c_ == ' ' || (c_ >= '\t' && c_ <= '\r');
+  }
+
+  void skipSpaces()
+  {
+    while (pos_ != end_ && isSpace(*pos_)) {
+      ++pos_;
+    }
+  }
+
+  /*!
+   * \internal
+   * \brief Returns the first character at or after from_ for which pred_ is
+   * true, or end_. pred_ must only accept delimiters (see SLPDelimIndex).
+   */
+  template<typename TPred>
+  const char* seek(const char* from_, TPred pred_)
+  {
+    if (delim_ == nullptr) {
+      while (from_ != end_ && !pred_(*from_)) {
+        ++from_;
+      }
+      return from_;
+    }
+    while (delim_ != delimEnd_ && base_ + *delim_ < from_) {
+      ++delim_;
+    }
+    for (const uint32_t* d_ = delim_; d_ != delimEnd_; ++d_) {
+      const char* p_ = base_ + *d_;
+      if (p_ >= end_) {
+        break;
+      }
+      if (pred_(*p_)) {
+        return p_;
+      }
+    }
+    return end_;
+  }
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief Append-only store for the bytes of the log lines.
+ *
+ * Lines are copied back to back into fixed size chunks. A chunk is never
+ * moved or resized once allocated, so the std::string_view returned by
+ * store() stays valid until clear(), until releaseUnused() frees its chunk or
+ * until the arena is destroyed. Lines larger than a chunk get a chunk of
+ * their own.
+ */
+class SquidLogParser_EXPORT SLPLineArena
+{
+public:
+  static constexpr size_t defaultChunkSize = 1 << 20; // 1MiB
+
+  explicit SLPLineArena(size_t chunk_size_ = defaultChunkSize);
+
+  std::string_view store(std::string_view line_);
+  void release(std::string_view last_);
+  void adopt(SLPLineArena& other_);
+  size_t releaseUnused(std::vector<const char*> live_);
+  void clear();
+
+  size_t bytes() const { return bytes_; }
+  size_t capacity() const { return capacity_; }
+  size_t chunks() const { return chunks_.size(); }
+
+private:
+  struct Chunk
+  {
+    std::unique_ptr<char[]> data_;
+    size_t size_;
+    size_t used_;
+  };
+
+  size_t chunkSize_;
+  std::vector<Chunk> chunks_;
+  char* head_;
+  size_t room_;
+  size_t bytes_;
+  size_t capacity_;
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief Grow-only dictionary of the values of a text column.
+ *
+ * Each distinct value gets the next code, starting at 0, and keeps it: values
+ * are never removed, so the codes already stored stay valid. A dictionary
+ * built by another thread is added with merge(), which returns how its codes
+ * map to the codes of this one.
+ *
+ * \code
+ * SLPDictionary d_;
+ * uint32_t get_ = d_.encode("GET");  // 0
+ * uint32_t post_ = d_.encode("POST"); // 1
+ * d_.find("GET");                     // 0
+ * d_.find("PUT");                     // SLPDictionary::npos
+ * d_.text(post_);                     // "POST"
+ * \endcode
+ */
+class SquidLogParser_EXPORT SLPDictionary
+{
+public:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  SLPDictionary() = default;
+  SLPDictionary(const SLPDictionary& other_);
+  SLPDictionary& operator=(const SLPDictionary& other_);
+
+  uint32_t encode(std::string_view s_);
+  uint32_t find(std::string_view s_) const;
+  std::string_view text(uint32_t code_) const { return values_[code_]; }
+  std::vector<uint32_t> merge(const SLPDictionary& from_);
+
+  size_t size() const { return values_.size(); }
+  size_t bytes() const;
+
+  void save(SLPSnapshot& out_) const;
+  bool load(SLPSnapshot& in_);
+
+private:
+  std::deque<std::string> values_; // never relocated: codes_ points into it
+  std::unordered_map<std::string_view, uint32_t> codes_;
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief Converts the Squid date format (%tl), dd/Mmm/yyyy:hh:mm:ss +zzzz, to
+ * a Unix timestamp.
+ *
+ * The fields are read at fixed positions with integer arithmetic. The epoch
+ * of the last day decoded is cached, so the consecutive lines of a log only
+ * cost the time of the day and the UTC offset. Without the offset the date
+ * is taken as local time, as std::mktime() does.
+ *
+ * \code
+ * SLPDateDecoder dec_;
+ * uint32_t ts_ = dec_.decode("31/Jan/2022:21:00:00 -0300"); // 1643673600
+ * \endcode
+ */
+class SquidLogParser_EXPORT SLPDateDecoder
+{
+public:
+  SLPDateDecoder();
+
+  uint32_t decode(std::string_view d_);
+
+  static int monthNumber(std::string_view m_);
+  static int64_t daysFromCivil(int y_, int m_, int d_);
+
+private:
+  std::array<char, 11> day_; // dd/Mmm/yyyy of dayEpoch_
+  int64_t dayEpoch_;         // 00:00:00 UTC of day_
+
+  static bool digits(std::string_view s_, size_t pos_, size_t n_, int& v_);
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief Reads a log file in blocks, decompressing it when needed. The
+ * compression is detected by the magic bytes of the file, not by its name.
+ *
+ * A thread reads and decompresses the file into a small ring of blocks while
+ * the caller parses the previous ones. gzip, xz and zstd are only available
+ * when the library was built with ZLIB_EXTENSION, LZMA_EXTENSION and
+ * ZSTD_EXTENSION (see CMakeLists.txt).
+ *
+ * \code
+ * SLPDecompressor in_("access.log.1.gz");
+ * for (std::string_view b_ = in_.next(); !b_.empty(); b_ = in_.next()) {
+ *   parser_.appendBuffer(b_.data(), b_.size());
+ * }
+ * parser_.flush();
+ * \endcode
+ */
+class SquidLogParser_EXPORT SLPDecompressor
+{
+public:
+  enum class Codec : uint8_t
+  {
+    None = 0x00,
+    Gzip,
+    Xz,
+    Zstd
+  };
+
+  static constexpr size_t defaultBlockSize = 1 << 20; // 1MiB
+  static constexpr size_t defaultBlocks = 4;
+
+  explicit SLPDecompressor(const std::string& path_,
+                           size_t block_size_ = defaultBlockSize,
+                           size_t blocks_ = defaultBlocks);
+  ~SLPDecompressor();
+
+  SLPDecompressor(const SLPDecompressor&) = delete;
+  SLPDecompressor& operator=(const SLPDecompressor&) = delete;
+
+  std::string_view next();
+
+  Codec codec() const { return codec_; }
+  bool failed() const;
+
+  static Codec detect(const unsigned char* p_, size_t n_);
+  static bool supported(Codec c_);
+
+private:
+  struct Block
+  {
+    std::unique_ptr<char[]> data_;
+    size_t size_;
+  };
+
+  std::ifstream file_;
+  Codec codec_;
+  size_t blockSize_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Block> free_;
+  std::deque<Block> full_;
+  Block current_; // returned by the last next()
+  bool done_;     // the thread has queued every block
+  bool stop_;
+  bool failed_;
+  std::thread worker_;
+
+  void run();
+};
+
+/*!
+ * \brief Work-stealing pool of threads, shared by the SLPQuery objects to
+ * scan and count their entries in parallel.
+ *
+ * Each worker has its own queue of tasks: it runs them from the back and,
+ * when it is empty, steals from the front of the queues of the others.
+ * run() calls a function for each part of a job on up to threads_ threads,
+ * the caller's included, which take the parts in order until none is left.
+ *
+ * \code
+ * std::vector<long> sums_(parts_);
+ * SLPThreadPool::shared().run(parts_, 0, [&](size_t i_) {
+ *   sums_[i_] = sumOfPart(i_);
+ * });
+ * \endcode
+ */
+class SquidLogParser_EXPORT SLPThreadPool
+{
+public:
+  explicit SLPThreadPool(unsigned threads_ = 0);
+  ~SLPThreadPool();
+
+  SLPThreadPool(const SLPThreadPool&) = delete;
+  SLPThreadPool& operator=(const SLPThreadPool&) = delete;
+
+  static SLPThreadPool& shared();
+  static unsigned concurrency(unsigned threads_) noexcept;
+
+  void run(size_t parts_,
+           unsigned threads_,
+           const std::function<void(size_t)>& f_);
+
+  size_t size() const noexcept { return workers_.size() + 1; }
+
+private:
+  using Task = std::function<void()>;
+
+  struct Queue
+  {
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues_; // one per worker
+  std::vector<std::thread> workers_;
+  std::mutex mutex_; // guards pending_ and stop_
+  std::condition_variable wake_;
+  size_t pending_; // tasks queued, not yet taken
+  size_t next_;    // queue of the next task pushed
+  bool stop_;
+
+  void push(Task&& task_);
+  bool pop(size_t self_, Task& task_);
+  void work(size_t self_);
+};
+
 /* ------------------------------------------------------------------------- */
 
 /*!
@@ -231,7 +889,8 @@ struct SquidLogParser_EXPORT SquidLogData
     Combined,
     Referrer,
     UserAgent,
-    Unknown
+    Unknown,
+    Custom // compiled from a logformat directive, see SLPLogFormat
   };
 
   // --------------------------------------------------------------------------
@@ -300,6 +959,40 @@ struct SquidLogParser_EXPORT SquidLogData
 
     std::string referrer = {};
     std::string userAgent = {};
+
+    std::vector<std::string> customFields = {}; // LogFormat::Custom only
+  };
+
+  /*!
+   * \brief Counterpart of DataSet_Squid used with StorageMode::Arena. The
+   * text fields are views into the line kept by SLPLineArena, so storing an
+   * entry does not allocate anything besides its node.
+   *
+   * \warning Keep the members in the same order as DataSet_Squid.
+   */
+  struct DataSet_View
+  {
+    uint32_t timeStamp = 0;
+    uint32_t cliSrcIpAddr = 0;
+    std::string_view localTime = {};
+    std::string_view userName = {};
+    std::string_view userNameIdent = {};
+    int responseTime = 0;
+
+    std::string_view reqMethod = {};
+    std::string_view reqURL = {};
+    std::string_view reqProtoVersion = {};
+    int httpStatus = 0;
+    std::string_view reqStatusHierStatus = {};
+
+    int totalSizeReply = 0;
+
+    std::string_view hierStatusIpAddress = {};
+    std::string_view mimeTypeContent = {};
+    std::string_view origRcvReqHeader = {};
+
+    std::string_view referrer = {};
+    std::string_view userAgent = {};
   };
 
   // --------------------------------------------------------------------------
@@ -407,11 +1100,45 @@ struct SquidLogParser_EXPORT SquidLogData
     NE,
     BTWAND,
     BTWOR,
-    REGEX
+    REGEX,
+    HOST,  // the host of the URL is the value, e.g. "www.example.com"
+    DOMAIN // the host is the value or one of its subdomains
   };
 
   // --------------------------------------------------------------------------
-  enum class FormatDB
+  /*!
+   * \brief The ParserMode enum
+   *
+   * Tokenizer: Hand-written single-pass field splitter (default).
+   * Regex: The original boost::regex expressions. Slower, kept as a fallback
+   * and to validate the output of the tokenizer.
+   */
+  enum class ParserMode
+  {
+    Tokenizer = 0x00,
+    Regex
+  };
+
+  // --------------------------------------------------------------------------
+  /*!
+   * \brief The StorageMode enum
+   *
+   * Copy: Each entry is a DataSet_Squid that owns its strings (default).
+   * Arena: The raw line is kept in an SLPLineArena and the entry is a
+   * DataSet_View into it. Only for the built-in formats parsed by the
+   * tokenizer; the other cases are stored as in Copy.
+   * Columnar: The entries are the rows of an SLPColumnStore, one contiguous
+   * column per field. Same restrictions as Arena.
+   */
+  enum class StorageMode
+  {
+    Copy = 0x00,
+    Arena,
+    Columnar
+  };
+
+  // --------------------------------------------------------------------------
+  enum class FormatDB
   {
     UniqueField = 0x00,
     SepFields
@@ -469,6 +1196,14 @@ struct SquidLogParser_EXPORT SquidLogData
     SLP_ERR_REGEX_BADREPEAT,
     SLP_ERR_REGEX_COMPLEXITY,
     SLP_ERR_REGEX_STACK,
+    SLP_ERR_INVALID_LOGFORMAT,
+    SLP_ERR_LOG_FILE_NOT_READ,
+    SLP_ERR_UNSUPPORTED_COMPRESSION,
+    SLP_ERR_SPILL_FILE_NOT_OPEN,
+    SLP_ERR_SNAPSHOT_NOT_SAVED,
+    SLP_ERR_SNAPSHOT_NOT_READ,
+    SLP_ERR_SNAPSHOT_INVALID,
+    SLP_ERR_INVALID_EXPR,
     SLP_ERR_UNKNOWN = 0xff,
   };
 
@@ -516,11 +1251,1009 @@ struct SquidLogParser_EXPORT SquidLogData
       "The complexity of an attempted match exceeded a predefined level." },
     { SLPError::SLP_ERR_REGEX_STACK,
       "There was not enough memory to perform a match." },
+    { SLPError::SLP_ERR_INVALID_LOGFORMAT,
+      "The logformat directive could not be compiled." },
+    { SLPError::SLP_ERR_LOG_FILE_NOT_READ, "The log file cannot be read." },
+    { SLPError::SLP_ERR_UNSUPPORTED_COMPRESSION,
+      "The log file compression is not enabled in this build." },
+    { SLPError::SLP_ERR_SPILL_FILE_NOT_OPEN,
+      "The spill file cannot be opened for writing." },
+    { SLPError::SLP_ERR_SNAPSHOT_NOT_SAVED,
+      "The snapshot file cannot be saved." },
+    { SLPError::SLP_ERR_SNAPSHOT_NOT_READ,
+      "The snapshot file cannot be read." },
+    { SLPError::SLP_ERR_SNAPSHOT_INVALID,
+      "The snapshot file is damaged, of another version or of another log "
+      "format." },
+    { SLPError::SLP_ERR_INVALID_EXPR,
+      "The expression has an invalid regex or an IN list of mixed types." },
 
     { SLPError::SLP_ERR_UNKNOWN, "Unknown Error." }
   };
 };
 
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief Compiles a squid.conf 'logformat' directive into a parse program.
+ *
+ * The format is compiled once into a table of steps (white space, literal
+ * text, field) that is run for every line without regular expressions. The
+ * format codes that have a counterpart in DataSet_Squid are stored there, any
+ * other code becomes a generic string column of DataSet_Squid::customFields,
+ * in the order given by columns().
+ *
+ * \code
+ * SLPLogFormat lf_("logformat proxy %ts.%03tu %6tr %>a %Ss/%03>Hs %<st %rm "
+ *                  "%ru %[un %Sh/%<a %mt %>ha %<tt %ssl::>sni");
+ * SquidLogParser slp_(lf_);
+ * \endcode
+ *
+ * \note %Ss and %Sh store the whole group they start, e.g. "%Ss/%03>Hs"
+ * stores "TCP_MISS/200" in reqStatusHierStatus, like the built-in formats.
+ */
+class SquidLogParser_EXPORT SLPLogFormat
+{
+public:
+  explicit SLPLogFormat(const std::string& fmt_);
+
+  bool isValid() const;
+  const std::string& name() const;
+  const std::vector<std::string>& columns() const;
+  int column(std::string_view code_) const;
+  bool hasField(SquidLogData::Fields f_) const;
+
+  bool parse(std::string_view line_,
+             SquidLogData::DataSet_Squid& ds_,
+             SLPAddrDict* dict_ = nullptr) const;
+
+private:
+  enum class OpCode : uint8_t
+  {
+    Blank = 0x00, // one or more white spaces
+    Literal,      // text that must match exactly
+    Field         // a value, up to the stop condition
+  };
+
+  enum class Stop : uint8_t
+  {
+    Blank = 0x00, // next white space
+    Char,         // next stopChar_
+    Quote,        // next '"' not escaped by a backslash
+    End           // end of line
+  };
+
+  enum class Kind : uint8_t
+  {
+    Str = 0x00,
+    Int,
+    UInt,
+    IPv4,
+    Group, // stores the text of the whole group, see %Ss and %Sh
+    Skip   // known code without column, e.g. %tu
+  };
+
+  struct Step
+  {
+    OpCode op_ = OpCode::Literal;
+    Stop stop_ = Stop::End;
+    Kind kind_ = Kind::Str;
+    char stopChar_ = 0;
+    SquidLogData::Fields field_ = SquidLogData::Fields::Unknown;
+    size_t column_ = 0;
+    std::string literal_ = {};
+  };
+
+  std::string name_;
+  std::vector<Step> steps_;
+  std::vector<std::string> columns_;
+  uint32_t fields_; // bit mask of the SquidLogData::Fields present
+  bool valid_;
+
+  bool compile(std::string_view fmt_);
+  void addLiteral(std::string_view lit_);
+  static size_t codeLength(std::string_view s_);
+  static bool store(const Step& step_,
+                    std::string_view value_,
+                    SquidLogData::DataSet_Squid& ds_,
+                    SLPAddrDict* dict_);
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief How a column of a built-in format is delimited in the line.
+ */
+enum class SLPColumnTok : uint8_t
+{
+  Word = 0x00, // up to the next white space
+  Rest,        // up to the end of the line, see SLPTokenizer::rest()
+  Bracketed,   // [...]
+  Quoted,      // "..." with backslash escapes
+  ReqMethod,   // first word of the quoted request "%rm %ru HTTP/%rv"
+  ReqNext,     // next word of the request
+  ReqLast      // last word of the request, nothing may follow it
+};
+
+/*!
+ * \brief How the text of a column is converted.
+ */
+enum class SLPColumnConv : uint8_t
+{
+  Text = 0x00, // std::string_view into the line
+  Int,         // must be a number
+  UInt,        // must be a number, the fraction is dropped (%ts.%03tu)
+  IPv4,        // 0 if it is not a valid IPv4 address
+  Status       // text that must end with "/<number>", e.g. TCP_MISS/200
+};
+
+/*!
+ * \brief One column of a built-in format.
+ */
+struct SLPColumnDesc
+{
+  SLPColumnTok tok_;
+  SquidLogData::Fields field_;
+  SLPColumnConv conv_;
+};
+
+/*!
+ * \brief Compile-time description of the built-in formats: the columns in
+ * the order they appear in the line. Only the formats listed in
+ * SquidLogData::LogFormat, except Unknown and Custom, are described.
+ */
+template<SquidLogData::LogFormat F>
+struct SLPFormatDesc;
+
+template<>
+struct SLPFormatDesc<SquidLogData::LogFormat::Squid>
+{
+  using F = SquidLogData::Fields;
+  using T = SLPColumnTok;
+  using C = SLPColumnConv;
+  static constexpr bool strictEnd = false;
+  static constexpr std::array<SLPColumnDesc, 10> columns = {
+    { { T::Word, F::Timestamp, C::UInt },
+      { T::Word, F::ResponseTime, C::Int },
+      { T::Word, F::CliSrcIpAddr, C::IPv4 },
+      { T::Word, F::ReqStatusHierStatus, C::Status },
+      { T::Word, F::TotalSizeReply, C::Int },
+      { T::Word, F::ReqMethod, C::Text },
+      { T::Word, F::ReqURL, C::Text },
+      { T::Word, F::UserName, C::Text },
+      { T::Word, F::HierStatusIpAddress, C::Text },
+      { T::Rest, F::MimeContentType, C::Text } }
+  };
+};
+
+template<>
+struct SLPFormatDesc<SquidLogData::LogFormat::Common>
+{
+  using F = SquidLogData::Fields;
+  using T = SLPColumnTok;
+  using C = SLPColumnConv;
+  static constexpr bool strictEnd = false;
+  static constexpr std::array<SLPColumnDesc, 10> columns = {
+    { { T::Word, F::CliSrcIpAddr, C::IPv4 },
+      { T::Word, F::UserNameIdent, C::Text },
+      { T::Word, F::UserName, C::Text },
+      { T::Bracketed, F::LocalTime, C::Text },
+      { T::ReqMethod, F::ReqMethod, C::Text },
+      { T::ReqNext, F::ReqURL, C::Text },
+      { T::ReqLast, F::ReqProtoVersion, C::Text },
+      { T::Word, F::HttpStatus, C::Int },
+      { T::Word, F::TotalSizeReply, C::Int },
+      { T::Rest, F::ReqStatusHierStatus, C::Text } }
+  };
+};
+
+template<>
+struct SLPFormatDesc<SquidLogData::LogFormat::Combined>
+{
+  using F = SquidLogData::Fields;
+  using T = SLPColumnTok;
+  using C = SLPColumnConv;
+  static constexpr bool strictEnd = false;
+  static constexpr std::array<SLPColumnDesc, 12> columns = {
+    { { T::Word, F::CliSrcIpAddr, C::IPv4 },
+      { T::Word, F::UserNameIdent, C::Text },
+      { T::Word, F::UserName, C::Text },
+      { T::Bracketed, F::LocalTime, C::Text },
+      { T::ReqMethod, F::ReqMethod, C::Text },
+      { T::ReqNext, F::ReqURL, C::Text },
+      { T::ReqLast, F::ReqProtoVersion, C::Text },
+      { T::Word, F::HttpStatus, C::Int },
+      { T::Word, F::TotalSizeReply, C::Int },
+      { T::Quoted, F::Referrer, C::Text },
+      { T::Quoted, F::UserAgent, C::Text },
+      { T::Rest, F::ReqStatusHierStatus, C::Text } }
+  };
+};
+
+template<>
+struct SLPFormatDesc<SquidLogData::LogFormat::Referrer>
+{
+  using F = SquidLogData::Fields;
+  using T = SLPColumnTok;
+  using C = SLPColumnConv;
+  static constexpr bool strictEnd = false;
+  static constexpr std::array<SLPColumnDesc, 4> columns = {
+    { { T::Word, F::Timestamp, C::UInt },
+      { T::Word, F::CliSrcIpAddr, C::IPv4 },
+      { T::Word, F::Referrer, C::Text },
+      { T::Rest, F::ReqURL, C::Text } }
+  };
+};
+
+template<>
+struct SLPFormatDesc<SquidLogData::LogFormat::UserAgent>
+{
+  using F = SquidLogData::Fields;
+  using T = SLPColumnTok;
+  using C = SLPColumnConv;
+  static constexpr bool strictEnd = true; // nothing may follow the agent
+  static constexpr std::array<SLPColumnDesc, 3> columns = {
+    { { T::Word, F::CliSrcIpAddr, C::IPv4 },
+      { T::Bracketed, F::LocalTime, C::Text },
+      { T::Quoted, F::UserAgent, C::Text } }
+  };
+};
+
+/*!
+ * \internal
+ * \brief C++ type that holds a column after its conversion.
+ */
+template<SLPColumnConv C>
+struct SLPColumnType
+{
+  using type = std::string_view;
+};
+
+template<>
+struct SLPColumnType<SLPColumnConv::Int>
+{
+  using type = int;
+};
+
+template<>
+struct SLPColumnType<SLPColumnConv::UInt>
+{
+  using type = uint32_t;
+};
+
+template<>
+struct SLPColumnType<SLPColumnConv::IPv4>
+{
+  using type = uint32_t;
+};
+
+/*!
+ * \internal
+ * \brief std::tuple with one member per column of the descriptor TDesc.
+ */
+template<typename TDesc,
+         typename TSeq = std::make_index_sequence<TDesc::columns.size()>>
+struct SLPRecordValues;
+
+template<typename TDesc, size_t... I>
+struct SLPRecordValues<TDesc, std::index_sequence<I...>>
+{
+  using type =
+    std::tuple<typename SLPColumnType<TDesc::columns[I].conv_>::type...>;
+};
+
+/*!
+ * \brief Record of a built-in format. It only has the columns of that
+ * format, converted to their own type; the text columns are views into the
+ * line that was parsed.
+ *
+ * \code
+ * SLPRecord<SquidLogData::LogFormat::Referrer> r_;
+ * uint32_t ts_ = r_.get<SquidLogData::Fields::Timestamp>();
+ * \endcode
+ */
+template<SquidLogData::LogFormat F>
+struct SLPRecord
+{
+  using Desc = SLPFormatDesc<F>;
+  using Fields = SquidLogData::Fields;
+
+  static constexpr size_t size = Desc::columns.size();
+
+  /*!
+   * \brief Returns the column of f_, or -1 if the format does not have it.
+   */
+  static constexpr int indexOf(Fields f_)
+  {
+    for (size_t i_ = 0; i_ < size; ++i_) {
+      if (Desc::columns[i_].field_ == f_) {
+        return static_cast<int>(i_);
+      }
+    }
+    return -1;
+  }
+
+  static constexpr bool has(Fields f_) { return indexOf(f_) >= 0; }
+
+  template<Fields G>
+  auto& get()
+  {
+    static_assert(has(G), "The log format does not have this field.");
+    return std::get<indexOf(G)>(values_);
+  }
+
+  template<Fields G>
+  const auto& get() const
+  {
+    static_assert(has(G), "The log format does not have this field.");
+    return std::get<indexOf(G)>(values_);
+  }
+
+  typename SLPRecordValues<Desc>::type values_ = {};
+};
+
+/*!
+ * \brief Parser specialized at compile time for one of the built-in formats.
+ *
+ * The parse loop is unrolled from SLPFormatDesc<F>, so each format gets its
+ * own sequence of tokenizer calls and conversions, without a per-field switch
+ * and without touching the fields the format does not have. SquidLogParser
+ * dispatches to it in ParserMode::Tokenizer.
+ *
+ * \code
+ * using Combined = SquidLogParserT<SquidLogData::LogFormat::Combined>;
+ * Combined::Record r_;
+ * if (Combined::parse(line_, r_)) {
+ *   std::string_view agent_ = r_.get<SquidLogData::Fields::UserAgent>();
+ * }
+ * \endcode
+ */
+template<SquidLogData::LogFormat F>
+class SquidLogParserT
+{
+public:
+  using Record = SLPRecord<F>;
+  using Fields = SquidLogData::Fields;
+
+  static constexpr SquidLogData::LogFormat format = F;
+
+  /*!
+   * \brief True if the format carries an HTTP status code, either in its own
+   * column or at the end of %Ss/%03>Hs.
+   */
+  static constexpr bool hasHttpCode =
+    Record::has(Fields::HttpStatus) ||
+    (Record::has(Fields::ReqStatusHierStatus) &&
+     Record::Desc::columns[Record::indexOf(Fields::ReqStatusHierStatus)]
+         .conv_ == SLPColumnConv::Status);
+
+  /*!
+   * \brief Splits and converts a line.
+   * \param tok_ Tokenizer positioned at the beginning of the line.
+   * \param rec_ Receives the columns. The text columns point into the line.
+   * \param dict_ Encodes the IPv6 client addresses. Without it they are
+   * stored as 0, like any other invalid IPv4 address.
+   * \return false if the line does not match the format.
+   */
+  static bool parse(SLPTokenizer& tok_,
+                    Record& rec_,
+                    SLPAddrDict* dict_ = nullptr)
+  {
+    SLPTokenizer req_{ std::string_view() };
+    return parseColumns(tok_,
+                        req_,
+                        rec_,
+                        dict_,
+                        std::make_index_sequence<Record::size>{}) &&
+           (!Record::Desc::strictEnd || tok_.atEnd());
+  }
+
+  static bool parse(std::string_view line_,
+                    Record& rec_,
+                    SLPAddrDict* dict_ = nullptr)
+  {
+    SLPTokenizer tok_(line_);
+    return parse(tok_, rec_, dict_);
+  }
+
+  /*!
+   * \brief Returns the HTTP status code of the record, or 0.
+   */
+  static short httpCode(const Record& rec_)
+  {
+    if constexpr (Record::has(Fields::HttpStatus)) {
+      return static_cast<short>(rec_.template get<Fields::HttpStatus>());
+    } else if constexpr (hasHttpCode) {
+      const std::string_view s_ =
+        rec_.template get<Fields::ReqStatusHierStatus>();
+      short code_ = 0;
+      SLPTokenizer::toNumber(s_.substr(s_.find('/') + 1), code_);
+      return code_;
+    } else {
+      return 0;
+    }
+  }
+
+  /*!
+   * \brief Copies the record to the fields of a DataSet_Squid, or points the
+   * fields of a DataSet_View to the same bytes as the record. The fields the
+   * format does not have are left untouched.
+   */
+  template<typename TDataSet>
+  static void toDataSet(const Record& rec_, TDataSet& ds_)
+  {
+    toDataSet(rec_, ds_, std::make_index_sequence<Record::size>{});
+  }
+
+  /*!
+   * \brief Writes the fields of a DataSet_Squid or DataSet_View as a line of
+   * the format, without the '\n', that parse() reads back. Empty words are
+   * written as "-".
+   * \param dict_ Decodes the IPv6 client addresses.
+   */
+  template<typename TDataSet>
+  static void toLine(const TDataSet& ds_,
+                     const SLPAddrDict* dict_,
+                     std::string& line_)
+  {
+    line_.clear();
+    toLine(ds_, dict_, line_, std::make_index_sequence<Record::size>{});
+  }
+
+private:
+  template<size_t... I>
+  static bool parseColumns(SLPTokenizer& tok_,
+                           SLPTokenizer& req_,
+                           Record& rec_,
+                           SLPAddrDict* dict_,
+                           std::index_sequence<I...>)
+  {
+    return (parseColumn<I>(tok_, req_, rec_, dict_) && ...);
+  }
+
+  template<size_t I>
+  static bool parseColumn(SLPTokenizer& tok_,
+                          SLPTokenizer& req_,
+                          Record& rec_,
+                          [[maybe_unused]] SLPAddrDict* dict_)
+  {
+    constexpr SLPColumnDesc c_ = Record::Desc::columns[I];
+    std::string_view v_;
+    if constexpr (c_.tok_ == SLPColumnTok::Word) {
+      if (!tok_.next(v_)) {
+        return false;
+      }
+    } else if constexpr (c_.tok_ == SLPColumnTok::Rest) {
+      if (!tok_.rest(v_)) {
+        return false;
+      }
+    } else if constexpr (c_.tok_ == SLPColumnTok::Bracketed) {
+      if (!tok_.bracketed(v_)) {
+        return false;
+      }
+    } else if constexpr (c_.tok_ == SLPColumnTok::Quoted) {
+      if (!tok_.quoted(v_)) {
+        return false;
+      }
+    } else if constexpr (c_.tok_ == SLPColumnTok::ReqMethod) {
+      std::string_view q_;
+      if (!tok_.quoted(q_)) {
+        return false;
+      }
+      req_ = tok_.sub(q_);
+      if (!req_.next(v_)) {
+        return false;
+      }
+    } else if constexpr (c_.tok_ == SLPColumnTok::ReqNext) {
+      if (!req_.next(v_)) {
+        return false;
+      }
+    } else {
+      std::string_view extra_;
+      if (!req_.next(v_) || req_.next(extra_)) {
+        return false;
+      }
+    }
+
+    auto& out_ = std::get<I>(rec_.values_);
+    if constexpr (c_.conv_ == SLPColumnConv::Text) {
+      out_ = v_;
+    } else if constexpr (c_.conv_ == SLPColumnConv::Int ||
+                         c_.conv_ == SLPColumnConv::UInt) {
+      return SLPTokenizer::toNumber(v_, out_);
+    } else if constexpr (c_.conv_ == SLPColumnConv::IPv4) {
+      if (dict_ != nullptr) {
+        out_ = dict_->encode(v_);
+      } else if (!SLPTokenizer::toIPv4(v_, out_)) {
+        out_ = 0;
+      }
+    } else {
+      const size_t slash_ = v_.find('/');
+      short code_ = 0;
+      if (slash_ == std::string_view::npos ||
+          !SLPTokenizer::toNumber(v_.substr(slash_ + 1), code_)) {
+        return false;
+      }
+      out_ = v_;
+    }
+    return true;
+  }
+
+  template<typename TDataSet, size_t... I>
+  static void toDataSet(const Record& rec_,
+                        TDataSet& ds_,
+                        std::index_sequence<I...>)
+  {
+    (store<Record::Desc::columns[I].field_>(std::get<I>(rec_.values_), ds_),
+     ...);
+  }
+
+  template<typename TDataSet, size_t... I>
+  static void toLine(const TDataSet& ds_,
+                     const SLPAddrDict* dict_,
+                     std::string& line_,
+                     std::index_sequence<I...>)
+  {
+    (toColumn<I>(ds_, dict_, line_), ...);
+  }
+
+  template<size_t I, typename TDataSet>
+  static void toColumn(const TDataSet& ds_,
+                       const SLPAddrDict* dict_,
+                       std::string& line_)
+  {
+    using T = SLPColumnTok;
+    constexpr SLPColumnDesc c_ = Record::Desc::columns[I];
+
+    std::string value_;
+    if constexpr (c_.conv_ == SLPColumnConv::Int ||
+                  c_.conv_ == SLPColumnConv::UInt) {
+      value_ = std::to_string(load<c_.field_>(ds_));
+    } else if constexpr (c_.conv_ == SLPColumnConv::IPv4) {
+      value_ = dict_ != nullptr ? dict_->text(ds_.cliSrcIpAddr)
+                                : IPv4Addr::ltoip(ds_.cliSrcIpAddr);
+    } else {
+      value_ = load<c_.field_>(ds_);
+    }
+    if (value_.empty() && c_.tok_ != T::Rest && c_.tok_ != T::Bracketed &&
+        c_.tok_ != T::Quoted) {
+      value_ = "-";
+    }
+
+    if (I > 0) {
+      line_ += ' ';
+    }
+    switch (c_.tok_) {
+      case T::Bracketed: {
+        line_.append("[").append(value_).append("]");
+        break;
+      }
+      case T::Quoted: {
+        line_.append("\"").append(value_).append("\"");
+        break;
+      }
+      case T::ReqMethod: {
+        line_.append("\"").append(value_);
+        break;
+      }
+      case T::ReqLast: {
+        line_.append(value_).append("\"");
+        break;
+      }
+      default: {
+        line_.append(value_);
+        break;
+      }
+    }
+  }
+
+  template<Fields G, typename TDataSet>
+  static auto load(const TDataSet& ds_)
+  {
+    if constexpr (G == Fields::Timestamp) {
+      return ds_.timeStamp;
+    } else if constexpr (G == Fields::ResponseTime) {
+      return ds_.responseTime;
+    } else if constexpr (G == Fields::HttpStatus) {
+      return ds_.httpStatus;
+    } else if constexpr (G == Fields::TotalSizeReply) {
+      return ds_.totalSizeReply;
+    } else if constexpr (G == Fields::LocalTime) {
+      return std::string_view(ds_.localTime);
+    } else if constexpr (G == Fields::UserName) {
+      return std::string_view(ds_.userName);
+    } else if constexpr (G == Fields::UserNameIdent) {
+      return std::string_view(ds_.userNameIdent);
+    } else if constexpr (G == Fields::ReqMethod) {
+      return std::string_view(ds_.reqMethod);
+    } else if constexpr (G == Fields::ReqURL) {
+      return std::string_view(ds_.reqURL);
+    } else if constexpr (G == Fields::ReqProtoVersion) {
+      return std::string_view(ds_.reqProtoVersion);
+    } else if constexpr (G == Fields::ReqStatusHierStatus) {
+      return std::string_view(ds_.reqStatusHierStatus);
+    } else if constexpr (G == Fields::HierStatusIpAddress) {
+      return std::string_view(ds_.hierStatusIpAddress);
+    } else if constexpr (G == Fields::MimeContentType) {
+      return std::string_view(ds_.mimeTypeContent);
+    } else if constexpr (G == Fields::OrigRcvReqHeader) {
+      return std::string_view(ds_.origRcvReqHeader);
+    } else if constexpr (G == Fields::Referrer) {
+      return std::string_view(ds_.referrer);
+    } else {
+      static_assert(G == Fields::UserAgent, "Not a column of the format.");
+      return std::string_view(ds_.userAgent);
+    }
+  }
+
+  template<Fields G, typename TValue, typename TDataSet>
+  static void store(const TValue& v_, TDataSet& ds_)
+  {
+    if constexpr (G == Fields::Timestamp) {
+      ds_.timeStamp = v_;
+    } else if constexpr (G == Fields::CliSrcIpAddr) {
+      ds_.cliSrcIpAddr = v_;
+    } else if constexpr (G == Fields::ResponseTime) {
+      ds_.responseTime = v_;
+    } else if constexpr (G == Fields::HttpStatus) {
+      ds_.httpStatus = v_;
+    } else if constexpr (G == Fields::TotalSizeReply) {
+      ds_.totalSizeReply = v_;
+    } else if constexpr (G == Fields::LocalTime) {
+      ds_.localTime = v_;
+    } else if constexpr (G == Fields::UserName) {
+      ds_.userName = v_;
+    } else if constexpr (G == Fields::UserNameIdent) {
+      ds_.userNameIdent = v_;
+    } else if constexpr (G == Fields::ReqMethod) {
+      ds_.reqMethod = v_;
+    } else if constexpr (G == Fields::ReqURL) {
+      ds_.reqURL = v_;
+    } else if constexpr (G == Fields::ReqProtoVersion) {
+      ds_.reqProtoVersion = v_;
+    } else if constexpr (G == Fields::ReqStatusHierStatus) {
+      ds_.reqStatusHierStatus = v_;
+    } else if constexpr (G == Fields::HierStatusIpAddress) {
+      ds_.hierStatusIpAddress = v_;
+    } else if constexpr (G == Fields::MimeContentType) {
+      ds_.mimeTypeContent = v_;
+    } else if constexpr (G == Fields::OrigRcvReqHeader) {
+      ds_.origRcvReqHeader = v_;
+    } else if constexpr (G == Fields::Referrer) {
+      ds_.referrer = v_;
+    } else if constexpr (G == Fields::UserAgent) {
+      ds_.userAgent = v_;
+    }
+  }
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief Binary snapshot of the entries, see SquidLogParser::saveSnapshot().
+ *
+ * The file is a Header, a table of Section and the sections, each one an
+ * array of fixed-size elements (a column, the text of a dictionary, ...)
+ * stored as it is in memory and aligned to sectionAlign bytes. A section is
+ * thus used in place once the file is mapped: read() copies it to a vector
+ * with a single memcpy(), and view() gives a pointer into the map.
+ *
+ * The header holds the version, the byte order of the host that wrote the
+ * file, the log format and a checksum of the table and of every section.
+ * open() rejects the files whose header, table or checksum do not match.
+ *
+ * Writing mirrors reading: the sections are added in the order they are
+ * later read, e.g. SLPColumnStore::save() and SLPColumnStore::load().
+ *
+ * \code
+ * SLPSnapshot out_;
+ * out_.add(timestamps_);                 // std::vector<uint32_t>
+ * out_.write("day.slp", 0, timestamps_.size());
+ *
+ * SLPSnapshot in_;
+ * if (in_.open("day.slp") == SquidLogData::SLPError::SLP_SUCCESS) {
+ *   size_t n_ = 0;
+ *   const uint32_t* ts_ = in_.view<uint32_t>(0, n_); // no copy
+ * }
+ * \endcode
+ */
+class SquidLogParser_EXPORT SLPSnapshot
+{
+public:
+  static constexpr std::array<char, 8> magic = { 'S', 'L', 'P', 'S',
+                                                 'N', 'A', 'P', '\0' };
+  static constexpr uint32_t version = 1;
+  static constexpr uint32_t byteOrder = 0x01020304;
+  static constexpr size_t sectionAlign = 64;
+
+  struct Header
+  {
+    std::array<char, 8> magic_;
+    uint32_t version_;
+    uint32_t byteOrder_;
+    uint32_t logFormat_; // SquidLogData::LogFormat
+    uint32_t sections_;
+    uint64_t rows_;
+    uint64_t bytes_; // size of the file
+    uint64_t checksum_;
+  };
+
+  struct Section
+  {
+    uint64_t offset_; // from the start of the file
+    uint64_t count_;  // elements
+    uint32_t size_;   // bytes of an element
+    uint32_t reserved_;
+  };
+
+  SLPSnapshot() = default;
+  SLPSnapshot(const SLPSnapshot&) = delete;
+  SLPSnapshot& operator=(const SLPSnapshot&) = delete;
+  ~SLPSnapshot();
+
+  /*!
+   * \brief Adds a section. The data must stay alive until write().
+   */
+  template<typename T>
+  void add(const T* data_, size_t count_)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    parts_.push_back({ data_, count_, sizeof(T) });
+  }
+  template<typename T>
+  void add(const std::vector<T>& v_)
+  {
+    add(v_.data(), v_.size());
+  }
+  template<typename T>
+  void add(std::vector<T>&& v_)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::vector<char>& b_ = kept_.emplace_back(
+      reinterpret_cast<const char*>(v_.data()),
+      reinterpret_cast<const char*>(v_.data() + v_.size()));
+    parts_.push_back({ b_.data(), v_.size(), sizeof(T) });
+  }
+  void add(const std::string& s_) { add(s_.data(), s_.size()); }
+  void addStrings(const std::vector<std::string_view>& s_);
+  SquidLogData::SLPError write(const std::string& path_,
+                               uint32_t log_format_,
+                               uint64_t rows_) const;
+
+  SquidLogData::SLPError open(const std::string& path_);
+  void close();
+  const Header& header() const { return *header_; }
+  size_t sections() const { return header_ ? header_->sections_ : 0; }
+
+  /*!
+   * \brief Returns the section i_, in place, or nullptr if it is not made of
+   * T.
+   */
+  template<typename T>
+  const T* view(size_t i_, size_t& count_) const
+  {
+    if (i_ >= sections() || table_[i_].size_ != sizeof(T)) {
+      return nullptr;
+    }
+    count_ = table_[i_].count_;
+    return reinterpret_cast<const T*>(map_ + table_[i_].offset_);
+  }
+
+  /*!
+   * \brief Copies the next section to v_.
+   * \return false if there is no next section or it is not made of T.
+   */
+  template<typename T>
+  bool read(std::vector<T>& v_)
+  {
+    size_t n_ = 0;
+    const T* p_ = view<T>(next_, n_);
+    if (p_ == nullptr) {
+      return false;
+    }
+    ++next_;
+    v_.assign(p_, p_ + n_);
+    return true;
+  }
+  bool read(std::string& s_);
+  bool readStrings(std::vector<std::string_view>& s_);
+
+  static uint64_t checksum(const void* data_, size_t size_, uint64_t seed_);
+
+private:
+  struct Part
+  {
+    const void* data_;
+    uint64_t count_;
+    uint32_t size_;
+  };
+
+  std::vector<Part> parts_;
+  std::deque<std::vector<char>> kept_; // sections owned by the snapshot
+
+  const char* map_ = nullptr;
+  size_t mapSize_ = 0;
+  const Header* header_ = nullptr;
+  const Section* table_ = nullptr;
+  size_t next_ = 0; // see read()
+};
+
+/* ------------------------------------------------------------------------- */
+/*!
+ * \brief Column-oriented store of the entries (StorageMode::Columnar).
+ *
+ * Each field is a contiguous column. The numeric ones are plain arrays and
+ * the text ones an array of end offsets plus a blob with the text of every
+ * row, so scanning a field touches only that field. The text fields with few
+ * distinct values (user names, method, protocol, status, hierarchy and MIME
+ * type) are dictionary columns instead: an SLPDictionary plus the code of
+ * each row, so that they can be compared and counted by code.
+ *
+ * The rows are appended in log order. A row older than the last one only
+ * marks the store as unsorted; sorted() returns a copy sorted by timestamp
+ * (rows with the same timestamp keep their order), so that the row numbers
+ * already taken from this store stay valid.
+ *
+ * The rows are grouped in segments of segmentRows rows, each one with a zone
+ * map: the bounds of its timestamps, addresses and integer fields, and the
+ * number of empty ("" or "-") values of each text field. A scan skips the
+ * segments whose zone map shows that no row can match.
+ *
+ * buildAddrIndex() adds a secondary index on the client address: the row
+ * numbers sorted by address. It is dropped by the next change to the rows.
+ *
+ * The host of each ReqURL is stored as a code, and an inverted index gives
+ * the rows of each host and of each registrable domain, see selectByHost().
+ *
+ * evictFront() removes the oldest segments. The columns keep the room of the
+ * rows removed, and the dictionaries keep their values.
+ *
+ * save() and load() write and read the columns, dictionaries, zone maps and
+ * host codes as SLPSnapshot sections. The postings of the hosts are rebuilt
+ * by load(), and the address index by the next buildAddrIndex().
+ */
+class SquidLogParser_EXPORT SLPColumnStore
+{
+public:
+  using Fields = SquidLogData::Fields;
+  using Row = SquidLogData::DataSet_View;
+
+  static constexpr size_t segmentRows = 4096;
+  static constexpr size_t intColumns = 3;
+  static constexpr size_t textColumns = 12;
+
+  /*!
+   * \brief Zone map of a segment.
+   */
+  struct Zone
+  {
+    uint32_t minTs_;
+    uint32_t maxTs_;
+    uint32_t minAddr_;
+    uint32_t maxAddr_;
+    std::array<int, intColumns> minInt_; // see intIndex()
+    std::array<int, intColumns> maxInt_;
+    std::array<uint32_t, textColumns> nulls_; // see textIndex()
+
+    // True if no address of the segment can be in r_.
+    bool excludes(const SLPAddrDict::Range& r_) const
+    {
+      return r_.v4_ && (maxAddr_ < r_.lo4_ || minAddr_ > r_.hi4_);
+    }
+  };
+
+  void append(const Row& r_);
+  void extend(const SLPColumnStore& from_);
+  void evictFront(size_t rows_);
+  void clear();
+
+  size_t size() const { return timeStamp_.size(); }
+  bool isSorted() const { return sorted_; }
+  std::shared_ptr<SLPColumnStore> sorted() const;
+  size_t lowerBound(uint32_t ts_) const;
+  size_t upperBound(uint32_t ts_) const;
+
+  const std::vector<uint32_t>& timeStamps() const { return timeStamp_; }
+  const std::vector<uint32_t>& addrs() const { return cliSrcIpAddr_; }
+  void setAddr(size_t row_, uint32_t addr_);
+  const std::vector<int>* ints(Fields f_) const;
+  std::string_view text(Fields f_, size_t row_) const;
+  const SLPDictionary* dictionary(Fields f_) const;
+  const std::vector<uint32_t>* codes(Fields f_) const;
+  Row row(size_t row_) const;
+
+  const std::vector<Zone>& zones() const { return zones_; }
+
+  const SLPDictionary& hosts() const { return hosts_; }
+  const SLPDictionary& domains() const { return domains_; }
+  const std::vector<uint32_t>& hostCodes() const { return hostCodes_; }
+  uint32_t hostDomain(uint32_t host_) const { return hostDomain_[host_]; }
+  void selectByHost(std::string_view host_,
+                    bool subdomains_,
+                    size_t begin_,
+                    size_t end_,
+                    std::vector<uint32_t>& rows_) const;
+
+  void buildAddrIndex();
+  bool hasAddrIndex() const { return indexed_; }
+  bool selectByAddr(const SLPAddrDict::Range& r_,
+                    size_t begin_,
+                    size_t end_,
+                    std::vector<uint32_t>& rows_) const;
+
+  /*!
+   * \brief Calls f_(zone, first_row, end_row) for each segment in the rows
+   * [begin_, end_), clipped to that range.
+   */
+  template<typename TFunc>
+  void forSegments(size_t begin_, size_t end_, TFunc&& f_) const
+  {
+    while (begin_ < end_) {
+      const size_t z_ = begin_ / segmentRows;
+      const size_t stop_ = std::min(end_, (z_ + 1) * segmentRows);
+      f_(zones_[z_], begin_, stop_);
+      begin_ = stop_;
+    }
+  }
+
+  static bool isText(Fields f_) { return textIndex(f_) >= 0; }
+  static bool isNull(std::string_view s_) { return s_.empty() || s_ == "-"; }
+  static int intIndex(Fields f_);
+  static int textIndex(Fields f_);
+  size_t bytes() const;
+  size_t bytes(Fields f_) const;
+  size_t zoneBytes() const;
+  size_t addrIndexBytes() const;
+  size_t hostIndexBytes() const;
+  size_t usedBytes() const;
+
+  void save(SLPSnapshot& out_) const;
+  bool load(SLPSnapshot& in_);
+
+private:
+  struct TextColumn
+  {
+    std::vector<uint64_t> end_; // row i is blob_[end_[i - 1] .. end_[i])
+    std::string blob_;
+    std::vector<uint32_t> codes_; // dictionary columns: row i is codes_[i]
+    SLPDictionary dict_;
+  };
+
+  // Dictionary columns, in the order of textMembers_.
+  static constexpr std::array<bool, textColumns> dictColumns_ = {
+    false, true,  true,  true,  false, true,
+    true,  true,  true,  false, false, false
+  };
+  static constexpr std::array<std::string_view Row::*, textColumns>
+    textMembers_ = { &Row::localTime,           &Row::userName,
+                     &Row::userNameIdent,       &Row::reqMethod,
+                     &Row::reqURL,              &Row::reqProtoVersion,
+                     &Row::reqStatusHierStatus, &Row::hierStatusIpAddress,
+                     &Row::mimeTypeContent,     &Row::origRcvReqHeader,
+                     &Row::referrer,            &Row::userAgent };
+
+  std::vector<uint32_t> timeStamp_;
+  std::vector<uint32_t> cliSrcIpAddr_;
+  std::vector<int> responseTime_;
+  std::vector<int> httpStatus_;
+  std::vector<int> totalSizeReply_;
+  std::array<TextColumn, textColumns> text_;
+  std::vector<Zone> zones_; // zones_[i] covers the rows of segment i
+  std::vector<uint32_t> addrIndex_; // rows by address, then row number
+  bool indexed_ = false;
+  SLPDictionary hosts_;                           // lower-case hosts of ReqURL
+  SLPDictionary domains_;                         // registrable domains
+  std::vector<uint32_t> hostCodes_;               // row i: hostCodes_[i]
+  std::vector<uint32_t> hostDomain_;              // host code -> domain code
+  std::vector<std::vector<uint32_t>> hostRows_;   // host code -> rows
+  std::vector<std::vector<uint32_t>> domainRows_; // domain code -> rows
+  bool sorted_ = true;
+
+  std::string_view text(size_t column_, size_t row_) const;
+  void zoneRow(size_t row_);
+  void buildZones(size_t from_);
+  void dropAddrIndex();
+  uint32_t internHost(std::string_view url_);
+  void addHost(uint32_t host_);
+};
+
 /* ------------------------------------------------------------------------- */
 /*!
  * \brief Object to interact the composite key of the data map.
@@ -617,17 +2350,83 @@ class SquidLogParser_EXPORT SquidLogParser
 {
 public:
   explicit SquidLogParser(LogFormat log_fmt_ = LogFormat::Squid);
+  explicit SquidLogParser(const SLPLogFormat& log_fmt_);
 
   SquidLogParser& append(const std::string& raw_log_);
 
+  /*!
+   * \brief Lines read by appendBuffer(), appendStream() and flush(). The
+   * blank lines are not counted.
+   */
+  struct lineCount_t
+  {
+    size_t Accepted;
+    size_t Rejected;
+  };
+
+  static constexpr size_t defaultReadSize = 1 << 20;
+
+  lineCount_t appendBuffer(const char* data_, size_t size_);
+  lineCount_t appendStream(std::istream& in_,
+                           size_t read_size_ = defaultReadSize);
+  lineCount_t flush();
+  lineCount_t loadFile(const std::string& path_, unsigned threads_ = 0);
+
+  void setParserMode(ParserMode mode_);
+  ParserMode parserMode() const;
+
+  void setStorageMode(StorageMode mode_);
+  StorageMode storageMode() const;
+  void setAddrIndex(bool on_);
+  bool addrIndex() const;
+
   SLPError errorNum() const noexcept;
   std::string getErrorText() const;
   size_t size() const;
   void clear();
 
+  /*!
+   * \brief Bytes allocated for the entries, see memoryUsage().
+   */
+  struct memoryUsage_t
+  {
+    // StorageMode::Columnar: each column, by Fields, with its dictionary.
+    std::array<size_t, static_cast<size_t>(Fields::Unknown)> Columns;
+    size_t ZoneMaps;
+    size_t AddrIndex;
+    size_t HostIndex;
+    size_t Entries;  // StorageMode::Copy and Arena: the map nodes, estimated
+    size_t Lines;    // StorageMode::Arena: the chunks of the SLPLineArena
+    size_t AddrDict; // IPv6 client addresses
+    size_t Total;
+  };
+
+  /*!
+   * \brief Entries evicted to stay within the memory budget.
+   */
+  struct evictionCount_t
+  {
+    size_t Evictions; // times the budget was exceeded
+    size_t Entries;   // entries evicted
+    size_t Spilled;   // entries written to the spill file
+    size_t Bytes;     // bytes freed
+  };
+
+  memoryUsage_t memoryUsage() const;
+  void setMemoryBudget(size_t bytes_,
+                       const std::string& spill_path_ = std::string());
+  size_t memoryBudget() const;
+  evictionCount_t evictionCount() const;
+
+  SLPError saveSnapshot(const std::string& path_);
+  size_t loadSnapshot(const std::string& path_);
+
   int getPartInt(Fields f_) const;
   uint32_t getPartUInt(Fields f_) const;
   std::string getPartStr(Fields f_) const;
+  std::string_view getPartView(Fields f_) const;
+  std::string getPartCustom(size_t column_) const;
+  std::string getPartCustom(std::string_view code_) const;
 
   // Convenience functions
   uint32_t addrToNumeric(const std::string addr_ = std::string()) const;
@@ -660,13 +2459,24 @@ public:
 protected:
   SLPError slpError_ = SLPError::SLP_SUCCESS;
 
-  std::multimap<DataKey, DataSet_Squid> mEntry;
+  using Entries = std::multimap<DataKey, DataSet_Squid>;
+  using Views = std::multimap<DataKey, DataSet_View>;
+
+  // The stores are shared with the SLPQuery objects, see unshared().
+  std::shared_ptr<Entries> mEntry;
+  std::shared_ptr<Views> mView;             // StorageMode::Arena only
+  std::shared_ptr<SLPLineArena> arena_;     // owns the lines of mView
+  std::shared_ptr<SLPAddrDict> addrDict_;   // codes of cliSrcIpAddr
+  std::shared_ptr<SLPColumnStore> columns_; // StorageMode::Columnar only
+
+  std::shared_ptr<const SLPLogFormat> logFormat_; // LogFormat::Custom only
 
   template<typename TString = std::string, typename TSize = size_t>
   TString toLower(TString s_, TSize sz_ = 0);
 
   std::string strRight(const std::string src_, const char sep_) const;
   std::string getFiletype(const std::string& url_) const;
+  std::string_view getFiletypeView(std::string_view url_) const;
 
   bool isMonth(const std::string&& s_);
   int monthToNumber(const std::string&& s_) const;
@@ -676,9 +2486,22 @@ protected:
   void setError(SLPError e_);
   std::string getErrorRE(boost::regex_error& e_) const;
 
-  constexpr int intFields(Fields f_, const DataSet_Squid& d_) const;
-  constexpr uint32_t uint32Fields(Fields f_, const DataSet_Squid& d_) const;
-  std::string strFields(Fields f_, const DataSet_Squid& d_) const;
+  template<typename TDataSet>
+  constexpr int intFields(Fields f_, const TDataSet& d_) const;
+  template<typename TDataSet>
+  constexpr uint32_t uint32Fields(Fields f_, const TDataSet& d_) const;
+  template<typename TDataSet>
+  std::string strFields(Fields f_, const TDataSet& d_) const;
+  template<typename TDataSet>
+  std::string_view viewFields(Fields f_, const TDataSet& d_) const;
+
+  DataSet_Squid toDataSet(const DataSet_View& v_) const;
+  static DataSet_View toView(const DataSet_Squid& d_);
+
+  template<typename TStore>
+  static std::pair<typename TStore::const_iterator,
+                   typename TStore::const_iterator>
+  timeRange(const TStore& store_, uint32_t min_, uint32_t max_);
 
   template<typename TVarD, typename TMin, typename TMax, typename TCompare>
   bool decision(TVarD&& data_, TMin&& min_, TMax&& max_, TCompare&& cmp_) const;
@@ -690,12 +2513,32 @@ protected:
 
 private:
   friend class SLPDatabase;
+  friend class SLPQuery;
 
 private:
   LogFormat logFmt_;
+  ParserMode parserMode_;
+  StorageMode storageMode_;
+  bool addrIndex_; // StorageMode::Columnar: SLPColumnStore::buildAddrIndex()
+  size_t memoryBudget_;                  // 0: no budget
+  size_t entryBytes_;                    // estimate of the bytes of mEntry
+  evictionCount_t evictions_;
+  std::shared_ptr<std::ofstream> spill_; // see setMemoryBudget()
+  std::string spillLine_;
+
+  // Evictions go down to budget - budget / evictionSlack_.
+  static constexpr size_t evictionSlack_ = 8;
+  // Estimate of a node of mView.
+  static constexpr size_t viewBytes_ =
+    sizeof(std::pair<const DataKey, DataSet_View>) + 4 * sizeof(void*);
   std::string rawLog_;
+  std::string_view line_;
+  std::string pending_; // unterminated last line given to appendBuffer()
+  SLPDelimIndex delimIndex_;
   std::string logFileName_;
   DataSet_Squid ds_squid_;
+  DataSet_View ds_view_;
+  mutable SLPDateDecoder dateDecoder_;
 
   static const constexpr char* nmonths_[] = { "Jan", "Feb", "Mar", "Apr",
                                               "May", "Jun", "Jul", "Aug",
@@ -705,9 +2548,6 @@ private:
    * Don't change the regular expressions below, it will make the whole
    * program crash!
    */
-  static constexpr char cp_fmt_squid_date[] =
-    "^(\\d{2})/([A-Z]{1}[a-z]{2})/(\\d{4}):(\\d{2}):(\\d{2}):(\\d{2}).*$";
-
   static constexpr char cp_id_fmt_squid_[] =
     "^(\\S+) (\\S+) (\\S+) (\\S+) (\\S+) (\\S+) (\\S+) (\\S+) (\\S+) (.*)$";
 
@@ -736,7 +2576,31 @@ private:
   SLPError parserReferrer();
   SLPError parserUserAgent();
 
-  void removeExtraWhiteSpaces(const std::string& input_, std::string& output_);
+  template<LogFormat F, typename TDataSet>
+  SLPError scanT(TDataSet& ds_);
+  SLPError scanCustom();
+  template<LogFormat F>
+  bool appendView();
+  bool usesViews() const;
+  void prepareColumns();
+  template<typename T>
+  static T& unshared(std::shared_ptr<T>& p_);
+  size_t budgetBytes() const;
+  void enforceBudget();
+  template<typename TDataSet>
+  void spillEntry(const TDataSet& ds_);
+  static size_t entryBytes(const DataSet_Squid& ds_);
+  bool appendLine(std::string_view raw_log_);
+  void appendCounted(std::string_view raw_log_, lineCount_t& count_);
+  lineCount_t loadCompressed(const std::string& path_);
+  template<typename TEntries>
+  void mergeParts(
+    TEntries& dst_,
+    std::vector<std::pair<TEntries*, const SLPAddrDict*>>& parts_);
+
+  SLPTokenizer lineTokenizer();
+  void clearDataSet();
+  void removeExtraWhiteSpaces(std::string_view input_, std::string& output_);
 
   static void signalHandler(const int signum_);
   void printException(const std::exception& e_,
@@ -746,8 +2610,83 @@ private:
 
 /* ------------------------------------------------------------------------- */
 
+/*!
+ * \brief A condition on the entries, for SLPQuery::where(): comparisons of
+ * fields, IN lists, time and address ranges, combined with AND, OR and NOT.
+ *
+ * An SLPExpr only describes the condition; where() compiles it once and
+ * tests each entry of the range of select() against the whole expression,
+ * in a single pass.
+ *
+ * SLPExpr::field(F::HttpStatus, C::GE, 400) &&
+ *   !SLPExpr::in(F::ReqMethod, { "CONNECT", "OPTIONS" }) &&
+ *   SLPExpr::addr("10.0.0.0/8")
+ */
+class SquidLogParser_EXPORT SLPExpr
+{
+public:
+  using Fields = SquidLogData::Fields;
+  using Compare = SquidLogData::Compare;
+  using var_t = Visitor::var_t;
+
+  enum class Kind
+  {
+    Field = 0x00, // field cmp value, as SLPQuery::field()
+    In,           // field equal to one of the values
+    Time,         // timestamp within [d0, d1]
+    Addr,         // client address within [ip0, ip1] or a CIDR block
+    And,
+    Or,
+    Not
+  };
+
+  static SLPExpr field(Fields fld_, Compare cmp_, var_t t_);
+  static SLPExpr in(Fields fld_, std::vector<var_t> list_);
+  static SLPExpr time(const std::string& d0_, const std::string& d1_);
+  static SLPExpr addr(const std::string& ip0_,
+                      const std::string& ip1_ = std::string());
+  static SLPExpr allOf(std::vector<SLPExpr> terms_);
+  static SLPExpr anyOf(std::vector<SLPExpr> terms_);
+  static SLPExpr negate(SLPExpr term_);
+
+  Kind kind() const noexcept { return kind_; }
+  const std::vector<SLPExpr>& terms() const noexcept { return terms_; }
+
+private:
+  explicit SLPExpr(Kind kind_);
+
+  static SLPExpr join(Kind kind_, SLPExpr a_, SLPExpr b_);
+
+  Kind kind_;
+  Fields fld_;
+  Compare cmp_;
+  std::vector<var_t> values_;  // Field: one value, In: the list
+  std::string lo_;             // Time: d0, Addr: ip0
+  std::string hi_;             // Time: d1, Addr: ip1
+  std::vector<SLPExpr> terms_; // And, Or and Not
+
+  friend class SLPQuery;
+  friend SLPExpr operator&&(SLPExpr a_, SLPExpr b_);
+  friend SLPExpr operator||(SLPExpr a_, SLPExpr b_);
+};
+
+SLPExpr
+operator&&(SLPExpr a_, SLPExpr b_);
+SLPExpr
+operator||(SLPExpr a_, SLPExpr b_);
+SLPExpr
+operator!(SLPExpr a_);
+
+/* ------------------------------------------------------------------------- */
+
 /*!
  * \brief The SLPQuery class
+ *
+ * A query shares the entries of its SquidLogParser instead of copying them:
+ * the parser copies a store before changing it while a query holds it, so
+ * the query keeps seeing the entries as they were when it was created.
+ * field() keeps the entries selected as pointers to them, or row numbers in
+ * StorageMode::Columnar.
  */
 class SquidLogParser_EXPORT SLPQuery : public SquidLogParser
 {
@@ -760,6 +2699,10 @@ public:
                    const std::string&& t1_ = std::string());
 
   void field(Fields fld_, Compare cmp_, Visitor::var_t&& t_);
+  void where(const SLPExpr& expr_);
+
+  void setThreads(unsigned n_);
+  unsigned threads() const;
 
   std::vector<int> getInt(const std::string&& ts_,
                           const std::string&& ip_,
@@ -771,6 +2714,15 @@ public:
                                   const std::string&& ip_,
                                   Fields fld_) const;
 
+  // Keys of the batched getInt(), getUInt() and getStr(): the timestamp and
+  // the IP address of each lookup.
+  using Keys_V = std::vector<std::pair<std::string, std::string>>;
+  std::vector<std::vector<int>> getInt(const Keys_V& keys_, Fields fld_) const;
+  std::vector<std::vector<uint32_t>> getUInt(const Keys_V& keys_,
+                                             Fields fld_) const;
+  std::vector<std::vector<std::string>> getStr(const Keys_V& keys_,
+                                               Fields fld_) const;
+
   long sumTotalSizeReply() const;
   long sumResponseTime() const;
 
@@ -814,11 +2766,22 @@ public:
   int totalFiles() const;
 
 protected:
-  std::multimap<DataKey, DataSet_Squid> mSubset_;
+  // Selection: the entries of mEntry and mView, in key order, and the rows
+  // of columns_. The stores are shared with the parser, nothing is copied.
+  std::vector<const Entries::value_type*> entryRows_;
+  std::vector<const Views::value_type*> viewRows_;
+  std::vector<uint32_t> rows_; // StorageMode::Columnar: rows of columns_
 
 private:
   LogFormat logFmt_;
   SLPError slpError_;
+  unsigned threads_; // of SLPThreadPool::shared(); 0: all of them
+
+  // A scan is split in parts of at least minPartSize_ entries, and in up to
+  // partsPerThread_ parts per thread, so that the threads that finish first
+  // take the parts left.
+  static constexpr size_t minPartSize_ = 16384;
+  static constexpr size_t partsPerThread_ = 4;
 
   using var_t = Visitor::var_t;
 
@@ -827,9 +2790,192 @@ private:
     int flag_;
     uint32_t begin_date_;
     uint32_t end_date_;
-    uint32_t begin_ip_;
-    uint32_t end_ip_;
+    SLPAddrDict::Range ip_;
   } info_t;
+
+  /*!
+   * \internal
+   * \brief A comparison of field() or an IN list of where(), compiled once
+   * before the entries are scanned: the value is taken out of its variant,
+   * the regex is built, and the field and the operator are resolved to one
+   * test function per kind of entry. Testing an entry is then a single
+   * indirect call. The rows of columns_ are tested through their columns,
+   * the dictionary fields through a table of the codes accepted.
+   */
+  class Predicate
+  {
+  public:
+    Predicate(const SLPQuery& query_,
+              Fields fld_,
+              Compare cmp_,
+              const var_t& t_);
+    Predicate(const SLPQuery& query_,
+              Fields fld_,
+              const std::vector<var_t>& list_);
+
+    bool isValid() const noexcept { return valid_; }
+    const boost::regex& regex() const noexcept { return re_; }
+    double cost() const noexcept;
+    void resolveRows();
+
+    bool operator()(const DataSet_Squid& d_) const
+    {
+      return squid_.test_(*this, squid_, d_);
+    }
+    bool operator()(const DataSet_View& d_) const
+    {
+      return view_.test_(*this, view_, d_);
+    }
+    bool operator()(size_t r_) const { return row_(*this, r_); }
+
+  private:
+    // The members of the field in TDataSet, or nullptr.
+    template<typename TDataSet>
+    struct Access
+    {
+      int TDataSet::*int_ = nullptr;
+      uint32_t TDataSet::*uint_ = nullptr;
+      decltype(TDataSet::reqURL) TDataSet::*text_ = nullptr;
+      bool (*test_)(const Predicate&, const Access&, const TDataSet&) =
+        nullptr;
+    };
+    template<typename TDataSet>
+    using Test = decltype(Access<TDataSet>::test_);
+    using RowTest = bool (*)(const Predicate&, size_t);
+
+    // How the value of the field is matched, the TMatch of the tests.
+    template<typename TOp>
+    struct ByOperator;
+    struct ByRegex;
+    struct ByHost;
+    struct InList;
+
+    void compile();
+    template<typename TDataSet>
+    void resolve(Access<TDataSet>& a_) const;
+    template<typename TResult, typename TPick>
+    TResult byNumber(TPick&& pick_, TResult none_) const;
+    template<typename TResult, typename TPick>
+    TResult byText(TPick&& pick_, TResult none_) const;
+    template<typename TResult, typename TPick>
+    TResult byOperator(TPick&& pick_, TResult none_) const;
+
+    template<typename TDataSet, bool TResult>
+    static bool constant(const Predicate&,
+                         const Access<TDataSet>&,
+                         const TDataSet&);
+    template<typename TMatch, typename TDataSet>
+    static bool intTest(const Predicate& p_,
+                        const Access<TDataSet>& a_,
+                        const TDataSet& d_);
+    template<typename TMatch, typename TDataSet>
+    static bool uintTest(const Predicate& p_,
+                         const Access<TDataSet>& a_,
+                         const TDataSet& d_);
+    template<typename TMatch, typename TDataSet>
+    static bool textTest(const Predicate& p_,
+                         const Access<TDataSet>& a_,
+                         const TDataSet& d_);
+    template<typename TMatch, typename TDataSet>
+    static bool strTest(const Predicate& p_,
+                        const Access<TDataSet>& a_,
+                        const TDataSet& d_);
+
+    template<bool TResult>
+    static bool rowConstant(const Predicate&, size_t);
+    template<typename TMatch>
+    static bool rowInt(const Predicate& p_, size_t r_);
+    template<typename TMatch>
+    static bool rowUint(const Predicate& p_, size_t r_);
+    template<typename TMatch>
+    static bool rowText(const Predicate& p_, size_t r_);
+    template<typename TMatch>
+    static bool rowStr(const Predicate& p_, size_t r_);
+    static bool rowCode(const Predicate& p_, size_t r_);
+
+    const SLPQuery& query_;
+    Fields fld_;
+    Compare cmp_;
+    TypeVar type_;
+    bool valid_;
+    bool in_; // IN list: ints_, uints_ or strs_, sorted
+    int int_;
+    uint32_t uint_;
+    std::string str_;
+    boost::regex re_; // Compare::REGEX only
+    std::vector<int> ints_;
+    std::vector<uint32_t> uints_;
+    std::vector<std::string> strs_;
+    Access<DataSet_Squid> squid_;
+    Access<DataSet_View> view_;
+
+    // StorageMode::Columnar
+    const SLPColumnStore& cols_;
+    const std::vector<int>* intCol_;
+    const std::vector<uint32_t>* uintCol_;
+    const std::vector<uint32_t>* codes_;
+    std::vector<char> hit_; // codes_: the codes accepted
+    RowTest row_;
+  };
+
+  /*!
+   * \internal
+   * \brief An SLPExpr compiled by where(). The comparisons and IN lists are
+   * Predicate objects, and the terms of AND and OR are ordered by order() so
+   * that the ones most likely to decide the result, at the lowest cost, are
+   * tested first.
+   */
+  struct Condition
+  {
+    SLPExpr::Kind kind_ = SLPExpr::Kind::And;
+    std::unique_ptr<Predicate> pred_; // Field and In
+    uint32_t min_ = 0;                // Time
+    uint32_t max_ = 0;
+    SLPAddrDict::Range ip_ = {}; // Addr
+    const SLPQuery* query_ = nullptr;
+    std::vector<Condition> terms_; // And, Or and Not
+    double pass_ = 1.0;            // estimated fraction of entries accepted
+    double cost_ = 1.0;            // estimated cost of a test
+
+    template<typename TDataSet>
+    bool operator()(const TDataSet& d_) const;
+    bool operator()(size_t r_) const;
+    template<typename TRate>
+    void order(TRate&& rate_);
+  };
+
+  // Entries of each store tested to estimate the selectivity of where().
+  static constexpr size_t sampleRows_ = 1024;
+
+  bool compile(const SLPExpr& e_, Condition& c_);
+  template<typename TStore>
+  void sample(const TStore& store_,
+              std::vector<const typename TStore::mapped_type*>& out_) const;
+  void whereColumns(const Condition& c_);
+
+  size_t parts(size_t n_) const;
+  template<typename TFunc>
+  void parallel(size_t parts_, TFunc&& f_) const;
+  template<typename TAcc, typename TFunc>
+  std::vector<TAcc> partials(size_t n_, TFunc&& f_) const;
+  template<typename TScan>
+  void collectRows(size_t begin_, size_t end_, size_t align_, TScan&& scan_);
+
+  template<typename TFunc>
+  void forSelected(size_t begin_, size_t end_, TFunc&& f_) const;
+  std::vector<DataKey> dataKeys(const Keys_V& keys_) const;
+  template<typename TFunc>
+  void forSelectedAt(const std::vector<DataKey>& keys_, TFunc&& f_) const;
+  void mergeRows(size_t before_);
+  template<typename TRows, typename TStore, typename TMatch>
+  void selectRows(TRows& rows_, const TStore& store_, TMatch&& match_);
+  void fieldColumns(Fields fld_,
+                    Compare cmp_,
+                    const var_t& t_,
+                    const boost::regex& re_);
+  template<typename T>
+  static bool zoneExcludes(Compare cmp_, T min_, T max_, T v_);
+  long sumColumn(Fields fld_) const;
 };
 
 /* SLPUrlParts -------------------------------------------------------------- */
@@ -857,6 +3003,12 @@ public:
   std::string getQuery() const;
   std::string getFragment() const;
 
+  static std::string_view host(std::string_view url_);
+  static std::string_view registrableDomain(std::string_view host_);
+  static bool hostMatches(std::string_view url_,
+                          std::string_view host_,
+                          bool subdomains_);
+
 private:
   std::string raw_url_;
 
@@ -886,7 +3038,10 @@ private:
 class SquidLogParser_EXPORT SLPRawToXML : public SquidLogParser
 {
 public:
-  explicit SLPRawToXML(LogFormat fmt_, size_t count_);
+  explicit SLPRawToXML(LogFormat fmt_,
+                       size_t count_,
+                       std::shared_ptr<const SLPLogFormat> custom_ = {},
+                       std::shared_ptr<SLPAddrDict> dict_ = {});
 
   SLPRawToXML& append(const DataSet_Squid& ds_);
 